@@ -23,6 +23,10 @@
  */
 
 #include <gtest/gtest.h>
+#include "../xyuv/src/utility.h"
+#include "../xyuv/src/bit_stream.h"
+
+#include <random>
 
 // This file tests the low-level get and set functions in pixelpacker.cpp
 
@@ -31,10 +35,6 @@ using unorm_t = uint64_t;
 
 // These are the funcitons to test.
 namespace xyuv {
-    extern void set_bit(uint8_t *buffer, uint64_t offset, bool val);
-    extern bool get_bit(const uint8_t *buffer, uint64_t offset);
-
-
     extern void write_bits(uint8_t *buffer, uint64_t offset, uint8_t bits, unorm_t &value);
     extern unorm_t read_bits(unorm_t &unorm, const uint8_t *buffer, uint64_t offset, uint8_t bits);
 };
@@ -236,4 +236,47 @@ TEST(BitPacking, ReadMultibyte)
     result = 0;
     xyuv::read_bits(result, bytes, 3, 12);
     ASSERT_EQ(0xb5bu, result);
-}
\ No newline at end of file
+}
+
+// Check the word wide accessors against the bit-by-bit reference, for all widths and alignments,
+// including fields ending on the very last byte of the buffer.
+TEST(BitPacking, WordWideMatchesBitwise) {
+    std::mt19937_64 rng(42);
+    const std::size_t BUFFER_SIZE = 16;
+
+    for (uint8_t bits = 1; bits <= 64; bits++) {
+        for (uint64_t offset = 0; offset + bits <= BUFFER_SIZE * 8; offset++) {
+            uint8_t reference[BUFFER_SIZE], buffer[BUFFER_SIZE];
+            for (std::size_t i = 0; i < BUFFER_SIZE; i++) {
+                reference[i] = buffer[i] = static_cast<uint8_t>(rng());
+            }
+
+            uint64_t value = rng();
+            for (uint8_t i = 0; i < bits; i++) {
+                xyuv::set_bit(reference, offset + i, ((value >> i) & 0x1) != 0);
+            }
+
+            xyuv::insert_bits(buffer, buffer + BUFFER_SIZE, offset, bits, value);
+            ASSERT_EQ(0, memcmp(reference, buffer, BUFFER_SIZE));
+
+            uint64_t mask = bits < 64 ? (0x1ull << bits) - 1 : ~0ull;
+            ASSERT_EQ(value & mask, xyuv::extract_bits(buffer, buffer + BUFFER_SIZE, offset, bits));
+        }
+    }
+}
+
+TEST(BitPacking, CopyBits) {
+    const uint8_t src[4] = {0x5a, 0xdc, 0x3a, 0xb5};
+    uint8_t dst[4] = {0, 0, 0, 0};
+
+    // Unaligned copy of 13 bits.
+    xyuv::copy_bits(dst, dst + 4, 5, src, src + 4, 3, 13);
+    for (uint64_t i = 0; i < 32; i++) {
+        bool expected = (i >= 5 && i < 18) ? xyuv::get_bit(src, i - 2) : false;
+        ASSERT_EQ(expected, xyuv::get_bit(dst, i));
+    }
+
+    // Byte aligned copy.
+    xyuv::copy_bits(dst, dst + 4, 0, src, src + 4, 0, 32);
+    ASSERT_EQ(0, memcmp(src, dst, 4));
+}
@@ -27,10 +27,16 @@
 #include <xyuv/structures/format.h>
 #include <xyuv/frame.h>
 #include <xyuv/yuv_image.h>
+#include <xyuv/executor.h>
 #include "TestResources.h"
 #include "../xyuv/src/utility.h"
 #include "../xyuv/src/to_string.h"
 #include "../xyuv/src/block_reorder.h"
+#include "../xyuv/src/pack_plan.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
 
 static xyuv::format create_block_reordered_format() {
     xyuv::format format;
@@ -138,4 +144,170 @@ TEST(BlockReorder, ReorderTest) {
     }
 
 
-}
\ No newline at end of file
+}
+// Packing straight into block order must give the same frame as packing linearly and reordering afterwards.
+TEST(BlockReorder, DirectTiledMatchesReorderTransform) {
+    const xyuv::config_manager &config = Resources::get().config();
+    const xyuv::format_template &fmt_template = config.get_format_template("RGBA8888_DX_standard_swizzle");
+    xyuv::chroma_siting siting = config.get_chroma_siting(*config.get_chroma_sitings(fmt_template.subsampling).begin());
+
+    // Two by two mega blocks.
+    const uint32_t width = 256, height = 256;
+    xyuv::format tiled_fmt = xyuv::create_format(width, height, fmt_template, config.get_conversion_matrix("bt601"), siting);
+    xyuv::format linear_fmt = tiled_fmt;
+    for (auto &plane : linear_fmt.planes) {
+        plane.block_order.mega_block_width = 1;
+        plane.block_order.mega_block_height = 1;
+    }
+
+    xyuv::yuv_image image = xyuv::create_yuv_image(width, height, siting);
+    uint32_t seed = 1;
+    for (auto *surf : {&image.y_plane, &image.u_plane, &image.v_plane, &image.a_plane}) {
+        for (auto &val : *surf) {
+            seed = seed * 1103515245u + 12345u;
+            val = static_cast<float>((seed >> 16) & 0xff) / 255.0f;
+        }
+    }
+
+    xyuv::frame tiled_frame = xyuv::encode_frame(image, tiled_fmt);
+    xyuv::frame linear_frame = xyuv::encode_frame(image, linear_fmt);
+    for (auto &plane : tiled_fmt.planes) {
+        xyuv::reorder_transform(linear_frame.data.get(), plane);
+    }
+    ASSERT_EQ(0, memcmp(linear_frame.data.get(), tiled_frame.data.get(), tiled_fmt.size));
+
+    // And reading it back must not depend on the path either.
+    xyuv::yuv_image decoded = xyuv::decode_frame(tiled_frame);
+    for (auto &plane : tiled_fmt.planes) {
+        xyuv::reorder_inverse(linear_frame.data.get(), plane);
+    }
+    linear_frame.format = linear_fmt;
+    xyuv::yuv_image linear_decoded = xyuv::decode_frame(linear_frame);
+    for (auto surfaces : {std::make_pair(&decoded.y_plane, &linear_decoded.y_plane),
+                          std::make_pair(&decoded.u_plane, &linear_decoded.u_plane),
+                          std::make_pair(&decoded.v_plane, &linear_decoded.v_plane),
+                          std::make_pair(&decoded.a_plane, &linear_decoded.a_plane)}) {
+        ASSERT_TRUE(std::equal(surfaces.first->begin(), surfaces.first->end(), surfaces.second->begin()));
+    }
+}
+
+TEST(BlockReorder, TableMatchesBitLoop) {
+    std::mt19937 rng(14);
+    for (int round = 0; round < 20; round++) {
+        // A random permutation of the offset bits, some of them left unused.
+        block_order bo;
+        bo.mega_block_width = 1u << (round % 7);
+        bo.mega_block_height = 1u << (round % 5);
+        std::vector<uint8_t> bits(32);
+        for (uint8_t i = 0; i < 32; i++) {
+            bits[i] = i;
+        }
+        std::shuffle(bits.begin(), bits.end(), rng);
+        for (uint8_t i = 0; i < 32; i++) {
+            bo.x_mask[i] = (bits[i] % 3 == 0) ? bits[i] % 8 : block_order::NOT_USED;
+            bo.y_mask[i] = (bits[i] % 3 == 1) ? bits[i] % 8 : block_order::NOT_USED;
+        }
+
+        xyuv::block_order_table table(bo);
+        for (uint32_t y = 0; y < bo.mega_block_height; y++) {
+            for (uint32_t x = 0; x < bo.mega_block_width; x++) {
+                ASSERT_EQ(xyuv::get_block_order_offset(x, y, bo), table.offset(x, y));
+                ASSERT_EQ(xyuv::get_block_order_coords(x, y, bo), table.coords(x, y));
+            }
+        }
+    }
+}
+
+TEST(BlockReorder, InPlaceKeepsBytesOutsideMegaBlocks) {
+    // Three mega blocks of 4x2 bytes per row with three bytes of padding, and a final line that is not part of any
+    // complete row of mega blocks.
+    xyuv::plane plane;
+    plane.base_offset = 3;
+    plane.block_stride = 8;
+    plane.line_stride = 15;
+    plane.size = 5 * plane.line_stride;
+    plane.block_order.mega_block_width = 4;
+    plane.block_order.mega_block_height = 2;
+    plane.block_order.x_mask[0] = 0;
+    plane.block_order.y_mask[1] = 0;
+    plane.block_order.x_mask[2] = 1;
+
+    std::mt19937 rng(15);
+    std::vector<uint8_t> original(plane.base_offset + plane.size + 3);
+    for (auto &byte : original) {
+        byte = static_cast<uint8_t>(rng());
+    }
+
+    // Mega blocks are stored back to back from the start of their row, bytes past the last one are left untouched.
+    std::vector<uint8_t> expected = original;
+    for (uint32_t line = 0; line < 4; line++) {
+        for (uint32_t col = 0; col < 12; col++) {
+            uint32_t x = col % 4, y = line % 2;
+            uint32_t offset = (x & 1) | (y << 1) | ((x >> 1) << 2);
+            std::size_t tiled = plane.base_offset + (line / 2) * 2 * plane.line_stride + (col / 4) * 8 + offset;
+            expected[tiled] = original[plane.base_offset + line * plane.line_stride + col];
+        }
+    }
+
+    std::vector<uint8_t> data = original;
+    xyuv::reorder_transform(data.data(), plane);
+    ASSERT_EQ(expected, data);
+
+    // Padding inside the stored mega blocks is lost, everything else must round trip.
+    xyuv::reorder_inverse(data.data(), plane);
+    for (uint32_t line = 0; line < 5; line++) {
+        for (uint32_t col = 0; col < plane.line_stride; col++) {
+            std::size_t i = plane.base_offset + line * plane.line_stride + col;
+            if (col < 12 || line == 4 || (line % 2) * plane.line_stride + col >= 24) {
+                ASSERT_EQ(original[i], data[i]);
+            }
+        }
+    }
+}
+
+// Tiled planes are packed in parallel by rows of mega blocks, which must give the same frame as the serial path.
+TEST(BlockReorder, ThreadedTiledMatchesSerial) {
+    const xyuv::config_manager &config = Resources::get().config();
+    const xyuv::format_template &fmt_template = config.get_format_template("RGBA8888_DX_standard_swizzle");
+    xyuv::chroma_siting siting = config.get_chroma_siting(*config.get_chroma_sitings(fmt_template.subsampling).begin());
+
+    // Two mega blocks wide and eight tall.
+    const uint32_t width = 256, height = 1024;
+    xyuv::format fmt = xyuv::create_format(width, height, fmt_template, config.get_conversion_matrix("bt601"), siting);
+
+    // Every group is split between rows of mega blocks only.
+    xyuv::pack_plan plan = xyuv::compile_pack_plan(fmt);
+    for (const xyuv::channel_group &group : plan.groups) {
+        ASSERT_TRUE(group.splittable);
+        for (uint32_t c : group.channels) {
+            for (const xyuv::part_plan &part : plan.channels[c].parts) {
+                ASSERT_TRUE(plan.tilings[part.plane].tiled);
+                ASSERT_EQ(0u, group.split_granularity % plan.tilings[part.plane].mega_block_h);
+            }
+        }
+        ASSERT_LT(group.split_granularity, group.n_block_lines);
+    }
+
+    xyuv::yuv_image image = xyuv::create_yuv_image(width, height, siting);
+    std::mt19937 rng(16);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    for (auto *surf : {&image.y_plane, &image.u_plane, &image.v_plane, &image.a_plane}) {
+        for (auto &val : *surf) {
+            val = dist(rng);
+        }
+    }
+
+    xyuv::thread_executor exec(4);
+    xyuv::frame serial = xyuv::encode_frame(image, fmt);
+    xyuv::frame threaded = xyuv::encode_frame(image, fmt, exec);
+    ASSERT_EQ(0, memcmp(serial.data.get(), threaded.data.get(), fmt.size));
+
+    xyuv::yuv_image serial_decoded = xyuv::decode_frame(serial);
+    xyuv::yuv_image threaded_decoded = xyuv::decode_frame(serial, exec);
+    for (auto surfaces : {std::make_pair(&serial_decoded.y_plane, &threaded_decoded.y_plane),
+                          std::make_pair(&serial_decoded.u_plane, &threaded_decoded.u_plane),
+                          std::make_pair(&serial_decoded.v_plane, &threaded_decoded.v_plane),
+                          std::make_pair(&serial_decoded.a_plane, &threaded_decoded.a_plane)}) {
+        ASSERT_TRUE(std::equal(surfaces.first->begin(), surfaces.first->end(), surfaces.second->begin()));
+    }
+}
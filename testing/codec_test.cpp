@@ -0,0 +1,551 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <xyuv.h>
+#include <xyuv/buffer_pool.h>
+#include <xyuv/codec.h>
+#include <xyuv/executor.h>
+#include <xyuv/frame.h>
+#include <xyuv/yuv_image.h>
+#include "../xyuv/src/utility.h"
+#include "TestResources.h"
+
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+using namespace xyuv;
+
+static void fill_random(surface<pixel_quantum> &surf, std::mt19937 &rng) {
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    for (auto &val : surf) {
+        val = dist(rng);
+    }
+}
+
+static void ASSERT_SURFACE_EQ(const surface<pixel_quantum> &lhs, const surface<pixel_quantum> &rhs) {
+    ASSERT_EQ(lhs.width(), rhs.width());
+    ASSERT_EQ(lhs.height(), rhs.height());
+    ASSERT_TRUE(std::equal(lhs.begin(), lhs.end(), rhs.begin()));
+}
+
+static void ASSERT_IMAGE_EQ(const yuv_image &lhs, const yuv_image &rhs) {
+    ASSERT_SURFACE_EQ(lhs.y_plane, rhs.y_plane);
+    ASSERT_SURFACE_EQ(lhs.u_plane, rhs.u_plane);
+    ASSERT_SURFACE_EQ(lhs.v_plane, rhs.v_plane);
+    ASSERT_SURFACE_EQ(lhs.a_plane, rhs.a_plane);
+}
+
+//! A codec must produce exactly the same bits as the one-shot API, and must be reusable.
+TEST(Codec, MatchesOneShotAPI) {
+    const config_manager &config = Resources::get().config();
+    conversion_matrix matrix = config.get_conversion_matrix("bt601");
+    std::mt19937 rng(1337);
+
+    for (const auto &entry : config.get_format_templates()) {
+        const format_template &fmt_template = entry.second;
+        chroma_siting siting = config.get_chroma_siting(*config.get_chroma_sitings(fmt_template.subsampling).begin());
+
+        format fmt;
+        try {
+            fmt = create_format(16, 16, fmt_template, matrix, siting);
+        } catch (std::exception &) {
+            // Some templates have size restrictions, those are covered elsewhere.
+            continue;
+        }
+
+        yuv_image image = create_yuv_image(16, 16, siting);
+        fill_random(image.y_plane, rng);
+        fill_random(image.u_plane, rng);
+        fill_random(image.v_plane, rng);
+        fill_random(image.a_plane, rng);
+
+        frame reference = encode_frame(image, fmt);
+        yuv_image reference_image = decode_frame(reference);
+
+        codec fmt_codec(fmt);
+        ASSERT_EQ(fmt.size, fmt_codec.format().size);
+
+        // Poison the buffer the same way encode_frame does so that padding bits match.
+        std::unique_ptr<uint8_t[]> buffer(new uint8_t[fmt.size]);
+        poison_buffer(buffer.get(), fmt.size);
+        fmt_codec.encode(image, buffer.get());
+        ASSERT_EQ(0, std::memcmp(buffer.get(), reference.data.get(), fmt.size)) << entry.first;
+
+        // Decode twice, the second time into the storage of the first.
+        yuv_image decoded;
+        fmt_codec.decode(buffer.get(), &decoded);
+        ASSERT_IMAGE_EQ(reference_image, decoded);
+
+        const pixel_quantum *y_storage = decoded.y_plane.data();
+        fmt_codec.decode(buffer.get(), &decoded);
+        ASSERT_IMAGE_EQ(reference_image, decoded);
+        ASSERT_EQ(y_storage, decoded.y_plane.data());
+    }
+}
+
+TEST(Codec, RejectsMismatchedImage) {
+    const config_manager &config = Resources::get().config();
+    chroma_siting siting = config.get_chroma_siting("444");
+    format fmt = create_format(8, 8, config.get_format_template("AYUV"), config.get_conversion_matrix("bt601"), siting);
+
+    codec fmt_codec(fmt);
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[fmt.size]);
+
+    yuv_image image = create_yuv_image(4, 8, siting);
+    ASSERT_THROW(fmt_codec.encode(image, buffer.get()), std::logic_error);
+}
+
+//! Packing in parallel must give exactly the same frames and images as the serial path.
+TEST(Codec, ThreadedMatchesSerial) {
+    const config_manager &config = Resources::get().config();
+    conversion_matrix matrix = config.get_conversion_matrix("bt601");
+    std::mt19937 rng(4242);
+    thread_executor exec(4);
+
+    for (const auto &entry : config.get_format_templates()) {
+        const format_template &fmt_template = entry.second;
+        chroma_siting siting = config.get_chroma_siting(*config.get_chroma_sitings(fmt_template.subsampling).begin());
+
+        format fmt;
+        try {
+            fmt = create_format(64, 48, fmt_template, matrix, siting);
+        } catch (std::exception &) {
+            continue;
+        }
+
+        yuv_image image = create_yuv_image(64, 48, siting);
+        fill_random(image.y_plane, rng);
+        fill_random(image.u_plane, rng);
+        fill_random(image.v_plane, rng);
+        fill_random(image.a_plane, rng);
+
+        frame serial = encode_frame(image, fmt);
+        frame threaded = encode_frame(image, fmt, exec);
+        ASSERT_EQ(0, std::memcmp(serial.data.get(), threaded.data.get(), fmt.size)) << entry.first;
+
+        ASSERT_IMAGE_EQ(decode_frame(serial), decode_frame(serial, exec));
+    }
+}
+
+TEST(Codec, ThreadExecutorRunsAllTasks) {
+    thread_executor exec(3);
+    ASSERT_EQ(3u, exec.concurrency());
+
+    std::vector<std::atomic<int>> counts(100);
+    for (auto &count : counts) count = 0;
+
+    exec.run(100, [&](uint32_t i) { counts[i]++; });
+    for (auto &count : counts) {
+        ASSERT_EQ(1, count);
+    }
+
+    ASSERT_THROW(exec.run(10, [](uint32_t i) { if (i == 7) throw std::runtime_error("task failed"); }),
+                 std::runtime_error);
+}
+
+TEST(Codec, StripeHeightDoesNotChangeResult) {
+    const config_manager &config = Resources::get().config();
+    chroma_siting siting = config.get_chroma_siting("444");
+    format fmt = create_format(33, 17, config.get_format_template("AYUV"), config.get_conversion_matrix("bt601"), siting);
+
+    std::mt19937 rng(7);
+    yuv_image image = create_yuv_image(33, 17, siting);
+    fill_random(image.y_plane, rng);
+    fill_random(image.u_plane, rng);
+    fill_random(image.v_plane, rng);
+    fill_random(image.a_plane, rng);
+
+    frame reference = encode_frame(image, fmt);
+
+    codec fmt_codec(fmt);
+    uint32_t auto_height = fmt_codec.stripe_height();
+    ASSERT_GE(auto_height, 1u);
+
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[fmt.size]);
+    for (uint32_t stripe_height : {1u, 2u, 5u, 1000u}) {
+        fmt_codec.set_stripe_height(stripe_height);
+        ASSERT_EQ(stripe_height, fmt_codec.stripe_height());
+
+        poison_buffer(buffer.get(), fmt.size);
+        fmt_codec.encode(image, buffer.get());
+        ASSERT_EQ(0, std::memcmp(buffer.get(), reference.data.get(), fmt.size));
+    }
+
+    fmt_codec.set_stripe_height(0);
+    ASSERT_EQ(auto_height, fmt_codec.stripe_height());
+}
+
+TEST(Codec, FrameIntoReusesStorage) {
+    const config_manager &config = Resources::get().config();
+    chroma_siting siting = config.get_chroma_siting("420");
+    format fmt = create_format(30, 18, config.get_format_template("NV12"), config.get_conversion_matrix("bt601"), siting);
+
+    std::mt19937 rng(42);
+    yuv_image image = create_yuv_image(30, 18, siting, true, true, true, false);
+    fill_random(image.y_plane, rng);
+    fill_random(image.u_plane, rng);
+    fill_random(image.v_plane, rng);
+
+    // Encode into caller owned memory, padding is left as it was.
+    frame reference = encode_frame(image, fmt);
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[fmt.size]);
+    poison_buffer(buffer.get(), fmt.size);
+    encode_frame_into(image, fmt, buffer.get(), fmt.size);
+    ASSERT_EQ(0, std::memcmp(buffer.get(), reference.data.get(), fmt.size));
+    ASSERT_THROW(encode_frame_into(image, fmt, buffer.get(), fmt.size - 1), std::logic_error);
+
+    // Decode into an existing image without reallocating it.
+    yuv_image decoded = create_yuv_image(30, 18, siting, true, true, true, false);
+    const pixel_quantum *y_data = decoded.y_plane.data();
+    const pixel_quantum *u_data = decoded.u_plane.data();
+    decode_frame_into(reference, &decoded);
+    ASSERT_EQ(y_data, decoded.y_plane.data());
+    ASSERT_EQ(u_data, decoded.u_plane.data());
+    ASSERT_IMAGE_EQ(decode_frame(reference), decoded);
+
+    yuv_image wrong_size = create_yuv_image(32, 18, siting, true, true, true, false);
+    ASSERT_THROW(decode_frame_into(reference, &wrong_size), std::logic_error);
+}
+
+// Check that region holds the pixels of full at (x, y), subsampled channels are offset by the macro pixel.
+static void ASSERT_IS_CROP(const yuv_image &full, const yuv_image &region, uint32_t x, uint32_t y) {
+    const subsampling &sub = full.siting.subsampling;
+    const std::array<std::pair<const surface<pixel_quantum> *, const surface<pixel_quantum> *>, 4> planes = {{
+            std::make_pair(&full.y_plane, &region.y_plane), std::make_pair(&full.u_plane, &region.u_plane),
+            std::make_pair(&full.v_plane, &region.v_plane), std::make_pair(&full.a_plane, &region.a_plane)
+    }};
+
+    for (uint32_t c = 0; c < planes.size(); c++) {
+        const surface<pixel_quantum> &src = *planes[c].first;
+        const surface<pixel_quantum> &dst = *planes[c].second;
+        ASSERT_EQ(src.empty(), dst.empty());
+        bool chroma = (c == channel::U || c == channel::V);
+        uint32_t offset_x = chroma ? x / sub.macro_px_w : x;
+        uint32_t offset_y = chroma ? y / sub.macro_px_h : y;
+        for (uint32_t row = 0; row < dst.height(); row++) {
+            for (uint32_t col = 0; col < dst.width(); col++) {
+                ASSERT_EQ(src.at(offset_x + col, offset_y + row), dst.at(col, row));
+            }
+        }
+    }
+}
+
+TEST(Codec, DecodeRegionMatchesCrop) {
+    const config_manager &config = Resources::get().config();
+    conversion_matrix matrix = config.get_conversion_matrix("bt601");
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    for (const auto &entry : config.get_format_templates()) {
+        const format_template &fmt_template = entry.second;
+        chroma_siting siting = config.get_chroma_siting(*config.get_chroma_sitings(fmt_template.subsampling).begin());
+        const subsampling &sub = siting.subsampling;
+
+        // Some templates get the chroma line stride wrong for sizes that are not a multiple of the subsampling.
+        format base_fmt;
+        try {
+            base_fmt = create_format(40, 32, fmt_template, matrix, siting);
+        } catch (std::exception &) {
+            continue;
+        }
+
+        // Also cover bottom-up frames and interleaved planes.
+        std::vector<format> variants(3, base_fmt);
+        variants[1].origin = image_origin::LOWER_LEFT;
+        for (auto &plane : variants[2].planes) {
+            plane.interleave_mode = interleave_pattern::INTERLEAVE_1_3_5__0_2_4;
+        }
+
+        for (const format &fmt : variants) {
+            SCOPED_TRACE(entry.first);
+            frame frame_in = create_frame(fmt, nullptr, 0);
+            for (uint64_t i = 0; i < fmt.size; i++) {
+                frame_in.data[i] = static_cast<uint8_t>(byte(rng));
+            }
+            yuv_image full = decode_frame(frame_in);
+
+            const uint32_t mw = sub.macro_px_w, mh = sub.macro_px_h;
+            const uint32_t regions[][4] = {
+                    {0, 0, 40, 32},
+                    {mw, mh, 5, 3},
+                    {4 * mw, 2 * mh, 37 - 4 * mw, 29 - 2 * mh},
+                    {4 * mw, 4 * mh, 40 - 4 * mw, 32 - 4 * mh},
+                    {8 * mw, 4 * mh, 1, 1},
+            };
+            for (const auto &r : regions) {
+                yuv_image region = decode_frame_region(frame_in, r[0], r[1], r[2], r[3]);
+                ASSERT_EQ(r[2], region.image_w);
+                ASSERT_EQ(r[3], region.image_h);
+                ASSERT_IS_CROP(full, region, r[0], r[1]);
+            }
+        }
+    }
+
+    frame frame_in = create_frame(create_format(8, 8, config.get_format_template("NV12"), matrix,
+                                                config.get_chroma_siting("420")), nullptr, 0);
+    ASSERT_THROW(decode_frame_region(frame_in, 1, 0, 2, 2), std::logic_error);
+    ASSERT_THROW(decode_frame_region(frame_in, 4, 4, 6, 2), std::logic_error);
+    ASSERT_THROW(decode_frame_region(frame_in, 0, 0, 0, 2), std::logic_error);
+}
+
+TEST(Codec, DecodeBandsMatchesDecode) {
+    const config_manager &config = Resources::get().config();
+    conversion_matrix matrix = config.get_conversion_matrix("bt601");
+    std::mt19937 rng(4);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    for (const auto &entry : config.get_format_templates()) {
+        const format_template &fmt_template = entry.second;
+        chroma_siting siting = config.get_chroma_siting(*config.get_chroma_sitings(fmt_template.subsampling).begin());
+
+        format base_fmt;
+        try {
+            base_fmt = create_format(40, 32, fmt_template, matrix, siting);
+        } catch (std::exception &) {
+            continue;
+        }
+
+        std::vector<format> variants(2, base_fmt);
+        variants[1].origin = image_origin::LOWER_LEFT;
+
+        for (const format &fmt : variants) {
+            SCOPED_TRACE(entry.first);
+            frame frame_in = create_frame(fmt, nullptr, 0);
+            for (uint64_t i = 0; i < fmt.size; i++) {
+                frame_in.data[i] = static_cast<uint8_t>(byte(rng));
+            }
+            yuv_image full = decode_frame(frame_in);
+
+            for (uint32_t band_height : {0u, 1u, 6u, 32u, 100u}) {
+                uint32_t next_row = 0;
+                decode_frame_bands(frame_in, band_height, [&](uint32_t first_row, const yuv_image &band) {
+                    ASSERT_EQ(next_row, first_row);
+                    ASSERT_EQ(full.image_w, band.image_w);
+                    ASSERT_GE(band.image_h, std::min(std::max(band_height, 1u), full.image_h - first_row));
+                    ASSERT_IS_CROP(full, band, 0, first_row);
+                    next_row = first_row + band.image_h;
+                });
+                ASSERT_EQ(full.image_h, next_row);
+            }
+        }
+    }
+}
+
+template <typename T>
+static void ASSERT_CONVERTED_EQ(const surface<pixel_quantum> &expected, const surface<T> &actual) {
+    ASSERT_EQ(expected.width(), actual.width());
+    ASSERT_EQ(expected.height(), actual.height());
+    for (uint32_t y = 0; y < expected.height(); y++) {
+        for (uint32_t x = 0; x < expected.width(); x++) {
+            T q = quantum_traits<T>::from_float(expected.at(x, y));
+            ASSERT_EQ(0, memcmp(&q, &actual.at(x, y), sizeof(T)));
+        }
+    }
+}
+
+TEST(Codec, CompactSampleTypes) {
+    const config_manager &config = Resources::get().config();
+    conversion_matrix matrix = config.get_conversion_matrix("bt601");
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    for (const auto &entry : config.get_format_templates()) {
+        SCOPED_TRACE(entry.first);
+        const format_template &fmt_template = entry.second;
+        chroma_siting siting = config.get_chroma_siting(*config.get_chroma_sitings(fmt_template.subsampling).begin());
+        format fmt = create_format(32, 32, fmt_template, matrix, siting);
+
+        frame frame_in = create_frame(fmt, nullptr, 0);
+        for (uint64_t i = 0; i < fmt.size; i++) {
+            frame_in.data[i] = static_cast<uint8_t>(byte(rng));
+        }
+
+        // Decoding to a compact type gives the float result converted sample by sample.
+        yuv_image full = decode_frame(frame_in);
+        codec codec(fmt);
+        basic_yuv_image<uint16_t> unorm16;
+        basic_yuv_image<half> half16;
+        codec.decode(frame_in.data.get(), &unorm16);
+        codec.decode(frame_in.data.get(), &half16);
+        ASSERT_CONVERTED_EQ(full.y_plane, unorm16.y_plane);
+        ASSERT_CONVERTED_EQ(full.u_plane, unorm16.u_plane);
+        ASSERT_CONVERTED_EQ(full.v_plane, unorm16.v_plane);
+        ASSERT_CONVERTED_EQ(full.a_plane, unorm16.a_plane);
+        ASSERT_CONVERTED_EQ(full.y_plane, half16.y_plane);
+        ASSERT_CONVERTED_EQ(full.a_plane, half16.a_plane);
+
+        // 16 bit normalized samples keep every code of the formats, and so re-encode to the same frame.
+        std::vector<uint8_t> expected(fmt.size), actual(fmt.size);
+        encode_frame_into(full, fmt, expected.data(), fmt.size);
+        encode_frame_into(unorm16, fmt, actual.data(), fmt.size);
+        ASSERT_EQ(expected, actual);
+    }
+
+    // Half precision is enough for 8 bit formats.
+    frame frame_in = create_frame(create_format(30, 18, config.get_format_template("NV12"), matrix,
+                                                config.get_chroma_siting("420")), nullptr, 0);
+    for (uint64_t i = 0; i < frame_in.format.size; i++) {
+        frame_in.data[i] = static_cast<uint8_t>(byte(rng));
+    }
+    basic_yuv_image<half> half16 = create_yuv_image<half>(30, 18, config.get_chroma_siting("420"), true, true, true,
+                                                          false);
+    decode_frame_into(frame_in, &half16);
+    std::vector<uint8_t> expected(frame_in.format.size), actual(frame_in.format.size);
+    encode_frame_into(decode_frame(frame_in), frame_in.format, expected.data(), expected.size());
+    encode_frame_into(half16, frame_in.format, actual.data(), actual.size());
+    ASSERT_EQ(expected, actual);
+}
+
+TEST(Codec, ConstantAlpha) {
+    const config_manager &config = Resources::get().config();
+    format fmt = create_format(30, 18, config.get_format_template("RGBA8888"), config.get_conversion_matrix("bt601"),
+                               config.get_chroma_siting("444"));
+    std::mt19937 rng(6);
+
+    // A constant alpha plane is packed like the full plane it stands for.
+    yuv_image image = create_yuv_image(30, 18, fmt.chroma_siting);
+    fill_random(image.y_plane, rng);
+    fill_random(image.u_plane, rng);
+    fill_random(image.v_plane, rng);
+    ASSERT_TRUE(image.a_plane.is_constant());
+    frame constant_alpha = encode_frame(image, fmt);
+
+    image.a_plane.materialize();
+    frame full_alpha = encode_frame(image, fmt);
+    ASSERT_EQ(0, memcmp(constant_alpha.data.get(), full_alpha.data.get(), fmt.size));
+
+    // Only an opaque alpha channel is collapsed, and only on request.
+    codec codec(fmt);
+    yuv_image decoded;
+    codec.decode(full_alpha.data.get(), &decoded);
+    ASSERT_FALSE(decoded.a_plane.is_constant());
+    codec.set_detect_opaque_alpha(true);
+    codec.decode(full_alpha.data.get(), &decoded);
+    ASSERT_TRUE(decoded.a_plane.is_constant());
+    ASSERT_IMAGE_EQ(decode_frame(full_alpha), decoded);
+
+    image.a_plane.set(3, 4, 0.5f);
+    frame translucent = encode_frame(image, fmt);
+    codec.decode(translucent.data.get(), &decoded);
+    ASSERT_FALSE(decoded.a_plane.is_constant());
+    ASSERT_IMAGE_EQ(decode_frame(translucent), decoded);
+}
+
+TEST(Codec, EncodeDecodeViews) {
+    const config_manager &config = Resources::get().config();
+    format fmt = create_format(16, 12, config.get_format_template("NV12"), config.get_conversion_matrix("bt601"),
+                               config.get_chroma_siting("420"));
+    format bottom_up = fmt;
+    bottom_up.origin = image_origin::LOWER_LEFT;
+    std::mt19937 rng(7);
+
+    // The frame is encoded from a crop of a larger image.
+    yuv_image large = create_yuv_image(24, 20, fmt.chroma_siting, true, true, true, false);
+    fill_random(large.y_plane, rng);
+    fill_random(large.u_plane, rng);
+    fill_random(large.v_plane, rng);
+    const_yuv_image_view view = make_view(large).crop(4, 2, 16, 12);
+    yuv_image image = copy_yuv_image(view);
+
+    codec codec(fmt);
+    frame from_view = create_frame(fmt, nullptr, 0);
+    codec.encode(view, from_view.data.get());
+    ASSERT_IMAGE_EQ(decode_frame(encode_frame(image, fmt)), decode_frame(from_view));
+
+    // Encoding a flipped view gives the bottom-up frame, and decoding to a flipped view turns it back.
+    frame flipped = create_frame(fmt, nullptr, 0);
+    poison_buffer(flipped.data.get(), fmt.size);
+    codec.encode(view.flip_y(), flipped.data.get());
+    frame expected = encode_frame(image, bottom_up);
+    ASSERT_EQ(0, memcmp(expected.data.get(), flipped.data.get(), fmt.size));
+
+    yuv_image decoded = create_yuv_image(16, 12, fmt.chroma_siting, true, true, true, false);
+    codec.decode(flipped.data.get(), make_mutable_view(decoded).flip_y());
+    ASSERT_IMAGE_EQ(decode_frame(encode_frame(image, fmt)), decoded);
+
+    // The view must have the layout of the format.
+    ASSERT_THROW(codec.encode(make_view(large), flipped.data.get()), std::logic_error);
+    ASSERT_THROW(codec.decode(flipped.data.get(), make_mutable_view(large)), std::logic_error);
+}
+
+//! Once a stream of frames has warmed up a buffer_pool, processing another frame must not allocate from it.
+TEST(Codec, BufferPoolSteadyState) {
+    const config_manager &config = Resources::get().config();
+    chroma_siting siting = config.get_chroma_siting("420");
+    format fmt = create_format(32, 16, config.get_format_template("NV12"), config.get_conversion_matrix("bt601"),
+                               siting);
+    std::mt19937 rng(4711);
+
+    yuv_image image = create_yuv_image(32, 16, siting, true, true, true, false);
+    fill_random(image.y_plane, rng);
+    fill_random(image.u_plane, rng);
+    fill_random(image.v_plane, rng);
+    frame source = encode_frame(image, fmt);
+    frame reference = encode_frame(up_sample(decode_frame(source)), fmt);
+
+    std::unique_ptr<frame> outlives_pool;
+    {
+        buffer_pool pool;
+        uint64_t warm_misses = 0;
+        for (int i = 0; i < 4; i++) {
+            yuv_image decoded = decode_frame(source, pool);
+            yuv_image full = up_sample(std::move(decoded));
+            frame result = encode_frame(full, fmt, pool);
+            ASSERT_EQ(0, std::memcmp(reference.data.get(), result.data.get(), fmt.size));
+
+            buffer_pool::statistics stats = pool.stats();
+            if (i == 0) {
+                warm_misses = stats.misses;
+                ASSERT_GT(warm_misses, 0u);
+            } else {
+                ASSERT_EQ(warm_misses, stats.misses);
+                ASSERT_GE(stats.hits, i * warm_misses);
+            }
+        }
+        ASSERT_EQ(pool.stats().cached_buffers, pool.stats().misses);
+
+        outlives_pool.reset(new frame(create_frame(fmt, source.data.get(), fmt.size, pool)));
+        ASSERT_EQ(0, std::memcmp(source.data.get(), outlives_pool->data.get(), fmt.size));
+
+        pool.trim();
+        ASSERT_EQ(0u, pool.stats().cached_bytes);
+    }
+    // The buffer is released to the system rather than the destroyed pool.
+    outlives_pool.reset();
+
+    // Huge page backed buffers are recycled the same way.
+    buffer_pool huge_pool(true);
+    const std::size_t size = 3u << 20;
+    void *buffer = huge_pool.allocate(size);
+    ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(buffer) % buffer_alignment);
+    std::memset(buffer, 0x5a, size);
+    huge_pool.deallocate(buffer, size);
+    ASSERT_EQ(buffer, huge_pool.allocate(size));
+    huge_pool.deallocate(buffer, size);
+    ASSERT_EQ(1u, huge_pool.stats().hits);
+    ASSERT_EQ(1u, huge_pool.stats().misses);
+}
@@ -0,0 +1,89 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <xyuv.h>
+#include <xyuv/frame.h>
+#include <xyuv/yuv_image.h>
+#include "TestResources.h"
+
+#include <cstring>
+#include <random>
+
+using namespace xyuv;
+
+static frame create_random_frame(const format &fmt, std::mt19937 &rng) {
+    frame result = create_frame(fmt, nullptr, 0);
+    std::uniform_int_distribution<int> dist(0, 255);
+    for (uint64_t i = 0; i < fmt.size; i++) {
+        result.data[i] = static_cast<uint8_t>(dist(rng));
+    }
+    return result;
+}
+
+//! Converting between formats that only differ in layout must give the same bits as going through a yuv_image,
+//! also for codes outside the packed range.
+TEST(ConvertFrame, RepackMatchesDecodeEncode) {
+    const config_manager &config = Resources::get().config();
+    conversion_matrix matrix = config.get_conversion_matrix("bt601");
+    std::mt19937 rng(99);
+
+    for (const auto &from_entry : config.get_format_templates()) {
+        const format_template &from_template = from_entry.second;
+        chroma_siting siting = config.get_chroma_siting(*config.get_chroma_sitings(from_template.subsampling).begin());
+
+        format from;
+        try {
+            from = create_format(16, 16, from_template, matrix, siting);
+        } catch (std::exception &) {
+            continue;
+        }
+        frame frame_in = create_random_frame(from, rng);
+
+        for (const auto &to_entry : config.get_format_templates()) {
+            if (!(to_entry.second.subsampling == from_template.subsampling)) {
+                continue;
+            }
+            format to;
+            try {
+                to = create_format(16, 16, to_entry.second, matrix, siting);
+            } catch (std::exception &) {
+                continue;
+            }
+
+            SCOPED_TRACE(from_entry.first + " -> " + to_entry.first);
+            frame converted = convert_frame(frame_in, to);
+            format renamed = to;
+            renamed.fourcc = from.fourcc;
+            if (renamed == from) {
+                // A no-op is a plain copy, even of codes outside the packed range.
+                ASSERT_EQ(0, std::memcmp(frame_in.data.get(), converted.data.get(), to.size));
+                continue;
+            }
+
+            frame reference = encode_frame(decode_frame(frame_in), to);
+            ASSERT_EQ(0, std::memcmp(reference.data.get(), converted.data.get(), to.size));
+        }
+    }
+}
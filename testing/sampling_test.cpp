@@ -24,9 +24,14 @@
 
 #include <xyuv/yuv_image.h>
 #include <xyuv.h>
+#include <xyuv/frame.h>
 #include "../xyuv/src/to_string.h"
 #include "TestResources.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <random>
+#include <utility>
 
 #include <gtest/gtest.h>
 
@@ -112,4 +117,157 @@ TEST_P(Formats, subsampling) {
 
 }
 
+// Direct evaluation of the weighted average of the pixels of each block around the sample point.
+static float reference_down_sample(const surface<float> &src, uint32_t x, uint32_t y,
+                                   const ::subsampling &subsampling, const std::pair<float, float> &sample_point) {
+    float sum = 0.0f;
+    for (uint32_t b_y = 0; b_y < subsampling.macro_px_h; b_y++) {
+        float w_y = 1.0f - std::fabs(sample_point.second - b_y);
+        for (uint32_t b_x = 0; b_x < subsampling.macro_px_w; b_x++) {
+            float w_x = 1.0f - std::fabs(sample_point.first - b_x);
+            if (w_x > 0.0f && w_y > 0.0f) {
+                uint32_t source_x = std::min(x * subsampling.macro_px_w + b_x, src.width() - 1);
+                uint32_t source_y = std::min(y * subsampling.macro_px_h + b_y, src.height() - 1);
+                sum += w_x * w_y * src.get(source_x, source_y);
+            }
+        }
+    }
+    return sum;
+}
+
+TEST_P(Formats, down_sample_matches_reference) {
+    ::chroma_siting chroma_siting = Resources::get().config().get_chroma_siting(GetParam());
+
+    // Odd dimensions to cover the partial blocks at the right and bottom edges.
+    ::chroma_siting siting_444 = Resources::get().config().get_chroma_siting("444");
+    yuv_image image_444 = create_yuv_image(53, 21, siting_444, true, true, true, false);
+    randomize_plane(image_444.u_plane);
+    randomize_plane(image_444.v_plane);
+
+    yuv_image observed = down_sample(image_444, chroma_siting);
+
+    for (uint32_t y = 0; y < observed.u_plane.height(); y++) {
+        for (uint32_t x = 0; x < observed.u_plane.width(); x++) {
+            SCOPED_TRACE("(" + to_string(x) + ", " + to_string(y) + ")");
+            EXPECT_NEAR(reference_down_sample(image_444.u_plane, x, y, chroma_siting.subsampling,
+                                              chroma_siting.u_sample_point), observed.u_plane.get(x, y), 1e-6f);
+            EXPECT_NEAR(reference_down_sample(image_444.v_plane, x, y, chroma_siting.subsampling,
+                                              chroma_siting.v_sample_point), observed.v_plane.get(x, y), 1e-6f);
+        }
+    }
+}
+
+TEST_P(Formats, up_sample_filters) {
+    ::chroma_siting chroma_siting = Resources::get().config().get_chroma_siting(GetParam());
+    const ::subsampling &sub = chroma_siting.subsampling;
+
+    // Odd dimensions to cover the partial blocks at the right and bottom edges. U is a ramp along x, V along y.
+    yuv_image image = create_yuv_image(53, 21, chroma_siting, true, true, true, false);
+    for (uint32_t y = 0; y < image.u_plane.height(); y++) {
+        for (uint32_t x = 0; x < image.u_plane.width(); x++) {
+            image.u_plane.set(x, y, 0.01f * x);
+            image.v_plane.set(x, y, 0.01f * y);
+        }
+    }
+
+    yuv_image replicated = up_sample(image);
+    yuv_image interpolated = up_sample(image, upsampling_filter::BILINEAR);
+    ASSERT_TRUE(is_444(interpolated.siting.subsampling));
+
+    // A linear ramp is reproduced exactly between the sample points and clamped outside them.
+    auto ramp = [](uint32_t pixel, uint32_t factor, float sample_point, uint32_t n_samples) {
+        float position = (pixel - sample_point) / factor;
+        return 0.01f * std::min(std::max(position, 0.0f), n_samples - 1.0f);
+    };
+
+    for (uint32_t y = 0; y < image.image_h; y++) {
+        for (uint32_t x = 0; x < image.image_w; x++) {
+            SCOPED_TRACE("(" + to_string(x) + ", " + to_string(y) + ")");
+            EXPECT_EQ(image.u_plane.get(x / sub.macro_px_w, y / sub.macro_px_h), replicated.u_plane.get(x, y));
+            EXPECT_EQ(image.v_plane.get(x / sub.macro_px_w, y / sub.macro_px_h), replicated.v_plane.get(x, y));
+
+            EXPECT_NEAR(ramp(x, sub.macro_px_w, chroma_siting.u_sample_point.first, image.u_plane.width()),
+                        interpolated.u_plane.get(x, y), 1e-6f);
+            EXPECT_NEAR(ramp(y, sub.macro_px_h, chroma_siting.v_sample_point.second, image.v_plane.height()),
+                        interpolated.v_plane.get(x, y), 1e-6f);
+        }
+    }
+}
+
+TEST(Sampling, resite_chroma) {
+    // MPEG-1 420 to co-sited MPEG-2 420: the sample point moves half a pixel, i.e. a quarter of a chroma sample,
+    // to the left.
+    ::chroma_siting mpeg1 = Resources::get().config().get_chroma_siting("420");
+    ::chroma_siting mpeg2 = mpeg1;
+    mpeg2.u_sample_point.first = 0.0f;
+    mpeg2.v_sample_point.first = 0.0f;
+
+    yuv_image image = create_yuv_image(20, 8, mpeg1, true, true, true, false);
+    for (uint32_t y = 0; y < image.u_plane.height(); y++) {
+        for (uint32_t x = 0; x < image.u_plane.width(); x++) {
+            image.u_plane.set(x, y, 0.1f * x);
+            image.v_plane.set(x, y, 0.25f * y);
+        }
+    }
+
+    yuv_image resited = resite_chroma(image, mpeg2);
+    ASSERT_EQ(mpeg2, resited.siting);
+    compare_surfaces(image.y_plane, resited.y_plane);
+    compare_surfaces(image.v_plane, resited.v_plane);
+
+    for (uint32_t y = 0; y < resited.u_plane.height(); y++) {
+        // The leftmost sample is clamped to the edge.
+        EXPECT_FLOAT_EQ(0.0f, resited.u_plane.get(0, y));
+        for (uint32_t x = 1; x < resited.u_plane.width(); x++) {
+            EXPECT_NEAR(0.1f * (x - 0.25f), resited.u_plane.get(x, y), 1e-6f);
+        }
+    }
+
+    compare_yuv_images(image, resite_chroma(image, mpeg1));
+    EXPECT_THROW(resite_chroma(image, Resources::get().config().get_chroma_siting("422")), std::logic_error);
+}
+
+TEST(Sampling, rvalue_overloads_move_planes) {
+    const config_manager &config = Resources::get().config();
+    ::chroma_siting siting_420 = config.get_chroma_siting("420");
+
+    yuv_image image = create_yuv_image(24, 16, config.get_chroma_siting("444"));
+    randomize_plane(image.y_plane);
+    randomize_plane(image.u_plane);
+    randomize_plane(image.v_plane);
+    image.a_plane.materialize();
+
+    // The results equal those of the copying overloads, but luma and alpha are moved from stage to stage.
+    yuv_image down = down_sample(image, siting_420);
+    yuv_image up = up_sample(down, upsampling_filter::BILINEAR);
+
+    yuv_image moved = image;
+    const pixel_quantum *luma = moved.y_plane.data();
+    const pixel_quantum *alpha = moved.a_plane.data();
+    yuv_image moved_down = down_sample(std::move(moved), siting_420);
+    ASSERT_TRUE(moved.y_plane.empty());
+    ASSERT_EQ(luma, moved_down.y_plane.data());
+    ASSERT_EQ(alpha, moved_down.a_plane.data());
+    compare_yuv_images(down, moved_down);
+
+    yuv_image moved_up = up_sample(std::move(moved_down), upsampling_filter::BILINEAR);
+    ASSERT_EQ(luma, moved_up.y_plane.data());
+    compare_yuv_images(up, moved_up);
+
+    // Scaling releases the planes of the input, and an image that keeps its size is passed through.
+    yuv_image scaled = scale_yuv_image(std::move(moved_up), 24, 16);
+    ASSERT_EQ(luma, scaled.y_plane.data());
+    yuv_image shrunk = scale_yuv_image(std::move(scaled), 12, 8, scaling_filter::BOX);
+    ASSERT_TRUE(scaled.y_plane.empty());
+    compare_yuv_images(scale_yuv_image(up, 12, 8, scaling_filter::BOX), shrunk);
+
+    // Encoding a temporary gives the same frame.
+    format fmt = create_format(16, 8, config.get_format_template("NV12"), config.get_conversion_matrix("bt601"),
+                               siting_420);
+    yuv_image copy = image;
+    frame expected = encode_frame(image, fmt);
+    frame actual = encode_frame(std::move(copy), fmt);
+    ASSERT_EQ(0, memcmp(expected.data.get(), actual.data.get(), fmt.size));
+}
+
 INSTANTIATE_TEST_CASE_P(, Formats, ::testing::Values("422", "420", "411", "410"));
\ No newline at end of file
@@ -84,3 +84,89 @@ TEST(Unorm, StudioRange) {
         }
     }
 }
+
+// The batch conversions must be bit exact with the scalar reference for every instruction set the cpu supports.
+TEST(Unorm, BatchMatchesScalar) {
+    std::vector<std::pair<uint8_t , uint8_t >> batch_bits {
+            { 8, 0 }, { 10, 0 }, { 12, 0 }, { 16, 0 }, { 8, 2 }, { 8, 8 }, { 1, 0 }, { 5, 0 }
+    };
+
+    // Odd sizes exercise the scalar tail, the stride the gathering loads.
+    const std::size_t n = 1003;
+    const std::size_t stride = 3;
+    std::vector<float> values(n * stride);
+    for (std::size_t i = 0; i < values.size(); i++) {
+        values[i] = (i < test_values.size()) ? test_values[i] : static_cast<float>(i % 4099) / 4098.0f;
+    }
+
+    std::vector<simd_level> levels { simd_level::SCALAR };
+    if (detect_simd_level() != simd_level::SCALAR) levels.push_back(simd_level::SSE2);
+    if (detect_simd_level() == simd_level::AVX2) levels.push_back(simd_level::AVX2);
+
+    for (simd_level level : levels) {
+        SCOPED_TRACE( "Level " + to_string(static_cast<int>(level)) );
+        for (auto & bits : batch_bits) {
+            SCOPED_TRACE( "UNORM" + to_string(bits.first) + "." + to_string(bits.second) );
+            for (auto & range : test_ranges) {
+                SCOPED_TRACE( "Range [" + to_string(range.first) + ", " + to_string(range.second) + "]" );
+
+                for (std::size_t s : {std::size_t(1), stride}) {
+                    std::vector<uint16_t> codes(n);
+                    to_unorm_batch(level, values.data(), s, n, bits.first, bits.second, range, codes.data());
+                    for (std::size_t i = 0; i < n; i++) {
+                        ASSERT_EQ(to_unorm(values[i * s], bits.first, bits.second, range), codes[i]);
+                    }
+                }
+
+                // All codes of the bit depth, plus an odd tail.
+                uint64_t max = ((0x1uLL << bits.first) - 1) << bits.second;
+                std::vector<uint16_t> all_codes;
+                for (uint64_t code = 0; code <= max; code++) {
+                    all_codes.push_back(static_cast<uint16_t>(code));
+                }
+                all_codes.push_back(static_cast<uint16_t>(max / 3));
+
+                for (std::size_t s : {std::size_t(1), stride}) {
+                    std::vector<float> decoded(all_codes.size() * s);
+                    from_unorm_batch(level, all_codes.data(), all_codes.size(), bits.first, bits.second, range,
+                                     decoded.data(), s);
+                    for (std::size_t i = 0; i < all_codes.size(); i++) {
+                        float expected = from_unorm(all_codes[i], bits.first, bits.second, range);
+                        ASSERT_EQ(0, memcmp(&expected, &decoded[i * s], sizeof(float)));
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(Unorm, HalfConversion) {
+    // Every half other than NaN survives a round trip through float.
+    for (uint32_t bits = 0; bits <= 0xffff; bits++) {
+        half h = { static_cast<uint16_t>(bits) };
+        if ((bits & 0x7c00) == 0x7c00 && (bits & 0x3ff) != 0) {
+            ASSERT_TRUE(std::isnan(half_to_float(h)));
+            continue;
+        }
+        ASSERT_EQ(bits, float_to_half(half_to_float(h)).bits);
+    }
+
+    ASSERT_EQ(0x3c00, float_to_half(1.0f).bits);
+    ASSERT_EQ(0x2e66, float_to_half(0.1f).bits);
+    ASSERT_EQ(0x7bff, float_to_half(65519.0f).bits);
+    ASSERT_EQ(0x7c00, float_to_half(65520.0f).bits);
+    ASSERT_EQ(0x0001, float_to_half(std::ldexp(1.0f, -24)).bits);
+    ASSERT_EQ(0x0000, float_to_half(std::ldexp(1.0f, -25)).bits);
+    ASSERT_EQ(0x0002, float_to_half(std::ldexp(3.0f, -25)).bits);
+    // Ties round to even.
+    ASSERT_EQ(0x3c00, float_to_half(1.0f + std::ldexp(1.0f, -11)).bits);
+    ASSERT_EQ(0x3c02, float_to_half(1.0f + 3 * std::ldexp(1.0f, -11)).bits);
+    ASSERT_EQ(0xbc00, float_to_half(-1.0f).bits);
+
+    ASSERT_EQ(0, quantum_traits<uint16_t>::from_float(-0.5f));
+    ASSERT_EQ(32768, quantum_traits<uint16_t>::from_float(0.5f));
+    ASSERT_EQ(65535, quantum_traits<uint16_t>::from_float(2.0f));
+    for (uint32_t q = 0; q <= 0xffff; q++) {
+        ASSERT_EQ(q, quantum_traits<uint16_t>::from_float(quantum_traits<uint16_t>::to_float(static_cast<uint16_t>(q))));
+    }
+}
@@ -27,8 +27,12 @@
 #include <xyuv/structures/format_template.h>
 #include <xyuv.h>
 #include <xyuv/yuv_image.h>
+#include <xyuv/buffer_pool.h>
+#include <xyuv/codec.h>
+#include <xyuv/executor.h>
 #include "../xyuv/src/config_parser.h"
 #include "TestResources.h"
+#include <algorithm>
 
 using namespace xyuv;
 
@@ -126,6 +130,67 @@ TEST_F(TopLevelAPITest, ScaleYUVImage) {
     ASSERT_SIZE(scaled_image, 4, 4);
 }
 
+TEST_F(TopLevelAPITest, ScaleYUVImageFilters) {
+    const scaling_filter filters[] = { scaling_filter::NEAREST, scaling_filter::BOX, scaling_filter::BILINEAR,
+                                       scaling_filter::BICUBIC, scaling_filter::LANCZOS };
+
+    // Luma is a ramp along x, chroma a step and alpha constant.
+    yuv_image image = create_yuv_image(13, 7, siting_420, true, true, true, true);
+    for (uint32_t y = 0; y < image.image_h; y++) {
+        for (uint32_t x = 0; x < image.image_w; x++) {
+            image.y_plane.set(x, y, x / 16.0f);
+        }
+    }
+    for (uint32_t y = 0; y < image.u_plane.height(); y++) {
+        for (uint32_t x = 0; x < image.u_plane.width(); x++) {
+            image.u_plane.set(x, y, x < 3 ? 0.0f : 1.0f);
+            image.v_plane.set(x, y, 0.25f);
+        }
+    }
+
+    thread_executor exec(3);
+    for (scaling_filter filter : filters) {
+        for (auto size : { std::make_pair(26u, 14u), std::make_pair(5u, 3u), std::make_pair(1u, 1u) }) {
+            yuv_image scaled = scale_yuv_image(image, size.first, size.second, filter);
+            ASSERT_SIZE(scaled, size.first, size.second);
+            ASSERT_EQ(siting_420, scaled.siting);
+            ASSERT_TRUE(scaled.a_plane.is_constant());
+
+            // Constants are preserved and sharpening filters do not overshoot.
+            for (uint32_t y = 0; y < scaled.u_plane.height(); y++) {
+                for (uint32_t x = 0; x < scaled.u_plane.width(); x++) {
+                    ASSERT_NEAR(0.25f, scaled.v_plane.get(x, y), 1e-6f);
+                    ASSERT_GE(scaled.u_plane.get(x, y), 0.0f);
+                    ASSERT_LE(scaled.u_plane.get(x, y), 1.0f);
+                }
+            }
+
+            yuv_image parallel = scale_yuv_image(image, size.first, size.second, filter, exec);
+            ASSERT_TRUE(std::equal(scaled.y_plane.begin(), scaled.y_plane.end(), parallel.y_plane.begin()));
+            ASSERT_TRUE(std::equal(scaled.u_plane.begin(), scaled.u_plane.end(), parallel.u_plane.begin()));
+        }
+    }
+
+    // Nearest neighbour reads the same samples as surface<T>::scale.
+    for (auto size : { std::make_pair(26u, 14u), std::make_pair(5u, 3u), std::make_pair(8u, 9u) }) {
+        surface<pixel_quantum> expected = image.y_plane;
+        expected.scale(size.first, size.second);
+        yuv_image scaled = scale_yuv_image(image, size.first, size.second);
+        ASSERT_TRUE(std::equal(expected.begin(), expected.end(), scaled.y_plane.begin()));
+    }
+
+    // Enlarging a ramp by two interpolates linearly between pixel centres, shrinking by two with a box filter
+    // averages pairs of pixels.
+    yuv_image enlarged = scale_yuv_image(image, 26, 14, scaling_filter::BILINEAR);
+    for (uint32_t x = 1; x < 25; x++) {
+        ASSERT_NEAR(((x + 0.5f) / 2 - 0.5f) / 16.0f, enlarged.y_plane.get(x, 5), 1e-6f);
+    }
+    yuv_image shrunk = scale_yuv_image(enlarged, 13, 7, scaling_filter::BOX);
+    for (uint32_t x = 1; x < 12; x++) {
+        ASSERT_NEAR(x / 16.0f, shrunk.y_plane.get(x, 3), 1e-6f);
+    }
+}
+
 static void fill(surface<pixel_quantum> & surf, pixel_quantum val) {
     for (pixel_quantum & px : surf) {
         px = val;
@@ -167,3 +232,244 @@ TEST_F(TopLevelAPITest, EncodeFrame) {
     frame = encode_frame(image, format);
 
 }
+
+TEST(Surface, ConstantSurface) {
+    surface<float> surf = surface<float>::constant(5, 3, 0.25f);
+    const surface<float> &view = surf;
+    ASSERT_TRUE(surf.is_constant());
+    ASSERT_EQ(0.25f, view.constant_value());
+    ASSERT_EQ(0.25f, view.at(4, 2));
+    ASSERT_EQ(0.25f, view[4][2]);
+    ASSERT_TRUE(surf.is_constant());
+    ASSERT_EQ(15, std::count(view.begin(), view.end(), 0.25f));
+
+    // Filling and scaling keep the surface constant.
+    surf.fill(0.5f);
+    surf.scale(7, 9);
+    ASSERT_TRUE(surf.is_constant());
+    ASSERT_EQ(7u, view.width());
+    ASSERT_EQ(63, std::count(view.begin(), view.end(), 0.5f));
+
+    // Writing allocates the whole surface.
+    surf.set(6, 8, 1.0f);
+    ASSERT_FALSE(surf.is_constant());
+    ASSERT_EQ(62, std::count(view.begin(), view.end(), 0.5f));
+    ASSERT_EQ(1.0f, view.at(6, 8));
+
+    yuv_image image = create_yuv_image(4, 4, Resources::get().config().get_chroma_siting("444"));
+    ASSERT_TRUE(image.a_plane.is_constant());
+    ASSERT_EQ(1.0f, image.a_plane.constant_value());
+}
+
+TEST(Surface, ScalingKeepsBufferPool) {
+    buffer_pool pool;
+    surface<float> surf(6, 4, pool_allocator<float>(pool));
+    surf.scale(9, 5);
+    ASSERT_TRUE(surf.get_allocator().pooled());
+
+    // Scaled images draw every plane from the pool of the input, constant alpha included.
+    yuv_image image = create_yuv_image(8, 8, Resources::get().config().get_chroma_siting("420"), pool);
+    ASSERT_TRUE(image.a_plane.is_constant());
+    yuv_image scaled = scale_yuv_image(image, 12, 6, scaling_filter::BILINEAR);
+    ASSERT_TRUE(scaled.a_plane.is_constant());
+    ASSERT_TRUE(scaled.a_plane.get_allocator().pooled());
+    ASSERT_TRUE(scaled.y_plane.get_allocator().pooled());
+}
+
+TEST(Surface, AlignedRows) {
+    // By default every row starts on a cache line, the padding is skipped by the iterators.
+    surface<float> surf(5, 3);
+    ASSERT_EQ(16u, surf.stride());
+    for (uint32_t y = 0; y < 3; y++) {
+        ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(surf.scanline(y)) % default_row_alignment);
+    }
+    std::fill(surf.begin(), surf.end(), 0.5f);
+    ASSERT_EQ(15, std::count(surf.begin(), surf.end(), 0.5f));
+    ASSERT_EQ(0.5f, surf.at(4, 2));
+    ASSERT_EQ(surf.scanline(1), &surf.at(0, 1));
+
+    ASSERT_EQ(5u, surface<float>(5, 3, 1).stride());
+    ASSERT_EQ(8u, surface<float>(5, 3, 32).stride());
+    ASSERT_EQ(32u, surface<uint16_t>(5, 3).stride());
+    ASSERT_THROW(surface<float>(5, 3, 24), std::logic_error);
+    ASSERT_THROW(surface<float>(5, 3, 128), std::logic_error);
+
+    // The alignment is kept when the surface changes size.
+    surface<float> packed(7, 7, 1);
+    packed.scale(3, 2);
+    ASSERT_EQ(3u, packed.stride());
+    packed.resize(9, 2);
+    ASSERT_EQ(9u, packed.stride());
+    surf.crop(1, 0, 0, 0);
+    ASSERT_EQ(16u, surf.stride());
+    ASSERT_EQ(0.5f, surf.at(3, 2));
+}
+
+TEST(Surface, Views) {
+    surface<float> surf(5, 4);
+    for (uint32_t y = 0; y < 4; y++) {
+        for (uint32_t x = 0; x < 5; x++) {
+            surf.set(x, y, static_cast<float>(y * 10 + x));
+        }
+    }
+
+    // Cropping and flipping refer to the samples of the surface.
+    surface_view<const float> view = surf.view().crop(1, 1, 3, 2);
+    ASSERT_EQ(3u, view.width());
+    ASSERT_EQ(2u, view.height());
+    ASSERT_EQ(static_cast<std::ptrdiff_t>(surf.stride()), view.stride());
+    ASSERT_EQ(11.0f, view.at(0, 0));
+    ASSERT_EQ(23.0f, view.at(2, 1));
+    surface_view<const float> flipped = view.flip_y();
+    ASSERT_EQ(-view.stride(), flipped.stride());
+    ASSERT_EQ(21.0f, flipped.at(0, 0));
+    ASSERT_EQ(13.0f, flipped.at(2, 1));
+    ASSERT_THROW(view.crop(1, 0, 3, 1), std::logic_error);
+
+    surf.mutable_view().flip_y().at(4, 0) = -1.0f;
+    ASSERT_EQ(-1.0f, surf.at(4, 3));
+
+    surface<float> copy(flipped);
+    ASSERT_EQ(3u, copy.width());
+    ASSERT_EQ(21.0f, copy.at(0, 0));
+    ASSERT_EQ(13.0f, copy.at(2, 1));
+
+    surf.crop(1, 2, 0, 1);
+    ASSERT_EQ(4u, surf.width());
+    ASSERT_EQ(1u, surf.height());
+    ASSERT_EQ(21.0f, surf.at(0, 0));
+    surf.crop(2, 0, 2, 0);
+    ASSERT_TRUE(surf.empty());
+
+    // Views of a constant surface are constant.
+    surface<float> constant = surface<float>::constant(6, 6, 0.5f);
+    ASSERT_TRUE(constant.view().crop(2, 3, 4, 2).is_constant());
+    ASSERT_EQ(0.5f, constant.view().flip_y().at(5, 0));
+    ASSERT_TRUE(surface<float>(constant.view()).is_constant());
+}
+
+TEST(YUVImage, CropAndFlipViews) {
+    const config_manager &config = Resources::get().config();
+    yuv_image image = create_yuv_image(6, 4, config.get_chroma_siting("420"));
+    for (uint32_t y = 0; y < 4; y++) {
+        for (uint32_t x = 0; x < 6; x++) {
+            image.y_plane.set(x, y, (y * 6 + x) / 24.0f);
+        }
+    }
+    image.u_plane.set(1, 1, 0.25f);
+
+    const_yuv_image_view view = make_view(image).crop(2, 2, 3, 2);
+    ASSERT_EQ(3u, view.image_w);
+    ASSERT_EQ(2u, view.u_plane.width());
+    ASSERT_EQ(1u, view.u_plane.height());
+    ASSERT_EQ(0.25f, view.u_plane.at(0, 0));
+    ASSERT_EQ(image.y_plane.at(2, 2), view.y_plane.at(0, 0));
+    ASSERT_TRUE(view.a_plane.is_constant());
+    ASSERT_THROW(make_view(image).crop(1, 0, 2, 2), std::logic_error);
+
+    const_yuv_image_view flipped = make_view(image).flip_y();
+    ASSERT_EQ(image.y_plane.at(1, 3), flipped.y_plane.at(1, 0));
+    ASSERT_EQ(0.25f, flipped.u_plane.at(1, 0));
+    ASSERT_EQ(0.5f, flipped.siting.u_sample_point.second);
+
+    // Aligned crops keep the subsampling, others are up-sampled first.
+    yuv_image cropped = crop_yuv_image(image, 2, 2, 1, 0);
+    ASSERT_EQ(3u, cropped.image_w);
+    ASSERT_EQ(2u, cropped.image_h);
+    ASSERT_EQ(2u, cropped.u_plane.width());
+    ASSERT_EQ(image.y_plane.at(4, 3), cropped.y_plane.at(2, 1));
+    ASSERT_TRUE(cropped.a_plane.is_constant());
+
+    cropped = crop_yuv_image(image, 1, 1, 0, 0);
+    ASSERT_TRUE(is_444(cropped.siting.subsampling));
+    ASSERT_EQ(5u, cropped.u_plane.width());
+    ASSERT_EQ(image.y_plane.at(3, 2), cropped.y_plane.at(2, 1));
+    ASSERT_THROW(crop_yuv_image(image, 3, 0, 3, 0), std::logic_error);
+}
+
+TEST(YUVImage, ContiguousPlanes) {
+    const config_manager &config = Resources::get().config();
+    chroma_siting siting = config.get_chroma_siting("420");
+
+    buffer_pool pool;
+    {
+        yuv_image image = create_contiguous_yuv_image(33, 17, siting, pool);
+        std::shared_ptr<plane_arena> arena = image.y_plane.get_allocator().arena();
+        ASSERT_TRUE(arena != nullptr);
+
+        // Every plane lies in the arena at an aligned offset, and is zeroed.
+        for (const surface<pixel_quantum> *plane : { &image.y_plane, &image.u_plane, &image.v_plane }) {
+            ASSERT_TRUE(plane->get_allocator().arena() == arena);
+            const uint8_t *data = reinterpret_cast<const uint8_t *>(plane->data());
+            ASSERT_GE(data, arena->data());
+            ASSERT_LE(data + sizeof(pixel_quantum) * plane->stride() * plane->height(), arena->data() + arena->size());
+            ASSERT_EQ(0u, static_cast<std::size_t>(data - arena->data()) % buffer_alignment);
+            ASSERT_EQ(plane->width() * plane->height(), std::count(plane->begin(), plane->end(), 0.0f));
+        }
+        ASSERT_EQ(1u, pool.stats().misses);
+
+        // The arena has no room for a full alpha plane, writing to it allocates one.
+        image.a_plane.set(0, 0, 0.5f);
+        const uint8_t *alpha = reinterpret_cast<const uint8_t *>(image.a_plane.data());
+        ASSERT_TRUE(alpha < arena->data() || alpha >= arena->data() + arena->size());
+        ASSERT_EQ(0.5f, image.a_plane.at(0, 0));
+        ASSERT_EQ(1.0f, image.a_plane.at(32, 16));
+
+        // Copies and derived images are allocated on their own.
+        surface<pixel_quantum> copy = image.y_plane;
+        ASSERT_TRUE(copy.get_allocator().arena() == nullptr);
+        yuv_image full = up_sample(image);
+        ASSERT_TRUE(full.u_plane.get_allocator().arena() == nullptr);
+    }
+    // The image is recycled as one block.
+    uint64_t misses = pool.stats().misses;
+    ASSERT_EQ(misses, pool.stats().cached_buffers);
+    {
+        yuv_image image = create_contiguous_yuv_image(33, 17, siting, pool);
+        ASSERT_EQ(misses, pool.stats().misses);
+        ASSERT_EQ(1u, pool.stats().hits);
+    }
+
+    // Decoded images are contiguous, and hold the same samples as images allocated per plane. CLJR leaves the samples
+    // of partial blocks undecoded.
+    std::vector<std::pair<std::string, std::string>> formats = { { "NV12", "420" }, { "CLJR", "411" } };
+    for (const auto &entry : formats) {
+        chroma_siting fmt_siting = config.get_chroma_siting(entry.second);
+        format fmt = create_format(33, 17, config.get_format_template(entry.first),
+                                   config.get_conversion_matrix("bt601"), fmt_siting);
+        yuv_image image = create_yuv_image(33, 17, fmt_siting);
+        std::fill(image.y_plane.begin(), image.y_plane.end(), 0.75f);
+        std::fill(image.u_plane.begin(), image.u_plane.end(), 0.25f);
+        frame frame = encode_frame(image, fmt);
+
+        yuv_image decoded = decode_frame(frame);
+        ASSERT_TRUE(decoded.y_plane.get_allocator().arena() != nullptr);
+        ASSERT_TRUE(decoded.y_plane.get_allocator().arena() == decoded.v_plane.get_allocator().arena());
+
+        yuv_image separate;
+        codec(fmt).decode(frame.data.get(), &separate);
+        ASSERT_TRUE(separate.y_plane.get_allocator().arena() == nullptr);
+        ASSERT_TRUE(std::equal(separate.y_plane.begin(), separate.y_plane.end(), decoded.y_plane.begin()));
+        ASSERT_TRUE(std::equal(separate.u_plane.begin(), separate.u_plane.end(), decoded.u_plane.begin()));
+        ASSERT_TRUE(std::equal(separate.v_plane.begin(), separate.v_plane.end(), decoded.v_plane.begin()));
+    }
+
+    // Decoded alpha lies in the arena, which only has room for it if it is decoded to.
+    chroma_siting siting_444 = config.get_chroma_siting("444");
+    format fmt = create_format(33, 17, config.get_format_template("AYUV"), config.get_conversion_matrix("bt601"),
+                               siting_444);
+    frame opaque_frame = encode_frame(create_yuv_image(33, 17, siting_444), fmt);
+    yuv_image decoded = decode_frame(opaque_frame);
+    std::shared_ptr<plane_arena> arena = decoded.a_plane.get_allocator().arena();
+    const uint8_t *alpha = reinterpret_cast<const uint8_t *>(decoded.a_plane.data());
+    ASSERT_TRUE(alpha >= arena->data() && alpha < arena->data() + arena->size());
+
+    codec opaque_codec(fmt);
+    opaque_codec.set_contiguous_planes(true);
+    opaque_codec.set_detect_opaque_alpha(true);
+    yuv_image opaque;
+    opaque_codec.decode(opaque_frame.data.get(), &opaque);
+    ASSERT_TRUE(opaque.a_plane.is_constant());
+    ASSERT_EQ(arena->size() - sizeof(pixel_quantum) * decoded.a_plane.stride() * decoded.a_plane.height(),
+              opaque.y_plane.get_allocator().arena()->size());
+}
@@ -24,7 +24,11 @@
 
 #pragma once
 
+#include "xyuv/quantum.h"
+#include "xyuv/structures/constants.h"
+
 #include <cstdint>
+#include <functional>
 #include <iosfwd>
 
 //! \file High level interface to libxyuv.
@@ -57,11 +61,19 @@ struct format;
 struct frame;
 
 //! A yuv image is the intermediate representation of an image. Stored in a high precision internal format.
-struct yuv_image;
+template<typename T>
+struct basic_yuv_image;
+using yuv_image = basic_yuv_image<pixel_quantum>;
 
 //! An rgb image is an interface-class to simplify interaction of libxyuv to other image libraries.
 class rgb_image;
 
+//! An executor runs the independent tasks of parallel operations. See xyuv/executor.h.
+class executor;
+
+//! A buffer pool recycles the storage of frames and surfaces. See xyuv/buffer_pool.h.
+class buffer_pool;
+
 ///////////////////////////////////////////
 // High level interface
 ///////////////////////////////////////////
@@ -83,6 +95,16 @@ xyuv::frame create_frame(
         uint64_t raw_data_size
 );
 
+//! \brief Initialize a xyuv::frame from a xyuv::format and raw data, drawing the frame data from \a pool.
+//! \details Same as create_frame(const xyuv::format &, const uint8_t *, uint64_t), but the buffer is returned to
+//! \a pool when the frame is destroyed. The contents of the buffer are unspecified if \a raw_data is nullptr.
+xyuv::frame create_frame(
+        const xyuv::format &format,
+        const uint8_t *raw_data,
+        uint64_t raw_data_size,
+        buffer_pool &pool
+);
+
 //! \brief Initialize a format struct from a format_template.
 //! \details This will combine a xyuv::format_template, a xyuv::conversion_template and a xyuv::chroma_siting to create
 //! a format struct describing the pixel-format of a single image.
@@ -134,7 +156,8 @@ void write_frame(
 //! using xyuv::write_frame().
 //! \warning \a istream should be opened in binary mode.
 //! \param [in] istream C++ standard library binary input stream from which to load the frame.
-//! \param [out] frame pointer to an object object where the values should be stored.
+//! \param [out] frame pointer to an object object where the values should be stored. If it already holds data of the
+//!             same size as the frame read, its buffer is reused.
 void read_frame(
         xyuv::frame *frame,
         std::istream &istream
@@ -169,13 +192,31 @@ void write_frame_to_rgb_image(rgb_image *rgbImage_out, const xyuv::frame &frame_
 //! \brief Decode a frame to a xyuv::yuv_image.
 //!
 //! \details This will unpack the pixel-data in the frame, but will leave any sub-sampling unchanged. i.e. if you have a
-//! 420 sub-sampled frame, your yuv_image will also be 420 sub-sampled.
+//! 420 sub-sampled frame, your yuv_image will also be 420 sub-sampled. The planes of the result share a single
+//! allocation, see create_contiguous_yuv_image().
 //! \info The returned yuv_image has not concept of rgb<->yuv conversion, so users will have to maintain this separately.
 //!       See the xyuv::yuv_imgage and xyuv::conversion_matrix for details.
 //! \param [in] frame_in frame to decode.
 //! \returns yuv_image containing the decoded frame.
 yuv_image decode_frame(const xyuv::frame &frame_in);
 
+//! \brief Decode a frame to a xyuv::yuv_image, using \a exec to unpack the pixels in parallel.
+//!
+//! \details Same as decode_frame(const xyuv::frame &), the result is identical. See codec::set_executor().
+//! \param [in] frame_in frame to decode.
+//! \param [in] exec executor running the work, e.g. a xyuv::thread_executor.
+//! \returns yuv_image containing the decoded frame.
+yuv_image decode_frame(const xyuv::frame &frame_in, executor &exec);
+
+//! \brief Decode a frame to a xyuv::yuv_image with planes drawn from \a pool.
+//! \details Same as decode_frame(const xyuv::frame &), but the planes return their storage to \a pool when
+//!          destroyed, and conversions of the image (e.g. up_sample()) draw from the same pool. See
+//!          codec::set_buffer_pool().
+//! \param [in] frame_in frame to decode.
+//! \param [in] pool buffer pool to draw from, it must outlive the image.
+//! \returns yuv_image containing the decoded frame.
+yuv_image decode_frame(const xyuv::frame &frame_in, buffer_pool &pool);
+
 //! \brief Encode a xyuv::yuv_image to a xyuv::frame.
 //!
 //! \details Encode the image data in the yuv_image into a frame using the supplied format.
@@ -184,16 +225,123 @@ yuv_image decode_frame(const xyuv::frame &frame_in);
 //! \returns A new xyuv::frame with the new pixel data of \a yuva, now converted to the new format.
  xyuv::frame encode_frame(const yuv_image &yuva, const xyuv::format &format);
 
+//! \brief Encode a xyuv::yuv_image to a xyuv::frame, using \a exec to pack the pixels in parallel.
+//!
+//! \details Same as encode_frame(const yuv_image &, const xyuv::format &), the result is identical.
+//!          See codec::set_executor().
+//! \param [in] yuva image data to write to the frame.
+//! \param [in] format target format of the frame.
+//! \param [in] exec executor running the work, e.g. a xyuv::thread_executor.
+//! \returns A new xyuv::frame with the new pixel data of \a yuva, now converted to the new format.
+xyuv::frame encode_frame(const yuv_image &yuva, const xyuv::format &format, executor &exec);
+
+//! \brief Encode a xyuv::yuv_image to a xyuv::frame, consuming the image.
+//! \details Same as encode_frame(const yuv_image &, const xyuv::format &), but the planes of \a yuva are moved into
+//!          the intermediate images of the conversion rather than copied.
+xyuv::frame encode_frame(yuv_image &&yuva, const xyuv::format &format);
+
+//! \brief Encode a xyuv::yuv_image to a xyuv::frame in parallel, consuming the image.
+//! \details Same as encode_frame(const yuv_image &, const xyuv::format &, executor &), but the planes of \a yuva are
+//!          moved into the intermediate images of the conversion rather than copied.
+xyuv::frame encode_frame(yuv_image &&yuva, const xyuv::format &format, executor &exec);
+
+//! \brief Encode a xyuv::yuv_image to a xyuv::frame with frame data drawn from \a pool.
+//! \details Same as encode_frame(const yuv_image &, const xyuv::format &), but the frame returns its buffer to
+//!          \a pool when destroyed.
+xyuv::frame encode_frame(const yuv_image &yuva, const xyuv::format &format, buffer_pool &pool);
+
+//! \brief Decode a frame band by band.
+//!
+//! \details Instead of materialising the whole frame, \a callback receives the decoded rows in bands of about
+//!          \a band_height luma rows (and the matching chroma rows) as soon as each is ready, see codec::decode_bands().
+//! \param [in] frame_in frame to decode.
+//! \param [in] band_height number of luma rows per band, rounded up to whole blocks of the format.
+//! \param [in] callback called with the first row and the yuv_image of each band, from top to bottom.
+void decode_frame_bands(const xyuv::frame &frame_in, uint32_t band_height,
+                        const std::function<void(uint32_t first_row, const yuv_image &band)> &callback);
+
+//! \brief Decode a rectangle of a frame to a xyuv::yuv_image.
+//!
+//! \details Same as cropping the result of decode_frame(), but only the blocks overlapping the rectangle are unpacked.
+//!          The rectangle must start on a macro pixel of the chroma subsampling, see codec::decode_region().
+//! \param [in] frame_in frame to decode.
+//! \param [in] x left column of the rectangle.
+//! \param [in] y top row of the rectangle.
+//! \param [in] w width of the rectangle.
+//! \param [in] h height of the rectangle.
+//! \returns yuv_image of size \a w x \a h holding the pixels of the rectangle.
+//! \throw std::logic_error if the rectangle is empty, not inside the frame or not aligned to the subsampling.
+yuv_image decode_frame_region(const xyuv::frame &frame_in, uint32_t x, uint32_t y, uint32_t w, uint32_t h);
+
+//! \brief Decode a frame into an existing xyuv::yuv_image.
+//!
+//! \details Same as decode_frame(const xyuv::frame &), but the pixels are written to the storage of \a yuva_out
+//!          instead of a newly allocated image.
+//! \param [in] frame_in frame to decode.
+//! \param [out] yuva_out image to decode to. It must have the dimensions, siting and channels of the frame, e.g. as
+//!             created by create_yuv_image() (alpha is only present if the format has an alpha channel). Besides
+//!             float, the samples may be stored as half or uint16_t, see xyuv::quantum_traits.
+//! \throw std::logic_error if \a yuva_out does not match the format of \a frame_in.
+template<typename T>
+void decode_frame_into(const xyuv::frame &frame_in, basic_yuv_image<T> *yuva_out);
+
+//! \brief Decode a frame into an existing xyuv::yuv_image, using \a exec to unpack the pixels in parallel.
+//!
+//! \details Same as decode_frame_into(const xyuv::frame &, basic_yuv_image<T> *). See codec::set_executor().
+template<typename T>
+void decode_frame_into(const xyuv::frame &frame_in, basic_yuv_image<T> *yuva_out, executor &exec);
+
+//! \brief Encode a xyuv::yuv_image into caller owned memory, e.g. a mapped or DMA buffer.
+//!
+//! \details Unlike encode_frame(), no buffer is allocated and the image is not converted: \a yuva must already have
+//!          the dimensions and subsampling of \a format. Only the bits holding pixel data are written, padding in
+//!          \a dst is left untouched. To encode many frames of the same format, see xyuv::codec.
+//! \param [in] yuva image data to write, with float, half or uint16_t samples.
+//! \param [in] format format of the packed pixels.
+//! \param [out] dst destination of the packed pixels.
+//! \param [in] dst_size size of \a dst in bytes, must be at least format.size.
+//! \throw std::logic_error if \a dst is too small or \a yuva does not match \a format.
+template<typename T>
+void encode_frame_into(const basic_yuv_image<T> &yuva, const xyuv::format &format, uint8_t *dst, uint64_t dst_size);
+
+//! \brief Encode a xyuv::yuv_image into caller owned memory, using \a exec to pack the pixels in parallel.
+//!
+//! \details Same as encode_frame_into(const basic_yuv_image<T> &, const xyuv::format &, uint8_t *, uint64_t).
+//!          See codec::set_executor().
+template<typename T>
+void encode_frame_into(const basic_yuv_image<T> &yuva, const xyuv::format &format, uint8_t *dst, uint64_t dst_size,
+                       executor &exec);
+
 //! \brief Upsample a yuv_image to full resolution.
 //!
 //! \details This will return a copy of the input image that is <b>not</b> subsampled, i.e. has one sample per channel, per pixel.
-//! \info Currently this will simply copy the single sample into each of it's corresponding pixels, in future releases
-//!       it may also include interpolation.
+//!          Each chroma sample is copied into all pixels of its block, see up_sample(const yuv_image &, upsampling_filter)
+//!          for interpolation.
 //! \param [in] yuva_in input yuv_image.
 //! \returns A copy of the subsampled image up-sampled to full resolution.
 //! \todo Split mid-level tell-don't-ask functions. And move the low-level interface internally.
 yuv_image up_sample(const yuv_image &yuva_in);
 
+//! \brief Upsample a yuv_image to full resolution, consuming the input.
+//! \details Same as up_sample(const yuv_image &), but the luma and alpha planes are moved into the result instead of
+//!          copied. A 444 image is returned as is.
+yuv_image up_sample(yuv_image &&yuva_in);
+
+//! \brief Upsample a yuv_image to full resolution using \a filter.
+//!
+//! \details With upsampling_filter::BILINEAR every pixel is linearly interpolated between the (<= four) chroma samples
+//!          closest to it, taking the sample points of the chroma siting of \a yuva_in into account. Samples outside the
+//!          image are clamped to the edge.
+//! \param [in] yuva_in input yuv_image.
+//! \param [in] filter filter reconstructing the full resolution chroma.
+//! \returns A copy of the subsampled image up-sampled to full resolution.
+yuv_image up_sample(const yuv_image &yuva_in, upsampling_filter filter);
+
+//! \brief Upsample a yuv_image to full resolution using \a filter, consuming the input.
+//! \details Same as up_sample(const yuv_image &, upsampling_filter), but the luma and alpha planes are moved into the
+//!          result instead of copied.
+yuv_image up_sample(yuv_image &&yuva_in, upsampling_filter filter);
+
 //! \brief Downsample a yuv_image.
 //!
 //! \details Subsample a yuv_image using the supplied chroma_siting. The input yuv_image may be of any sub_sampling,
@@ -204,6 +352,26 @@ yuv_image up_sample(const yuv_image &yuva_in);
 //! \todo Split mid-level tell-don't-ask functions. And move the low-level interface internally.
 yuv_image down_sample(const yuv_image &yuva_in, const chroma_siting &siting);
 
+//! \brief Downsample a yuv_image, consuming the input.
+//! \details Same as down_sample(const yuv_image &, const chroma_siting &), but the luma and alpha planes are moved into
+//!          the result instead of copied.
+yuv_image down_sample(yuv_image &&yuva_in, const chroma_siting &siting);
+
+//! \brief Move the chroma samples of a yuv_image to the sample points of another chroma_siting of the same subsampling.
+//!
+//! \details The chroma planes are resampled directly at their subsampled resolution, each new sample is linearly
+//!          interpolated between the two samples closest to its sample point. Samples outside the image are clamped
+//!          to the edge.
+//! \param [in] yuva_in image to convert.
+//! \param [in] siting target chroma_siting, must have the same subsampling as \a yuva_in.
+//! \throw std::logic_error if the subsampling of \a siting differs from that of \a yuva_in.
+yuv_image resite_chroma(const yuv_image &yuva_in, const chroma_siting &siting);
+
+//! \brief Move the chroma samples of a yuv_image to new sample points, consuming the input.
+//! \details Same as resite_chroma(const yuv_image &, const chroma_siting &), but the luma and alpha planes are moved
+//!          into the result instead of copied.
+yuv_image resite_chroma(yuv_image &&yuva_in, const chroma_siting &siting);
+
 //! \brief Write a frame using the xyuv::rgb_image interface.
 //!
 //! \details This function will write a yuv_image to an RGB image using the xyuv::rgb_image interface.
@@ -220,25 +388,59 @@ void yuv_image_to_rgb(rgb_image *rgbImage_out, const yuv_image &yuva_444, const
 //! \returns A new xyuv::yuv_image with the new pixel data of \a rgbImage_in.
 yuv_image rgb_to_yuv_image(const rgb_image &rgbImage_in, const xyuv::conversion_matrix &conversion);
 
-//! \brief Scale a 444 yuv_image.
+//! \brief Scale a yuv_image.
 //!
-//! \details Change the dimensions of a 444 yuv_image.
-//! \pre \a yuva_444 is has subsampling 444.
-//! \param [in] yuva_444, image to scale. Must be 444 sampled.
+//! \details Change the dimensions of a yuv_image using nearest neighbour sampling, see
+//!          scale_yuv_image(const yuv_image &, uint32_t, uint32_t, scaling_filter).
+//! \param [in] yuva_in, image to scale.
 //! \param [in] new_width, target width.
 //! \param [in] new_height, target height.
 //! \returns A new scaled yuv_image.
-yuv_image scale_yuv_image(const yuv_image &yuva_444, uint32_t new_width, uint32_t new_height);
+yuv_image scale_yuv_image(const yuv_image &yuva_in, uint32_t new_width, uint32_t new_height);
+
+//! \brief Scale a yuv_image using \a filter.
+//!
+//! \details Every plane is resampled by a separable polyphase filter. Subsampled chroma planes are scaled at their
+//!          own resolution and keep the chroma siting of \a yuva_in, the sample points are mapped between the images.
+//!          Samples outside the image are clamped to the edge.
+//! \param [in] yuva_in, image to scale.
+//! \param [in] new_width, target width.
+//! \param [in] new_height, target height.
+//! \param [in] filter, resampling filter.
+//! \returns A new scaled yuv_image.
+yuv_image scale_yuv_image(const yuv_image &yuva_in, uint32_t new_width, uint32_t new_height, scaling_filter filter);
+
+//! \brief Scale a yuv_image using \a filter, resampling ranges of rows in parallel.
+//! \details Same as scale_yuv_image(const yuv_image &, uint32_t, uint32_t, scaling_filter), the result is identical.
+//! \param [in] exec executor running the work, e.g. a xyuv::thread_executor.
+yuv_image scale_yuv_image(const yuv_image &yuva_in, uint32_t new_width, uint32_t new_height, scaling_filter filter,
+                          executor &exec);
+
+//! \brief Scale a yuv_image, consuming the input.
+//! \details Same as scale_yuv_image(const yuv_image &, uint32_t, uint32_t), but an image that already has the new
+//!          dimensions is returned as is, and every plane of \a yuva_in is released as soon as it has been scaled.
+yuv_image scale_yuv_image(yuv_image &&yuva_in, uint32_t new_width, uint32_t new_height);
+
+//! \brief Scale a yuv_image using \a filter, consuming the input.
+//! \details See scale_yuv_image(yuv_image &&, uint32_t, uint32_t).
+yuv_image scale_yuv_image(yuv_image &&yuva_in, uint32_t new_width, uint32_t new_height, scaling_filter filter);
+
+//! \brief Scale a yuv_image using \a filter in parallel, consuming the input.
+//! \details See scale_yuv_image(yuv_image &&, uint32_t, uint32_t).
+yuv_image scale_yuv_image(yuv_image &&yuva_in, uint32_t new_width, uint32_t new_height, scaling_filter filter,
+                          executor &exec);
 
 //! \brief Crop a yuv_image.
 //!
-//! \details Crop away the edges of a 444 yuv_image.
-//! \pre \a yuva_444 is has subsampling 444.
-//! \param [in] yuva_444 input. Must be 444 sampled.
+//! \details Crop away the edges of a yuv_image. If the new top left corner is not the corner of a macro pixel, the
+//!          image is up-sampled to 444 first, otherwise the subsampling is kept. Use make_view() and
+//!          basic_yuv_image_view::crop() to crop without copying the samples.
+//! \param [in] yuva_444 input.
 //! \param [in] left columns to crop from the left.
 //! \param [in] top rows to crop from the top.
 //! \param [in] right columns to crop from the right.
 //! \param [in] bottom  rows to crop from the bottom.
+//! \throw std::logic_error if nothing of the image would be left.
 yuv_image crop_yuv_image(
         const yuv_image &yuva_444,
         uint32_t left,
@@ -0,0 +1,80 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+
+namespace xyuv {
+
+//! \brief Standard allocator returning storage aligned to \a Alignment bytes.
+//! \details Used by surface so that rows can be loaded with aligned vector instructions.
+//! \tparam Alignment a power of two, at least alignof(T).
+template<typename T, std::size_t Alignment>
+class aligned_allocator {
+    static_assert((Alignment & (Alignment - 1)) == 0, "The alignment must be a power of two.");
+    static_assert(Alignment >= alignof(void *), "The alignment must be at least that of a pointer.");
+
+public:
+    using value_type = T;
+
+    template<typename U>
+    struct rebind {
+        using other = aligned_allocator<U, Alignment>;
+    };
+
+    aligned_allocator() = default;
+
+    template<typename U>
+    aligned_allocator(const aligned_allocator<U, Alignment> &) { }
+
+    //! \brief Allocate storage for \a n objects, the first starting on a multiple of \a Alignment bytes.
+    T *allocate(std::size_t n) {
+        if (n > (std::numeric_limits<std::size_t>::max() - Alignment) / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        // Over-allocate, and keep the pointer returned by operator new just before the aligned block.
+        void *raw = ::operator new(n * sizeof(T) + Alignment);
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + Alignment) & ~static_cast<uintptr_t>(Alignment - 1);
+        reinterpret_cast<void **>(aligned)[-1] = raw;
+        return reinterpret_cast<T *>(aligned);
+    }
+
+    void deallocate(T *ptr, std::size_t) {
+        if (ptr) {
+            ::operator delete(reinterpret_cast<void **>(ptr)[-1]);
+        }
+    }
+};
+
+template<typename T, typename U, std::size_t Alignment>
+bool operator==(const aligned_allocator<T, Alignment> &, const aligned_allocator<U, Alignment> &) { return true; }
+
+template<typename T, typename U, std::size_t Alignment>
+bool operator!=(const aligned_allocator<T, Alignment> &, const aligned_allocator<U, Alignment> &) { return false; }
+
+} // namespace xyuv
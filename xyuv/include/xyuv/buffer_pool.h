@@ -0,0 +1,282 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "aligned_allocator.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace xyuv {
+
+//! \brief Alignment in bytes of every buffer handed out by a buffer_pool.
+constexpr std::size_t buffer_alignment = 64;
+
+class buffer_deleter;
+class plane_arena;
+template<typename T> class pool_allocator;
+class uninitialised_scope;
+
+//! \brief A thread safe cache of memory buffers, keyed by their size in bytes.
+//!
+//! \details Buffers returned to the pool are kept and handed out again to the next request of the same size, so
+//! processing a stream of frames of a fixed format stops allocating after the first frame. Frames
+//! (see create_frame(), encode_frame() and codec::set_buffer_pool()) and surfaces (through pool_allocator) can draw
+//! their storage from a pool.
+//!
+//! Buffers live independently of the buffer_pool object: a buffer freed after the pool is destroyed is released to the
+//! system instead of being cached.
+class buffer_pool {
+public:
+    //! \brief Counters describing the use of a buffer_pool.
+    struct statistics {
+        //! Number of requests served by a cached buffer.
+        uint64_t hits;
+        //! Number of requests that had to allocate a new buffer.
+        uint64_t misses;
+        //! Number of buffers currently cached for reuse.
+        uint64_t cached_buffers;
+        //! Total size in bytes of the cached buffers.
+        uint64_t cached_bytes;
+    };
+
+    //! \brief Create an empty pool.
+    //! \param [in] huge_pages back buffers of at least 2 MiB by huge pages. MAP_HUGETLB is tried first, then
+    //!             transparent huge pages. Ignored on platforms other than Linux.
+    explicit buffer_pool(bool huge_pages = false);
+
+    ~buffer_pool();
+
+    buffer_pool(const buffer_pool &) = delete;
+    buffer_pool &operator=(const buffer_pool &) = delete;
+
+    //! \brief Get a buffer of \a size bytes aligned to buffer_alignment, reusing a cached one when available.
+    //! \throw std::bad_alloc if the buffer cannot be allocated.
+    void *allocate(std::size_t size);
+
+    //! \brief Return a buffer obtained from allocate(\a size) to the pool.
+    void deallocate(void *buffer, std::size_t size);
+
+    //! \brief Get a buffer of \a size bytes for xyuv::frame::data, returned to the pool when the frame releases it.
+    std::unique_ptr<uint8_t[], buffer_deleter> acquire(std::size_t size);
+
+    //! \brief Release all cached buffers to the system.
+    void trim();
+
+    //! \brief Get a snapshot of the counters of the pool.
+    statistics stats() const;
+
+private:
+    struct cache;
+
+    static void *allocate(cache &cache, std::size_t size);
+    static void deallocate(cache &cache, void *buffer, std::size_t size);
+
+    std::shared_ptr<cache> cache_;
+
+    friend class buffer_deleter;
+    friend class plane_arena;
+    template<typename T> friend class pool_allocator;
+};
+
+//! \brief Deleter of xyuv::frame::data, returning a buffer to the buffer_pool it came from.
+//! \details A default constructed deleter frees buffers allocated by new uint8_t[].
+class buffer_deleter {
+public:
+    buffer_deleter() = default;
+
+    //! \brief Allows std::unique_ptr<uint8_t[]> to be moved into xyuv::frame::data.
+    buffer_deleter(const std::default_delete<uint8_t[]> &) { }
+
+    void operator()(uint8_t *buffer) const {
+        if (cache_) {
+            buffer_pool::deallocate(*cache_, buffer, size_);
+        } else {
+            delete[] buffer;
+        }
+    }
+
+private:
+    buffer_deleter(std::shared_ptr<buffer_pool::cache> cache, std::size_t size)
+        : cache_(std::move(cache)), size_(size) { }
+
+    std::shared_ptr<buffer_pool::cache> cache_;
+    std::size_t size_ = 0;
+
+    friend class buffer_pool;
+};
+
+//! \brief Storage of xyuv::frame::data.
+using frame_buffer = std::unique_ptr<uint8_t[], buffer_deleter>;
+
+//! \brief A single buffer holding several planes, each in its own slot starting on a multiple of buffer_alignment.
+//! \details See create_contiguous_yuv_image(). Surfaces use the arena through a pool_allocator bound to it, and the
+//! buffer is released (or returned to the buffer_pool it came from) as one block once the last of them is destroyed.
+class plane_arena {
+public:
+    //! \brief Allocate an arena with one slot of every size in \a slot_sizes (in bytes).
+    //! \param [in] pool buffer pool to draw the buffer from, or nullptr to allocate it normally.
+    static std::shared_ptr<plane_arena> create(const std::vector<std::size_t> &slot_sizes, buffer_pool *pool);
+
+    ~plane_arena();
+
+    plane_arena(const plane_arena &) = delete;
+    plane_arena &operator=(const plane_arena &) = delete;
+
+    //! \brief Get the start of the buffer, e.g. to hand a whole image over to another API.
+    uint8_t *data() const { return base_; }
+
+    //! \brief Get the size of the buffer in bytes.
+    std::size_t size() const { return size_; }
+
+    //! \brief Claim a free slot of exactly \a size bytes.
+    //! \returns the start of the slot, or nullptr if there is no such slot. Thread safe.
+    void *take(std::size_t size);
+
+    //! \brief Free the slot starting at \a buffer.
+    //! \returns false if \a buffer is not a slot of the arena. Thread safe.
+    bool give_back(void *buffer);
+
+private:
+    plane_arena() = default;
+
+    struct slot {
+        std::size_t offset = 0, size = 0;
+        std::atomic<bool> in_use;
+    };
+
+    uint8_t *base_ = nullptr;
+    std::size_t size_ = 0;
+    std::shared_ptr<buffer_pool::cache> cache_;
+    std::unique_ptr<slot[]> slots_;
+    std::size_t n_slots_ = 0;
+
+    // Set by the decoder while it creates planes it overwrites anyway, see pool_allocator::construct().
+    bool uninitialised_ = false;
+
+    template<typename T> friend class pool_allocator;
+    friend class uninitialised_scope;
+};
+
+//! \brief Standard allocator drawing from a buffer_pool, used for the storage of surfaces.
+//! \details A default constructed pool_allocator does not use a pool. The allocator follows the storage when a
+//! container is moved or swapped, so a surface keeps returning its storage to the pool it was allocated from.
+//!
+//! An allocator bound to a plane_arena serves requests of the size of a free slot from the arena.
+template<typename T>
+class pool_allocator {
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    pool_allocator() = default;
+
+    //! \brief Create an allocator drawing from \a pool.
+    pool_allocator(buffer_pool &pool) : cache_(pool.cache_) { }
+
+    //! \brief Create an allocator bound to \a arena, drawing from the buffer_pool of the arena (if any) otherwise.
+    explicit pool_allocator(std::shared_ptr<plane_arena> arena) : cache_(arena->cache_), arena_(std::move(arena)) { }
+
+    template<typename U>
+    pool_allocator(const pool_allocator<U> &rhs) : cache_(rhs.cache_), arena_(rhs.arena_) { }
+
+    //! \brief Copies of a container (and thereby of a surface) do not draw from the arena of the original.
+    pool_allocator select_on_container_copy_construction() const { return detached(); }
+
+    //! \brief Allocate storage for \a n objects aligned to buffer_alignment.
+    T *allocate(std::size_t n) {
+        if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        if (arena_) {
+            if (void *slot = arena_->take(n * sizeof(T))) {
+                return static_cast<T *>(slot);
+            }
+        }
+        if (!cache_) {
+            return aligned_allocator<T, buffer_alignment>().allocate(n);
+        }
+        return static_cast<T *>(buffer_pool::allocate(*cache_, n * sizeof(T)));
+    }
+
+    void deallocate(T *ptr, std::size_t n) {
+        if (arena_ && arena_->give_back(ptr)) {
+            return;
+        }
+        if (!cache_) {
+            aligned_allocator<T, buffer_alignment>().deallocate(ptr, n);
+        } else if (ptr) {
+            buffer_pool::deallocate(*cache_, ptr, n * sizeof(T));
+        }
+    }
+
+    template<typename U, typename... Args>
+    void construct(U *ptr, Args &&... args) { ::new(static_cast<void *>(ptr)) U(std::forward<Args>(args)...); }
+
+    //! \brief Value-initialise, unless the decoder is creating the planes of the arena the allocator is bound to.
+    template<typename U>
+    void construct(U *ptr) {
+        if (arena_ && arena_->uninitialised_) {
+            ::new(static_cast<void *>(ptr)) U;
+        } else {
+            ::new(static_cast<void *>(ptr)) U();
+        }
+    }
+
+    //! \brief True if the allocator draws from a buffer_pool.
+    bool pooled() const { return static_cast<bool>(cache_); }
+
+    //! \brief Get the arena the allocator is bound to, or nullptr.
+    const std::shared_ptr<plane_arena> &arena() const { return arena_; }
+
+    //! \brief Get an allocator drawing from the same buffer_pool, but not bound to a plane_arena.
+    pool_allocator detached() const {
+        pool_allocator result;
+        result.cache_ = cache_;
+        return result;
+    }
+
+    template<typename U>
+    bool operator==(const pool_allocator<U> &rhs) const { return cache_ == rhs.cache_ && arena_ == rhs.arena_; }
+
+    template<typename U>
+    bool operator!=(const pool_allocator<U> &rhs) const { return !(*this == rhs); }
+
+private:
+    std::shared_ptr<buffer_pool::cache> cache_;
+    std::shared_ptr<plane_arena> arena_;
+
+    template<typename U> friend class pool_allocator;
+};
+
+} // namespace xyuv
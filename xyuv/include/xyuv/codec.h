@@ -0,0 +1,197 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "structures/format.h"
+#include "executor.h"
+#include "quantum.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace xyuv {
+
+template<typename T>
+struct basic_yuv_image;
+template<typename T>
+struct basic_yuv_image_view;
+using yuv_image = basic_yuv_image<pixel_quantum>;
+struct pack_plan;
+class buffer_pool;
+
+//! \brief Receives the bands of a streaming decode, see codec::decode_bands().
+//! \param first_row row of the frame held by the first row of \a band.
+//! \param band the decoded rows, with the width and siting of the frame.
+using band_callback = std::function<void(uint32_t first_row, const yuv_image &band)>;
+
+//! \brief Class to en-/decode many frames of the same format.
+//!
+//! \details encode_frame() and decode_frame() have to work out the sample layout, plane strides and interleaving of
+//!          the format on every call. A codec does this work once, when it is constructed, and keeps the result so
+//!          that encoding and decoding a frame only costs the pixel loop.
+//!
+//! \code{.cpp}
+//! xyuv::codec codec(format);
+//! std::unique_ptr<uint8_t[]> buffer(new uint8_t[format.size]);
+//!
+//! for (auto & image : images) {
+//!     codec.encode(image, buffer.get());
+//!     // Use the packed pixels in buffer...
+//! }
+//! \endcode
+class codec {
+public:
+    //! \brief Compile \a format into a codec.
+    //! \throw std::logic_error if the format is not supported by the pixel packer.
+    explicit codec(const xyuv::format &format);
+
+    ~codec();
+
+    codec(codec &&rhs);
+    codec &operator=(codec &&rhs);
+
+    //! \brief Get the format this codec was compiled for.
+    const xyuv::format &format() const { return format_; }
+
+    //! \brief Encode \a yuva_in into \a buffer.
+    //! \details Only the bits holding pixel data are written, the remaining bytes of \a buffer are left untouched.
+    //! \pre \a yuva_in must have the dimensions and subsampling of format(). (See encode_frame() for a function that
+    //!      will convert the image first.)
+    //! \param [in] yuva_in image to encode.
+    //! \param [out] buffer destination, must be at least format().size bytes large.
+    //! \throw std::logic_error if \a yuva_in does not match the format.
+    //! \tparam T the sample storage type of the image, float, half or uint16_t.
+    template<typename T>
+    void encode(const basic_yuv_image<T> &yuva_in, uint8_t *buffer) const;
+
+    //! \brief Encode the image viewed by \a yuva_in into \a buffer.
+    //! \details Same as encode(const basic_yuv_image<T> &, uint8_t *) const, but the planes may be cropped, flipped or
+    //!          shared views of other images. See basic_yuv_image_view.
+    //! \throw std::logic_error if \a yuva_in does not match the format.
+    template<typename T>
+    void encode(const basic_yuv_image_view<const T> &yuva_in, uint8_t *buffer) const;
+
+    //! \brief Decode the frame data in \a buffer into \a yuva_out.
+    //! \details If \a yuva_out already has the dimensions, siting and channels of format() its storage is reused,
+    //!          otherwise it is reinitialised as if by create_yuv_image().
+    //! \param [in] buffer frame data, must be at least format().size bytes large.
+    //! \param [out] yuva_out image to decode to.
+    //! \tparam T the sample storage type of the image, float, half or uint16_t.
+    template<typename T>
+    void decode(const uint8_t *buffer, basic_yuv_image<T> *yuva_out) const;
+
+    //! \brief Decode the frame data in \a buffer into the samples viewed by \a yuva_out.
+    //! \details Unlike decode(const uint8_t *, basic_yuv_image<T> *) const, the storage cannot be reinitialised: every
+    //!          sample of the view is overwritten, e.g. to decode straight into a flipped view or into a region of a
+    //!          larger image.
+    //! \param [in] buffer frame data, must be at least format().size bytes large.
+    //! \param [out] yuva_out view to decode to.
+    //! \throw std::logic_error if \a yuva_out does not have the dimensions, siting and channels of format(), or a plane of
+    //!        a present channel is a constant view.
+    template<typename T>
+    void decode(const uint8_t *buffer, const basic_yuv_image_view<T> &yuva_out) const;
+
+    //! \brief Decode the pixels in the rectangle at (\a x, \a y) of size \a w x \a h into \a yuva_out.
+    //! \details Only the block lines and blocks overlapping the rectangle are unpacked. The result is the same as
+    //!          cropping the decoded frame: \a yuva_out gets the dimensions \a w x \a h and the siting of format(), with
+    //!          chroma planes covering the macro pixels of the rectangle. Its storage is reused if it already matches.
+    //! \param [in] buffer frame data, must be at least format().size bytes large.
+    //! \param [in] x left column of the rectangle, must be a multiple of the macro pixel width of the subsampling.
+    //! \param [in] y top row of the rectangle (in image order, regardless of origin), must be a multiple of the
+    //!             macro pixel height of the subsampling.
+    //! \param [in] w width of the rectangle.
+    //! \param [in] h height of the rectangle.
+    //! \param [out] yuva_out image to decode to.
+    //! \throw std::logic_error if the rectangle is empty, not inside the frame or not aligned to the subsampling.
+    template<typename T>
+    void decode_region(const uint8_t *buffer, uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                       basic_yuv_image<T> *yuva_out) const;
+
+    //! \brief Decode the frame data in \a buffer in horizontal bands, handing each to \a callback as soon as it is ready.
+    //! \details Bands are produced top to bottom (in image order, regardless of origin) and each is the same as the
+    //!          corresponding decode_region() of the full width, so only one band is held in memory at a time.
+    //! \param [in] buffer frame data, must be at least format().size bytes large.
+    //! \param [in] band_height number of luma rows per band. It is rounded up to whole block lines of every channel
+    //!             and whole macro pixels of the subsampling, the last band may be shorter.
+    //! \param [in] callback called once per band, the band is only valid for the duration of the call.
+    void decode_bands(const uint8_t *buffer, uint32_t band_height, const band_callback &callback) const;
+
+    //! \brief Check whether \a yuva has the dimensions, siting and channels of format().
+    //! \details decode() reuses the storage of such an image instead of reallocating it.
+    template<typename T>
+    bool matches(const basic_yuv_image<T> &yuva) const;
+
+    //! \brief Run encode() and decode() in parallel on \a exec.
+    //! \details The work is split by channel and by ranges of block lines, such that every task writes its own bytes
+    //!          of the frame (or rows of the image). The result is identical to the serial one.
+    //! \param [in] exec executor to use, it must outlive its use by the codec. nullptr disables threading (default).
+    void set_executor(xyuv::executor *exec);
+
+    //! \brief Run encode() and decode() in parallel on a thread_executor owned by the codec.
+    //! \param [in] n_threads number of threads, 0 means one per hardware thread and 1 disables threading.
+    void set_thread_count(uint32_t n_threads);
+
+    //! \brief Let decode(), decode_region() and decode_bands() draw the planes of the images they (re)initialise from
+    //!        \a pool.
+    //! \param [in] pool buffer pool to use, it must outlive the images. nullptr allocates normally (default).
+    void set_buffer_pool(xyuv::buffer_pool *pool);
+
+    //! \brief Let decode() and decode_region() (re)initialise images as if by create_contiguous_yuv_image().
+    //! \details All planes of such an image share a single allocation, and are not zeroed before being decoded to.
+    //! \param [in] enable true to allocate one block per image, false (default) to allocate every plane on its own.
+    void set_contiguous_planes(bool enable);
+
+    //! \brief Let decode() represent a fully opaque alpha channel by a constant surface.
+    //! \details When enabled, decode() first checks whether every alpha value of the frame is 1.0. If so, the alpha
+    //!          plane of the result becomes surface::constant() instead of a full resolution plane, and encoding such an
+    //!          image only writes the constant code. The values of the image are the same either way.
+    //! \param [in] enable true to check for opaque alpha, false (default) to always decode alpha to a full plane.
+    void set_detect_opaque_alpha(bool enable);
+
+    //! \brief Override the stripe height.
+    //! \details Frames are packed in horizontal stripes: a stripe of block lines is en-/decoded for all channels sharing
+    //!          planes (e.g. the interleaved channels of AYUV) before moving on to the next stripe, so that the packed
+    //!          bytes are only pulled through the cache once.
+    //! \param [in] block_lines number of block lines per stripe, 0 restores the automatic choice.
+    void set_stripe_height(uint32_t block_lines);
+
+    //! \brief Get the number of block lines per stripe.
+    //! \details Unless overridden with set_stripe_height(), this is chosen when the codec is constructed so that the
+    //!          data touched by one stripe fits in a typical L2 cache (256 KiB).
+    uint32_t stripe_height() const;
+
+private:
+    xyuv::format format_;
+    std::unique_ptr<pack_plan> plan_;
+    std::unique_ptr<xyuv::executor> own_executor_;
+    xyuv::executor *executor_ = nullptr;
+    xyuv::buffer_pool *buffer_pool_ = nullptr;
+    bool contiguous_planes_ = false;
+    uint32_t stripe_height_ = 0;
+    bool detect_opaque_alpha_ = false;
+};
+
+} // namespace xyuv
@@ -0,0 +1,73 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace xyuv {
+
+//! \brief Interface used by libxyuv to run independent pieces of work in parallel.
+//!
+//! \details Implement this to let libxyuv use an existing thread pool, or use xyuv::thread_executor.
+class executor {
+public:
+    virtual ~executor() = default;
+
+    //! \brief Call \a task once for every index in [0, n_tasks) and return when all calls have completed.
+    //! \details The calls may run concurrently and in any order, including on the calling thread. If a task throws,
+    //!          the exception should be propagated to the caller of run() once all started tasks have completed.
+    virtual void run(uint32_t n_tasks, const std::function<void(uint32_t)> &task) = 0;
+
+    //! \brief The number of tasks that can run concurrently, used to decide how finely to split the work.
+    virtual uint32_t concurrency() const = 0;
+};
+
+//! \brief An executor backed by its own set of worker threads.
+//! \details The calling thread of run() takes part in the work, so a thread_executor of N threads starts N-1 workers.
+class thread_executor : public executor {
+public:
+    //! \brief Create an executor running up to \a n_threads tasks at the same time.
+    //! \param [in] n_threads number of threads, 0 means one per hardware thread.
+    explicit thread_executor(uint32_t n_threads = 0);
+
+    ~thread_executor();
+
+    thread_executor(const thread_executor &) = delete;
+    thread_executor &operator=(const thread_executor &) = delete;
+
+    //! \copydoc executor::run
+    //! \details Concurrent calls to run() on the same thread_executor are serialised.
+    void run(uint32_t n_tasks, const std::function<void(uint32_t)> &task) override;
+
+    uint32_t concurrency() const override;
+
+private:
+    struct pool;
+    std::unique_ptr<pool> pool_;
+};
+
+} // namespace xyuv
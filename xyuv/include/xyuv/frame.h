@@ -24,6 +24,7 @@
 
 #pragma once
 #include <memory>
+#include "buffer_pool.h"
 #include "structures/format.h"
 
 namespace xyuv {
@@ -33,7 +34,8 @@ struct frame {
 public:
     // The format descriptor
     xyuv::format format;
-    std::unique_ptr<uint8_t[]> data;
+    // The frame data, format.size bytes, possibly drawn from a xyuv::buffer_pool.
+    frame_buffer data;
 };
 
 } // namespace xyuv
\ No newline at end of file
@@ -24,8 +24,49 @@
 
 #pragma once
 
+#include <cstdint>
+
 namespace xyuv {
 
 using pixel_quantum = float;
 
+//! \brief An IEEE 754 half precision (binary16) value, used as a compact storage type of basic_yuv_image.
+struct half {
+    uint16_t bits;
+};
+
+//! \brief Convert \a value to the nearest half, ties are rounded to even and values too large become infinity.
+half float_to_half(float value);
+
+//! \brief Convert \a value to float, this conversion is exact.
+float half_to_float(half value);
+
+//! \brief Conversion between a sample storage type of basic_yuv_image and the canonical value it represents.
+//! \details The supported storage types are float (pixel_quantum), half and uint16_t. A uint16_t sample holds the
+//! canonical value in [0.0, 1.0] as a 16 bit unsigned normalized integer, i.e. 65535 represents 1.0.
+template<typename T>
+struct quantum_traits;
+
+template<>
+struct quantum_traits<float> {
+    static float to_float(float sample) { return sample; }
+    static float from_float(float value) { return value; }
+};
+
+template<>
+struct quantum_traits<half> {
+    static float to_float(half sample) { return half_to_float(sample); }
+    static half from_float(float value) { return float_to_half(value); }
+};
+
+template<>
+struct quantum_traits<uint16_t> {
+    static float to_float(uint16_t sample) { return sample * (1.0f / 65535.0f); }
+    static uint16_t from_float(float value) {
+        // Clamp before scaling, this also maps NaN to 0.
+        value = value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+        return static_cast<uint16_t>(value * 65535.0f + 0.5f);
+    }
+};
+
 } // namespace xyuv
\ No newline at end of file
@@ -24,10 +24,14 @@
 
 #pragma once
 
+#include "quantum.h"
+
 namespace  xyuv {
 
 struct conversion_matrix;
-struct yuv_image;
+template<typename T>
+struct basic_yuv_image;
+using yuv_image = basic_yuv_image<pixel_quantum>;
 
 
 /** @brief Interface to integrate third party rgb image libraries with xYUV.*/
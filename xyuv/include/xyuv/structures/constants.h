@@ -24,6 +24,8 @@
 
 #pragma once
 
+#include <cstdint>
+
 namespace xyuv {
 
 //! \brief Enum describing the origin [posision of pixel (0, 0)] of the image.
@@ -33,6 +35,30 @@ enum class image_origin {
     LOWER_LEFT = 1,
 };
 
+//! \brief Filter used to reconstruct full resolution chroma from subsampled chroma.
+enum class upsampling_filter {
+    //! \brief Copy each chroma sample into every pixel of its block.
+    REPLICATE = 0,
+    //! \brief Interpolate linearly between the chroma samples closest to each pixel, honouring the sample points of
+    //! the chroma siting.
+    BILINEAR = 1,
+};
+
+//! \brief Filter used to resample the planes of a yuv_image when scaling it.
+enum class scaling_filter {
+    //! \brief Pick one sample per pixel, destination sample j reads source sample floor(j*ratio + 0.5).
+    //! \details This is the mapping of surface<T>::scale, it aligns the top left samples of the images.
+    NEAREST = 0,
+    //! \brief Average the samples covered by each pixel.
+    BOX = 1,
+    //! \brief Triangle filter, linear interpolation when enlarging.
+    BILINEAR = 2,
+    //! \brief Catmull-Rom cubic filter.
+    BICUBIC = 3,
+    //! \brief Three lobed Lanczos filter.
+    LANCZOS = 4,
+};
+
 //! \brief Enum mapping an channel to an integer.
 //! \details It is wrapped in a struct to enforce scoped usage. i.e. you must write
 //! \code{.cpp} channel::Y \endcode
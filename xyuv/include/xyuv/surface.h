@@ -23,26 +23,106 @@
  */
 
 #pragma once
+#include "buffer_pool.h"
+#include "surface_view.h"
+#include <cstddef>
 #include <cstdint>
+#include <iterator>
+#include <stdexcept>
 #include <vector>
 #include <algorithm>
 #include <cmath>
 
 namespace xyuv {
 
-/** A surface is a two-dimentional array of elements.*/
+//! \brief Largest row alignment in bytes of a surface, the storage of every surface starts on a multiple of it.
+constexpr uint32_t max_row_alignment = buffer_alignment;
+
+//! \brief Row alignment in bytes of a surface unless another one is requested, one cache line.
+constexpr uint32_t default_row_alignment = 64;
+
+/** A surface is a two-dimentional array of elements.
+ *
+ * The rows are stored stride() elements apart, which is the width rounded up such that every row starts on a multiple
+ * of row_alignment() bytes. The elements between width() and stride() are padding: they may be read, and written by
+ * vector kernels processing whole registers, but their values are unspecified.
+ */
 template<class T>
 class surface {
 public:
     //! \brief Default constructor, creates an empty surface.
-    surface() : _width(0), _height(0), _data() { };
+    surface() : _width(0), _height(0), _stride(0), _row_alignment(default_row_alignment), _constant(false), _data() { };
 
     //! \brief Constructs an \a x_dim by \a y_dim surface.
-    surface(uint32_t x_dim, uint32_t y_dim) : _width(x_dim), _height(y_dim), _data(_width * _height) { }
+    //! \param [in] row_alignment alignment in bytes of the first element of every row, a power of two no larger than
+    //!             max_row_alignment. Pass 1 to store the rows back to back.
+    //! \throw std::logic_error if \a row_alignment is not valid.
+    surface(uint32_t x_dim, uint32_t y_dim, uint32_t row_alignment = default_row_alignment)
+        : surface(x_dim, y_dim, pool_allocator<T>(), row_alignment) { }
+
+    //! \brief Constructs an \a x_dim by \a y_dim surface storing its elements in memory from \a alloc.
+    //! \details Pass a xyuv::buffer_pool to draw the storage from the pool, it is returned when the surface is
+    //! destroyed. The elements are value-initialised.
+    //! \param [in] row_alignment see surface(uint32_t, uint32_t, uint32_t).
+    surface(uint32_t x_dim, uint32_t y_dim, const pool_allocator<T> &alloc,
+            uint32_t row_alignment = default_row_alignment)
+        : _width(x_dim), _height(y_dim), _stride(padded_stride(x_dim, row_alignment)), _row_alignment(row_alignment),
+          _constant(false), _data(alloc) {
+        _data.resize(static_cast<std::size_t>(_stride) * _height);
+    }
+
+    //! \brief Create an \a x_dim by \a y_dim surface where every element equals \a value.
+    //! \details A constant surface only stores a single row. Reading it (through the const member functions) works as
+    //! for any other surface, while writing to it first allocates the full surface, see materialize().
+    //! \param [in] alloc allocator of the storage, also used when the surface is materialized.
+    static surface constant(uint32_t x_dim, uint32_t y_dim, const T &value,
+                            const pool_allocator<T> &alloc = pool_allocator<T>()) {
+        surface result(0, 0, alloc);
+        result._width = x_dim;
+        result._height = y_dim;
+        result._stride = padded_stride(x_dim, result._row_alignment);
+        result._constant = true;
+        result._data.assign(result._stride, value);
+        return result;
+    }
+
+    //! \brief Create a surface holding a copy of the samples of \a view.
+    //! \details A constant view gives a constant surface.
+    //! \param [in] row_alignment see surface(uint32_t, uint32_t, uint32_t).
+    //! \param [in] alloc see surface(uint32_t, uint32_t, const pool_allocator<T> &, uint32_t).
+    template<typename U>
+    explicit surface(const surface_view<U> &view, uint32_t row_alignment = default_row_alignment,
+                     const pool_allocator<T> &alloc = pool_allocator<T>())
+        : _width(view.width()), _height(view.height()), _stride(padded_stride(view.width(), row_alignment)),
+          _row_alignment(row_alignment), _constant(view.is_constant()),
+          _data(static_cast<std::size_t>(_stride) * (_constant ? 1 : _height), T(), alloc) {
+        for (uint32_t y = 0; y < (_constant ? 1 : _height) && !view.empty(); y++) {
+            std::copy(view.scanline(y), view.scanline(y) + _width,
+                      _data.begin() + static_cast<std::size_t>(y) * _stride);
+        }
+    }
 
     //! \brief Returns true if the number of accessible elements in the surface equals 0.
     bool empty() const { return !_width || !_height; }
 
+    //! \brief Returns true if the surface was created by constant() and has not been written to since.
+    bool is_constant() const { return _constant; }
+
+    //! \brief Get the value of every element of a constant surface.
+    //! \pre is_constant() and !empty().
+    const T &constant_value() const { return _data.front(); }
+
+    //! \brief Turn a constant surface into an ordinary one holding the same values.
+    //! \details This is done implicitly by all non-const member functions giving access to the elements. As that is not
+    //! thread safe, call this before writing to the surface from several threads.
+    void materialize() {
+        if (_constant) {
+            T value = _data.empty() ? T() : _data.front();
+            _constant = false;
+            _data.assign(static_cast<std::size_t>(_stride) * _height, value);
+        }
+    }
+
     //! \brief Remove all pixels from the surface.
     //! \details Remove all pixels from the surface, effectively changing the surface to an empty surface.
     void clear() { resize(0, 0); }
@@ -55,6 +135,16 @@ public:
     //! \warning The height is not guaranteed to be 0 for empty surfaces, use empty() to check if the surface is empty.
     uint32_t height() const { return _height; }
 
+    //! \brief Return the distance in elements between the starts of two consecutive rows.
+    //! \details The stride is at least the width, see the class description.
+    uint32_t stride() const { return _stride; }
+
+    //! \brief Return the alignment in bytes of the rows, see surface(uint32_t, uint32_t, uint32_t).
+    uint32_t row_alignment() const { return _row_alignment; }
+
+    //! \brief Return the allocator of the storage, use it to create surfaces drawing from the same buffer_pool.
+    pool_allocator<T> get_allocator() const { return _data.get_allocator(); }
+
     //! \brief Get the value at (x_coord, y_coord), read-only.
     const T &at(uint32_t x_coord, uint32_t y_coord) const { return *(scanline(y_coord) + x_coord); }
 
@@ -84,7 +174,6 @@ public:
 
     private:
         row_proxy(surface *parent, uint32_t x_coord) : parent(parent), x_coord(x_coord) { }
-        row_proxy(const surface *parent, uint32_t x_coord) : row_proxy(const_cast<surface *>(parent), x_coord) { }
 
         surface *parent;
         uint32_t x_coord;
@@ -92,24 +181,53 @@ public:
         friend class surface;
     };
 
+    //! \brief Read-only counterpart of row_proxy.
+    //! \details Reads go through at(uint32_t, uint32_t) const, so a constant surface is not materialized.
+    class const_row_proxy {
+    public:
+        const T &operator[](uint32_t y_coord) const { return parent->at(x_coord, y_coord); }
+
+    private:
+        const_row_proxy(const surface *parent, uint32_t x_coord) : parent(parent), x_coord(x_coord) { }
+
+        const surface *parent;
+        uint32_t x_coord;
+
+        friend class surface;
+    };
+
     //! \brief \see row_proxy
     row_proxy operator[](uint32_t x_coord) {
         return row_proxy(this, x_coord);
     }
 
-    //! \brief \see row_proxy
-    const row_proxy operator[](uint32_t x_coord) const {
-        return row_proxy(this, x_coord);
+    //! \brief \see const_row_proxy
+    const const_row_proxy operator[](uint32_t x_coord) const {
+        return const_row_proxy(this, x_coord);
     }
 
     //! \brief Get a writable pointer to the underlying storage.
-    //! \details The elements are stored in row-major order.
-    T *data() { return _data.data(); }
+    //! \details The elements are stored in row-major order, with rows stride() elements apart.
+    T *data() { materialize(); return _data.data(); }
 
-    //! \brief Get a writable pointer to the underlying storage.
-    //! \details The elements are stored in row-major order.
+    //! \brief Get a read-only pointer to the underlying storage.
+    //! \details The elements are stored in row-major order, with rows stride() elements apart.
+    //! \warning A constant surface only stores its first row.
     const T *data() const { return _data.data(); }
 
+    //! \brief Get a read-only view of the whole surface.
+    //! \details The view of a constant surface is constant, all of its rows share the storage of the first row.
+    surface_view<const T> view() const {
+        return surface_view<const T>(_data.data(), _width, _height,
+                                     _constant ? 0 : static_cast<std::ptrdiff_t>(_stride), _constant);
+    }
+
+    //! \brief Get a writable view of the whole surface, a constant surface is materialized first.
+    surface_view<T> mutable_view() {
+        materialize();
+        return surface_view<T>(_data.data(), _width, _height, static_cast<std::ptrdiff_t>(_stride));
+    }
+
     //! \brief Sample a value from the surface.
     //! \details This will return the "best" representation of the value at coordinate (x,y) which may be between two
     //! discrete samples in the surface.
@@ -119,16 +237,26 @@ public:
     T sample(float x, float y) const;
 
     //! \brief Get a raw writable pointer to the data at scanline \a line.
-    T *scanline(uint32_t line) { return data() + line * width(); }
+    T *scanline(uint32_t line) { return data() + static_cast<std::size_t>(line) * _stride; }
 
     //! \brief Get a raw read-only pointer to the data at scanline \a line.
-    const T *scanline(uint32_t line) const { return data() + line * width(); }
+    //! \details All scanlines of a constant surface share the same storage.
+    const T *scanline(uint32_t line) const {
+        return data() + (_constant ? 0 : static_cast<std::size_t>(line) * _stride);
+    }
 
     //! \brief Resize the surface.
     //! \todo The data is mangled when resizing the surface. Change this. (Possibly reusing crop)
     void resize(uint32_t w, uint32_t h) {
         // TODO: Make image consistent.
-        _data.resize(w * h);
+        _stride = padded_stride(w, _row_alignment);
+        if (_constant) {
+            // A constant surface keeps its value.
+            T value = _data.empty() ? T() : _data.front();
+            _data.assign(_stride, value);
+        } else {
+            _data.resize(static_cast<std::size_t>(_stride) * h);
+        }
         _width = w;
         _height = h;
     }
@@ -136,9 +264,16 @@ public:
     //! \brief Crop the surface.
     //! \details This will crop lines of samples off the edges of the surface. Effectively resizing the surface.
     //!
-    //! If all values are removed from the image, the image becomes empty.
-    //! \todo Implement this.
-    void crop(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom) { }
+    //! If all values are removed from the image, the image becomes empty. Use view().crop() to get a cropped view
+    //! without copying the samples.
+    void crop(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom) {
+        if (static_cast<uint64_t>(left) + right >= _width || static_cast<uint64_t>(top) + bottom >= _height) {
+            clear();
+            return;
+        }
+        *this = surface(view().crop(left, top, _width - left - right, _height - top - bottom), _row_alignment,
+                        _data.get_allocator());
+    }
 
     //! \brief Resize the surface.
     //! \details The new surface-values will be determined using the sample(float, float) method.
@@ -148,38 +283,123 @@ public:
     //! \brief This will set all values in the surface equal to \a val.
     void fill(const T &val);
 
-    // iterator 
-    using iterator = typename std::vector<T>::iterator;
-    using const_iterator = typename std::vector<T>::const_iterator;
+    //! \brief Row major random access iterator to the values of a surface.
+    //! \details The iterators skip the padding at the end of every row, and also visit every row of a constant surface.
+    template<typename Parent, typename Value>
+    class row_major_iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Value *;
+        using reference = Value &;
+
+        row_major_iterator() : parent(nullptr), index(0) { }
+
+        //! \brief An iterator converts to a const_iterator.
+        template<typename P, typename V>
+        row_major_iterator(const row_major_iterator<P, V> &rhs) : parent(rhs.parent), index(rhs.index) { }
+
+        Value &operator*() const { return parent->_data[parent->element_offset(index)]; }
+        Value *operator->() const { return &**this; }
+        Value &operator[](std::ptrdiff_t n) const { return *(*this + n); }
+
+        row_major_iterator &operator++() { ++index; return *this; }
+        row_major_iterator operator++(int) { row_major_iterator old = *this; ++index; return old; }
+        row_major_iterator &operator--() { --index; return *this; }
+        row_major_iterator operator--(int) { row_major_iterator old = *this; --index; return old; }
+        row_major_iterator &operator+=(std::ptrdiff_t n) { index += n; return *this; }
+        row_major_iterator &operator-=(std::ptrdiff_t n) { index -= n; return *this; }
+        row_major_iterator operator+(std::ptrdiff_t n) const { return row_major_iterator(parent, index + n); }
+        row_major_iterator operator-(std::ptrdiff_t n) const { return row_major_iterator(parent, index - n); }
+        friend row_major_iterator operator+(std::ptrdiff_t n, const row_major_iterator &it) { return it + n; }
+        std::ptrdiff_t operator-(const row_major_iterator &rhs) const {
+            return static_cast<std::ptrdiff_t>(index) - static_cast<std::ptrdiff_t>(rhs.index);
+        }
+
+        bool operator==(const row_major_iterator &rhs) const { return index == rhs.index; }
+        bool operator!=(const row_major_iterator &rhs) const { return index != rhs.index; }
+        bool operator<(const row_major_iterator &rhs) const { return index < rhs.index; }
+        bool operator>(const row_major_iterator &rhs) const { return index > rhs.index; }
+        bool operator<=(const row_major_iterator &rhs) const { return index <= rhs.index; }
+        bool operator>=(const row_major_iterator &rhs) const { return index >= rhs.index; }
+
+    private:
+        row_major_iterator(Parent *parent, std::size_t index) : parent(parent), index(index) { }
+
+        Parent *parent;
+        std::size_t index;
+
+        friend class surface;
+        template<typename P, typename V> friend class row_major_iterator;
+    };
+
+    //! \brief Row major random access iterator to the values.
+    using iterator = row_major_iterator<surface, T>;
+
+    //! \brief Row major random access iterator to the values of a const surface.
+    using const_iterator = row_major_iterator<const surface, const T>;
 
     //! \brief Get a row major random access iterator to the values.
-    iterator begin() { return _data.begin(); }
+    iterator begin() { materialize(); return iterator(this, 0); }
 
     //! \brief Get the end iterator.
-    iterator end() { return _data.end(); }
+    iterator end() { materialize(); return iterator(this, static_cast<std::size_t>(_width) * _height); }
 
     //! \brief Get a row major random access const_iterator to the values.
-    const_iterator begin() const { return _data.begin(); }
+    const_iterator begin() const { return const_iterator(this, 0); }
 
     //! \brief Get the end iterator.
-    const_iterator end() const { return _data.end(); }
+    const_iterator end() const { return const_iterator(this, static_cast<std::size_t>(_width) * _height); }
 
     // copy and move semantics.
     surface &operator=(const surface &rhs) = default;
     surface(const surface &rhs) = default;
 
+    //! \details The moved from surface is left empty.
     surface &operator=(surface &&rhs) {
         this->_width = rhs._width;
         this->_height = rhs._height;
+        this->_stride = rhs._stride;
+        this->_row_alignment = rhs._row_alignment;
+        this->_constant = rhs._constant;
         this->_data = std::move(rhs._data);
+        rhs._width = rhs._height = rhs._stride = 0;
+        rhs._constant = false;
         return *this;
     }
 
-    surface(surface &&rhs) : _width(rhs._width), _height(rhs._height), _data(std::move(rhs._data)) { }
+    //! \details The moved from surface is left empty.
+    surface(surface &&rhs)
+        : _width(rhs._width), _height(rhs._height), _stride(rhs._stride), _row_alignment(rhs._row_alignment),
+          _constant(rhs._constant), _data(std::move(rhs._data)) {
+        rhs._width = rhs._height = rhs._stride = 0;
+        rhs._constant = false;
+    }
+
+    //! \brief Get the stride() of a surface of width \a width and row alignment \a row_alignment.
+    //! \throw std::logic_error if \a row_alignment is not valid, see surface(uint32_t, uint32_t, uint32_t).
+    static uint32_t padded_stride(uint32_t width, uint32_t row_alignment = default_row_alignment) {
+        if (row_alignment == 0 || (row_alignment & (row_alignment - 1)) != 0 || row_alignment > max_row_alignment) {
+            throw std::logic_error("The row alignment of a surface must be a power of two no larger than 64.");
+        }
+        uint32_t unit = std::max<uint32_t>(1, row_alignment / sizeof(T));
+        return (width + unit - 1) / unit * unit;
+    }
 
 private:
+
+    // Position in _data of element index of the row major order.
+    std::size_t element_offset(std::size_t index) const {
+        return (_constant ? 0 : index / _width * _stride) + index % _width;
+    }
+
     uint32_t _width, _height;
-    std::vector<T> _data;
+    // Distance between rows in elements, and the alignment in bytes it was chosen for.
+    uint32_t _stride, _row_alignment;
+    // True for surfaces created by constant(), _data then holds a single row.
+    bool _constant;
+    std::vector<T, pool_allocator<T>> _data;
 };
 
 
@@ -187,8 +407,8 @@ template<typename T>
 T surface<T>::sample(float x, float y) const {
     x = std::floor(x * width() + 0.5f);
     y = std::floor(y * height() + 0.5f);
-    x = std::max(0.0f, std::min<float>(x, width()));
-    y = std::max(0.0f, std::min<float>(y, height()));
+    x = std::max(0.0f, std::min<float>(x, width() - 1.0f));
+    y = std::max(0.0f, std::min<float>(y, height() - 1.0f));
     // Nearest neighbour "interpolation". (or rather, lack there of.)
     return get(static_cast<uint32_t>(x), static_cast<uint32_t>(y));
 
@@ -196,10 +416,29 @@ T surface<T>::sample(float x, float y) const {
 
 template<typename T>
 void surface<T>::scale(uint32_t w, uint32_t h) {
-    surface<T> result(w, h);
+    // Scaling a constant surface gives the same constant.
+    if (_constant) {
+        resize(w, h);
+        return;
+    }
+
+    // Same coordinates as sample(), computed once per column and row.
+    auto source_index = [](uint32_t i, uint32_t n, uint32_t size) {
+        float pos = std::floor(static_cast<float>(i) / n * size + 0.5f);
+        return static_cast<uint32_t>(std::max(0.0f, std::min<float>(pos, size - 1.0f)));
+    };
+
+    std::vector<uint32_t> columns(w);
     for (uint32_t x = 0; x < w; x++) {
-        for (uint32_t y = 0; y < h; y++) {
-            result.set(x, y, this->sample(static_cast<float>(x) / w, static_cast<float>(y) / h));
+        columns[x] = source_index(x, w, width());
+    }
+
+    surface<T> result(w, h, _data.get_allocator().detached(), _row_alignment);
+    for (uint32_t y = 0; y < h; y++) {
+        const T *src = scanline(source_index(y, h, height()));
+        T *dst = result.scanline(y);
+        for (uint32_t x = 0; x < w; x++) {
+            dst[x] = src[columns[x]];
         }
     }
     *this = std::move(result);
@@ -207,9 +446,8 @@ void surface<T>::scale(uint32_t w, uint32_t h) {
 
 template<typename T>
 void surface<T>::fill(const T &val) {
-    for (auto &v : *this) {
-        v = val;
-    }
+    // A constant surface stays constant.
+    std::fill(_data.begin(), _data.end(), val);
 }
 
-} // namespace xyuv
\ No newline at end of file
+} // namespace xyuv
@@ -0,0 +1,115 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+namespace xyuv {
+
+//! \brief A non-owning view of a two-dimensional array of samples.
+//! \details A surface_view refers to \a height rows of \a width samples, where row y starts \a stride samples after
+//!          row y-1. The stride may be larger than the width (e.g. a crop of a larger surface), negative (rows stored
+//!          bottom up, see flip_y()) or 0 (every row shares the same storage, as for a constant surface).
+//!
+//!          Views are cheap to copy and never own their samples, the storage must outlive the view. Use
+//!          surface_view<const T> for read-only access, a surface_view<T> converts to it implicitly.
+//!          Like a pointer, a const surface_view still gives access to mutable samples.
+template<typename T>
+class surface_view {
+public:
+    //! \brief Create an empty view.
+    surface_view() : _data(nullptr), _width(0), _height(0), _stride(0), _constant(false) { }
+
+    //! \brief Create a view of \a height rows of \a width samples starting at \a data.
+    //! \param [in] stride distance in samples from the start of one row to the start of the next.
+    //! \param [in] constant true if every sample of the view has the same value, see is_constant().
+    surface_view(T *data, uint32_t width, uint32_t height, std::ptrdiff_t stride, bool constant = false)
+        : _data(data), _width(width), _height(height), _stride(stride), _constant(constant) { }
+
+    //! \brief A view of mutable samples converts to a view of const samples.
+    template<typename U, typename = typename std::enable_if<std::is_same<const U, T>::value>::type>
+    surface_view(const surface_view<U> &rhs)
+        : _data(rhs.data()), _width(rhs.width()), _height(rhs.height()), _stride(rhs.stride()),
+          _constant(rhs.is_constant()) { }
+
+    //! \brief Returns true if the view has no samples.
+    bool empty() const { return !_width || !_height; }
+
+    //! \brief Number of samples per row.
+    uint32_t width() const { return _width; }
+
+    //! \brief Number of rows.
+    uint32_t height() const { return _height; }
+
+    //! \brief Distance in samples between the starts of two consecutive rows.
+    std::ptrdiff_t stride() const { return _stride; }
+
+    //! \brief Returns true if every sample of the view has the same value, e.g. a view of a constant surface.
+    bool is_constant() const { return _constant; }
+
+    //! \brief Get the value of every sample of a constant view.
+    //! \pre is_constant() and !empty().
+    T &constant_value() const { return *_data; }
+
+    //! \brief Get a pointer to the first sample of row 0.
+    T *data() const { return _data; }
+
+    //! \brief Get a pointer to the first sample of row \a line, the samples of a row are contiguous.
+    T *scanline(uint32_t line) const { return _data + static_cast<std::ptrdiff_t>(line) * _stride; }
+
+    //! \brief Get a reference to the sample at (\a x_coord, \a y_coord).
+    T &at(uint32_t x_coord, uint32_t y_coord) const { return scanline(y_coord)[x_coord]; }
+
+    //! \brief Get the sample at (\a x_coord, \a y_coord).
+    const T &get(uint32_t x_coord, uint32_t y_coord) const { return at(x_coord, y_coord); }
+
+    //! \brief Get a view of the \a w x \a h rectangle whose top left sample is (\a x, \a y).
+    //! \throw std::logic_error if the rectangle is not inside the view.
+    surface_view crop(uint32_t x, uint32_t y, uint32_t w, uint32_t h) const {
+        if (x > _width || w > _width - x || y > _height || h > _height - y) {
+            throw std::logic_error("The cropped rectangle must be inside the surface.");
+        }
+        return surface_view(w && h ? &at(x, y) : _data, w, h, _stride, _constant);
+    }
+
+    //! \brief Get a view of the same samples with the rows in opposite order.
+    surface_view flip_y() const {
+        if (empty()) {
+            return *this;
+        }
+        return surface_view(scanline(_height - 1), _width, _height, -_stride, _constant);
+    }
+
+private:
+    T *_data;
+    uint32_t _width, _height;
+    std::ptrdiff_t _stride;
+    bool _constant;
+};
+
+} // namespace xyuv
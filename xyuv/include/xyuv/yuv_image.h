@@ -28,6 +28,9 @@
 #include <xyuv/surface.h>
 #include "xyuv/quantum.h"
 
+#include <stdexcept>
+#include <type_traits>
+
 namespace xyuv {
 
 //! \brief Class representing a canonical yuv image.
@@ -42,7 +45,11 @@ namespace xyuv {
 //! directly on the separate surfaces using the member functions of xyuv::surface.
 //!
 //! The origin of a yuv_image is defined to be the top left corner.
-struct yuv_image {
+//!
+//! The samples are stored as \a T, which is one of the types supported by quantum_traits. All image operations work on
+//! yuv_image, i.e. float samples, while the frame en-/decoders also accept the more compact half and uint16_t storage.
+template<typename T>
+struct basic_yuv_image {
     //! \brief Image width of the luma plane (y_plane).
     //! \details If the image has no luma plane, then image_w should still be the width of the luma plane (as though it was present)
     //! as dictated by the chroma siting.
@@ -60,23 +67,137 @@ struct yuv_image {
 
     //! \brief Surface for the luma channel.
     //! \details Canonical values in the in the y_plane are normalized to the range [0.0, 1.0].
-    surface<pixel_quantum> y_plane;
+    surface<T> y_plane;
 
     //! \brief Surface for the first chroma channel.
     //! \details Canonical values in the in the u_plane are normalized to the range [-0.5, 0.5].
-    surface<pixel_quantum> u_plane;
+    surface<T> u_plane;
 
     //! \brief Surface for the second chroma channel.
     //! \details Canonical values in the in the v_plane are normalized to the range [-0.5, 0.5].
-    surface<pixel_quantum> v_plane;
+    surface<T> v_plane;
 
     //! \brief Surface for the alpha channel.
     //! \details Canonical values in the in the a_plane are normalized to the range [0.0, 1.0].
-    surface<pixel_quantum> a_plane;
+    surface<T> a_plane;
 };
 
+//! \brief A yuv image with float samples, the representation used by all image operations.
+using yuv_image = basic_yuv_image<pixel_quantum>;
+
+//! \brief A non-owning view of the planes of a yuv image.
+//! \details A basic_yuv_image_view has the same members as a basic_yuv_image, but refers to its samples through
+//! surface_view instead of owning them. Cropping and flipping a view is O(1), no samples are copied. The planes may
+//! also refer to the storage of different images.
+//!
+//! Use make_view() or make_mutable_view() to view an image, and codec::encode() / codec::decode() to en-/decode
+//! straight from or to a view. The storage must outlive the view.
+//! \tparam T the sample storage type, const qualified for a read-only view.
+template<typename T>
+struct basic_yuv_image_view {
+    //! \brief Image width of the luma plane, see basic_yuv_image::image_w.
+    uint32_t image_w;
+
+    //! \brief Image height of the luma plane, see basic_yuv_image::image_h.
+    uint32_t image_h;
+
+    //! \brief Chroma siting, see basic_yuv_image::siting.
+    xyuv::chroma_siting siting;
+
+    //! \brief Views of the planes, a channel not present in the image has an empty view.
+    surface_view<T> y_plane, u_plane, v_plane, a_plane;
+
+    //! \brief Get a view of the \a w x \a h rectangle whose top left pixel is (\a x, \a y).
+    //! \details The chroma planes are cropped to the macro pixels covering the rectangle.
+    //! \throw std::logic_error if the rectangle is not inside the image, or (\a x, \a y) is not the corner of a macro
+    //!        pixel of the chroma subsampling.
+    basic_yuv_image_view crop(uint32_t x, uint32_t y, uint32_t w, uint32_t h) const {
+        const subsampling &sub = siting.subsampling;
+        if (x > image_w || w > image_w - x || y > image_h || h > image_h - y) {
+            throw std::logic_error("The cropped rectangle must be inside the image.");
+        }
+        if ((x % sub.macro_px_w) != 0 || (y % sub.macro_px_h) != 0) {
+            throw std::logic_error("The cropped rectangle must start on a macro pixel of the chroma subsampling.");
+        }
+
+        auto crop_chroma = [&](const surface_view<T> &plane) {
+            if (plane.empty()) {
+                return plane;
+            }
+            return plane.crop(x / sub.macro_px_w, y / sub.macro_px_h,
+                              (w + sub.macro_px_w - 1) / sub.macro_px_w, (h + sub.macro_px_h - 1) / sub.macro_px_h);
+        };
+
+        basic_yuv_image_view result = *this;
+        result.image_w = w;
+        result.image_h = h;
+        result.y_plane = y_plane.empty() ? y_plane : y_plane.crop(x, y, w, h);
+        result.u_plane = crop_chroma(u_plane);
+        result.v_plane = crop_chroma(v_plane);
+        result.a_plane = a_plane.empty() ? a_plane : a_plane.crop(x, y, w, h);
+        return result;
+    }
+
+    //! \brief Get a view of the image upside down.
+    //! \details The vertical chroma sample points are mirrored within the macro pixel.
+    //! \throw std::logic_error if the image has chroma and its height is not a multiple of the macro pixel height, as the
+    //!        macro pixels would not line up after flipping.
+    basic_yuv_image_view flip_y() const {
+        const subsampling &sub = siting.subsampling;
+        if ((!u_plane.empty() || !v_plane.empty()) && (image_h % sub.macro_px_h) != 0) {
+            throw std::logic_error("The image height must be a multiple of the macro pixel height to flip chroma.");
+        }
+
+        basic_yuv_image_view result = *this;
+        result.siting.u_sample_point.second = (sub.macro_px_h - 1) - siting.u_sample_point.second;
+        result.siting.v_sample_point.second = (sub.macro_px_h - 1) - siting.v_sample_point.second;
+        result.y_plane = y_plane.flip_y();
+        result.u_plane = u_plane.flip_y();
+        result.v_plane = v_plane.flip_y();
+        result.a_plane = a_plane.flip_y();
+        return result;
+    }
+};
+
+//! \brief A read-only view of a yuv_image.
+using const_yuv_image_view = basic_yuv_image_view<const pixel_quantum>;
+
+//! \brief Get a read-only view of all planes of \a image.
+template<typename T>
+basic_yuv_image_view<const T> make_view(const basic_yuv_image<T> &image) {
+    return basic_yuv_image_view<const T>{ image.image_w, image.image_h, image.siting,
+                                          image.y_plane.view(), image.u_plane.view(),
+                                          image.v_plane.view(), image.a_plane.view() };
+}
+
+//! \brief Get a writable view of all planes of \a image, constant planes are materialized first.
+template<typename T>
+basic_yuv_image_view<T> make_mutable_view(basic_yuv_image<T> &image) {
+    return basic_yuv_image_view<T>{ image.image_w, image.image_h, image.siting,
+                                    image.y_plane.mutable_view(), image.u_plane.mutable_view(),
+                                    image.v_plane.mutable_view(), image.a_plane.mutable_view() };
+}
+
+//! \brief Create a yuv image holding a copy of the samples of \a view.
+//! \details Constant planes stay constant.
+template<typename T>
+basic_yuv_image<typename std::remove_const<T>::type> copy_yuv_image(const basic_yuv_image_view<T> &view) {
+    using U = typename std::remove_const<T>::type;
+    basic_yuv_image<U> result;
+    result.image_w = view.image_w;
+    result.image_h = view.image_h;
+    result.siting = view.siting;
+    result.y_plane = surface<U>(view.y_plane);
+    result.u_plane = surface<U>(view.u_plane);
+    result.v_plane = surface<U>(view.v_plane);
+    result.a_plane = surface<U>(view.a_plane);
+    return result;
+}
+
 //! \brief Create and initialize an empty yuv_image.
-//! \details The newly created image will have all existing channels set to 0.0.
+//! \details The newly created image will have all existing channels set to 0.0, except alpha which is set to 1.0.
+//! The alpha plane is a constant surface (see surface::constant()), storage is only allocated once it is written to.
+//! \tparam T the sample storage type, float (the default), half or uint16_t.
 //! \param [in] image_w Width of the luma plane (i.e. the full resolution of the image) regardless of whether the image has a Y channel.
 //! \param [in] image_h Height of the luma plane (i.e. the full resolution of the image) regardless of whether the image has a Y channel.
 //! \param [in] siting Target chroma siting of the image.
@@ -84,10 +205,79 @@ struct yuv_image {
 //! \param [in] has_U Boolean indicating whether the image should have the first chroma channel.
 //! \param [in] has_V Boolean indicating whether the image should have the second chroma channel.
 //! \param [in] has_A Boolean indicating whether the image should have a transparency channel.
-yuv_image create_yuv_image(
+template<typename T = pixel_quantum>
+basic_yuv_image<T> create_yuv_image(
+        uint32_t image_w,
+        uint32_t image_h,
+        const xyuv::chroma_siting &siting,
+        bool has_Y = true,
+        bool has_U = true,
+        bool has_V = true,
+        bool has_A = true
+);
+
+//! \brief Create and initialize an empty yuv_image storing its planes in memory from \a alloc.
+//! \details Same as \link create_yuv_image(uint32_t, uint32_t, const xyuv::chroma_siting &, bool, bool, bool, bool)
+//! \endlink otherwise. Pass the allocator of an existing plane (surface::get_allocator()) to draw from the same
+//! xyuv::buffer_pool.
+template<typename T>
+basic_yuv_image<T> create_yuv_image(
+        uint32_t image_w,
+        uint32_t image_h,
+        const xyuv::chroma_siting &siting,
+        const pool_allocator<T> &alloc,
+        bool has_Y = true,
+        bool has_U = true,
+        bool has_V = true,
+        bool has_A = true
+);
+
+//! \brief Create and initialize an empty yuv_image drawing the storage of its planes from \a pool.
+//! \details The planes return their storage to \a pool when they are destroyed, so a steady stream of images of the
+//! same dimensions stops allocating. See create_yuv_image(uint32_t, uint32_t, const xyuv::chroma_siting &, bool,
+//! bool, bool, bool) for the remaining parameters.
+template<typename T = pixel_quantum>
+basic_yuv_image<T> create_yuv_image(
+        uint32_t image_w,
+        uint32_t image_h,
+        const xyuv::chroma_siting &siting,
+        buffer_pool &pool,
+        bool has_Y = true,
+        bool has_U = true,
+        bool has_V = true,
+        bool has_A = true
+) {
+    return create_yuv_image(image_w, image_h, siting, pool_allocator<T>(pool), has_Y, has_U, has_V, has_A);
+}
+
+//! \brief Create a yuv_image with all planes stored in a single buffer.
+//! \details The planes are placed in one plane_arena, each starting on a multiple of buffer_alignment, so the image
+//! costs one allocation and is released, or recycled by a buffer_pool, as one block. See plane_arena, which is
+//! reached through the allocator of the planes (surface::get_allocator()).
+//!
+//! The samples are initialised as by create_yuv_image(), the alpha plane is constant and opaque. The arena only holds
+//! the single row of the constant alpha plane, so writing to it allocates the full plane separately, as do copies of
+//! the planes.
+//! See create_yuv_image(uint32_t, uint32_t, const xyuv::chroma_siting &, bool, bool, bool, bool) for the parameters.
+template<typename T = pixel_quantum>
+basic_yuv_image<T> create_contiguous_yuv_image(
+        uint32_t image_w,
+        uint32_t image_h,
+        const xyuv::chroma_siting &siting,
+        bool has_Y = true,
+        bool has_U = true,
+        bool has_V = true,
+        bool has_A = true
+);
+
+//! \brief Create a yuv_image with all planes stored in a single buffer drawn from \a pool.
+//! \details See create_contiguous_yuv_image(uint32_t, uint32_t, const xyuv::chroma_siting &, bool, bool, bool, bool).
+template<typename T = pixel_quantum>
+basic_yuv_image<T> create_contiguous_yuv_image(
         uint32_t image_w,
         uint32_t image_h,
         const xyuv::chroma_siting &siting,
+        buffer_pool &pool,
         bool has_Y = true,
         bool has_U = true,
         bool has_V = true,
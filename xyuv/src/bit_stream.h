@@ -0,0 +1,119 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include "io/endianess.h"
+
+/** \file Word wide access to bit streams.
+ *
+ * Like set_bit() and get_bit() in utility.h the buffer is seen as a continuous stream of bits
+ * from lsb of LSB to msb of MSB, but here up to 57 bits are moved with a single unaligned
+ * 64 bit load (and store). Wider fields are split in two.
+ *
+ * The \p end argument points one past the last byte the caller allows us to touch. While there
+ * are at least 8 bytes left before it a full word is accessed, otherwise only the bytes actually
+ * covered by the field are, so it is safe to use on the very last bits of a buffer.
+ */
+
+namespace xyuv {
+
+//! \brief The widest field that always fits in one 64 bit word regardless of bit alignment.
+static const uint8_t MAX_BITS_PER_WORD = 57;
+
+//! \brief Load \p n_bytes (at most 8) from \p ptr as a little endian word.
+inline uint64_t load_le_word(const uint8_t *ptr, std::size_t n_bytes) {
+    uint64_t word = 0;
+    memcpy(&word, ptr, n_bytes);
+    return le_to_host(word);
+}
+
+//! \brief Store the low \p n_bytes (at most 8) of \p word to \p ptr in little endian order.
+inline void store_le_word(uint8_t *ptr, std::size_t n_bytes, uint64_t word) {
+    word = host_to_le(word);
+    memcpy(ptr, &word, n_bytes);
+}
+
+//! \brief Number of bytes to access at \p ptr in order to reach \p last_bit, see file comment.
+inline std::size_t word_span(const uint8_t *ptr, const uint8_t *end, uint32_t last_bit) {
+    return (end - ptr >= 8) ? 8 : (last_bit + 7) / 8;
+}
+
+//! \brief Read \p bits bits starting at bit \p offset of \p buffer. The first bit read becomes the lsb of the result.
+inline uint64_t extract_bits(const uint8_t *buffer, const uint8_t *end, uint64_t offset, uint8_t bits) {
+    if (bits > MAX_BITS_PER_WORD) {
+        uint64_t low = extract_bits(buffer, end, offset, 32);
+        return low | (extract_bits(buffer, end, offset + 32, static_cast<uint8_t>(bits - 32)) << 32);
+    }
+    if (bits == 0) {
+        return 0;
+    }
+
+    const uint8_t *ptr = buffer + offset / 8;
+    uint32_t shift = static_cast<uint32_t>(offset % 8);
+
+    uint64_t word = load_le_word(ptr, word_span(ptr, end, shift + bits));
+    return (word >> shift) & ((0x1ull << bits) - 1);
+}
+
+//! \brief Write the low \p bits bits of \p value starting at bit \p offset of \p buffer, leaving all other bits untouched.
+inline void insert_bits(uint8_t *buffer, const uint8_t *end, uint64_t offset, uint8_t bits, uint64_t value) {
+    if (bits > MAX_BITS_PER_WORD) {
+        insert_bits(buffer, end, offset, 32, value);
+        insert_bits(buffer, end, offset + 32, static_cast<uint8_t>(bits - 32), value >> 32);
+        return;
+    }
+    if (bits == 0) {
+        return;
+    }
+
+    uint8_t *ptr = buffer + offset / 8;
+    uint32_t shift = static_cast<uint32_t>(offset % 8);
+    std::size_t span = word_span(ptr, end, shift + bits);
+
+    uint64_t mask = ((0x1ull << bits) - 1) << shift;
+    uint64_t word = load_le_word(ptr, span);
+    word = (word & ~mask) | ((value << shift) & mask);
+    store_le_word(ptr, span, word);
+}
+
+//! \brief Copy \p size_in_bits bits from one bit stream to another.
+inline void copy_bits(uint8_t *dst, const uint8_t *dst_end, uint64_t dst_offset,
+                      const uint8_t *src, const uint8_t *src_end, uint64_t src_offset, uint64_t size_in_bits) {
+    if (((dst_offset | src_offset | size_in_bits) % 8) == 0) {
+        memcpy(dst + dst_offset / 8, src + src_offset / 8, size_in_bits / 8);
+        return;
+    }
+
+    while (size_in_bits > 0) {
+        uint8_t bits = static_cast<uint8_t>(size_in_bits < MAX_BITS_PER_WORD ? size_in_bits : MAX_BITS_PER_WORD);
+        insert_bits(dst, dst_end, dst_offset, bits, extract_bits(src, src_end, src_offset, bits));
+        dst_offset += bits;
+        src_offset += bits;
+        size_in_bits -= bits;
+    }
+}
+
+} // namespace xyuv
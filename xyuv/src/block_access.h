@@ -0,0 +1,99 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "pack_plan.h"
+
+#include <cstdint>
+
+/** \file Addressing of the blocks of a packed frame, shared by the pixel packer and the repacker. */
+
+namespace xyuv {
+
+// Little endian access to the byte aligned values of the fast path.
+inline void store_le(uint8_t *ptr, uint8_t value) {
+    ptr[0] = value;
+}
+
+inline void store_le(uint8_t *ptr, uint16_t value) {
+    ptr[0] = static_cast<uint8_t>(value);
+    ptr[1] = static_cast<uint8_t>(value >> 8);
+}
+
+template <typename T>
+T load_le(const uint8_t *ptr);
+
+template <>
+inline uint8_t load_le<uint8_t>(const uint8_t *ptr) {
+    return ptr[0];
+}
+
+template <>
+inline uint16_t load_le<uint16_t>(const uint8_t *ptr) {
+    return static_cast<uint16_t>(ptr[0] | (ptr[1] << 8));
+}
+
+// Call fn(block, region, region_end, bit) for every block in [first_block, last_block) of a block line that is stored,
+// where bit is the offset of the part from region. For a block ordered plane the region is the row of mega blocks
+// holding the line, and blocks outside the complete mega blocks are skipped.
+template <typename Ptr, typename Fn>
+inline void for_each_tiled_block(Ptr base_addr, const tiling_plan &tiling, const channel_plan &plan,
+                                 const part_plan &part, uint32_t line, uint32_t first_block, uint32_t last_block,
+                                 const Fn &fn) {
+    int64_t line_offset = plan.line_offset(part.plane, line);
+    if (!tiling.tiled) {
+        Ptr ptr_to_line = base_addr + line_offset;
+        for (uint32_t b = first_block; b < last_block; b++) {
+            fn(b, ptr_to_line, ptr_to_line + part.line_size, static_cast<uint64_t>(b) * part.block_stride + part.offset);
+        }
+        return;
+    }
+
+    uint64_t plane_line = static_cast<uint64_t>(line_offset - static_cast<int64_t>(tiling.base_offset)) / tiling.line_stride;
+    uint64_t mega_block_row = plane_line / tiling.mega_block_h;
+    if (mega_block_row >= tiling.n_mega_block_rows) {
+        return;
+    }
+
+    Ptr region = base_addr + tiling.base_offset + mega_block_row * tiling.mega_block_row_size;
+    Ptr region_end = region + tiling.mega_block_row_size;
+    const uint32_t *row_offsets = &tiling.block_offsets[(plane_line % tiling.mega_block_h) * tiling.mega_block_w];
+
+    // An offset beyond the block stride stores the part in one of the following blocks.
+    uint32_t first_stored_block = part.offset / part.block_stride;
+    uint32_t offset_in_block = part.offset % part.block_stride;
+
+    for (uint32_t b = first_block; b < last_block; b++) {
+        uint64_t block = b + first_stored_block;
+        uint64_t mega_block = block / tiling.mega_block_w;
+        if (mega_block >= tiling.n_mega_blocks_in_row) {
+            break;
+        }
+        fn(b, region, region_end,
+           mega_block * tiling.mega_block_size * 8 + row_offsets[block % tiling.mega_block_w] + offset_in_block);
+    }
+}
+
+} // namespace xyuv
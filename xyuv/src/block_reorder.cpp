@@ -27,15 +27,10 @@
 #include "xyuv/frame.h"
 #include "assert.h"
 #include "utility.h"
+#include "bit_stream.h"
 #include "block_reorder.h"
 
 
-static inline void copy_bits(uint8_t * dst_base, uint32_t dst_bit_offset, const uint8_t * src_base, uint32_t src_bit_offset, uint32_t size_in_bits) {
-    for (uint32_t i = 0; i < size_in_bits; i++) {
-        xyuv::set_bit(dst_base, dst_bit_offset + i, xyuv::get_bit(src_base, src_bit_offset + i));
-    }
-}
-
 namespace xyuv {
 
     // Calculate the position of this block.
@@ -61,6 +56,33 @@ namespace xyuv {
 		return _get_block_order_offset(block_x, block_y, block_order);
 	}
 
+    // Get the offset bits set by each bit of a coordinate, given the mask of that axis.
+    static std::vector<uint32_t> get_axis_offsets(const uint8_t (&mask)[32], uint32_t extent) {
+        uint32_t contributions[32] = {};
+        for (uint32_t i = 0; i < 32; ++i) {
+            if (mask[i] < 32) {
+                contributions[mask[i]] |= 0x1u << i;
+            }
+        }
+
+        // Each coordinate adds the contribution of its lowest set bit to that of the coordinate without it.
+        std::vector<uint32_t> offsets(extent);
+        for (uint32_t coord = 1; coord < extent; ++coord) {
+            uint32_t lowest = 0;
+            while (((coord >> lowest) & 1u) == 0) {
+                ++lowest;
+            }
+            offsets[coord] = offsets[coord & (coord - 1)] | contributions[lowest];
+        }
+        return offsets;
+    }
+
+    block_order_table::block_order_table(const ::block_order & block_order)
+        : mega_block_width_(block_order.mega_block_width)
+        , x_offsets_(get_axis_offsets(block_order.x_mask, block_order.mega_block_width))
+        , y_offsets_(get_axis_offsets(block_order.y_mask, block_order.mega_block_height))
+    { }
+
     inline std::pair<uint32_t,uint32_t> _get_block_order_coords(uint32_t block_x, uint32_t block_y, const ::block_order & block_order) {
 
         uint32_t offset = _get_block_order_offset(block_x, block_y, block_order);
@@ -84,97 +106,88 @@ namespace xyuv {
         return false;
     }
 
-    void reorder_transform( uint8_t * frame_base_ptr, const xyuv::plane &plane) {
-
-        if (plane.block_order.mega_block_height == 1
-                && plane.block_order.mega_block_width == 1) {
-            return;
-        }
+    // The shape of a block ordered plane. A row of mega blocks covers the same bytes in linear and in block order, so
+    // each row can be reordered on its own, using a copy of just that row.
+    struct reorder_geometry {
+        uint32_t mega_block_line_stride;
+        uint32_t mega_block_size;
+        uint64_t mega_block_row_size;
+        uint32_t width_in_macro_blocks;
+        uint32_t height_in_macro_blocks;
+    };
 
-        uint8_t * plane_base_ptr = frame_base_ptr + plane.base_offset;
+    static reorder_geometry get_reorder_geometry(const xyuv::plane &plane) {
+        reorder_geometry geometry;
 
         uint32_t mega_block_line_stride = plane.block_order.mega_block_width*plane.block_stride;
         XYUV_ASSERT((mega_block_line_stride % 8) == 0
                     && "Assert that block line_stride is full multiple of bytes.");
-        mega_block_line_stride /= 8;
-
-        uint32_t mega_block_size = mega_block_line_stride*plane.block_order.mega_block_height;
-
-
+        geometry.mega_block_line_stride = mega_block_line_stride / 8;
+        geometry.mega_block_size = geometry.mega_block_line_stride*plane.block_order.mega_block_height;
+        geometry.mega_block_row_size = static_cast<uint64_t>(plane.block_order.mega_block_height)*plane.line_stride;
 
         uint32_t width_in_possible_blocks = plane.line_stride*8 / plane.block_stride;
-        uint32_t width_in_macro_blocks = width_in_possible_blocks / plane.block_order.mega_block_width;
+        geometry.width_in_macro_blocks = width_in_possible_blocks / plane.block_order.mega_block_width;
 
         uint32_t height_in_possible_blocks_lines = static_cast<uint32_t>(plane.size / plane.line_stride);
-        uint32_t height_in_macro_blocks = height_in_possible_blocks_lines / plane.block_order.mega_block_height;
-
-        std::unique_ptr<uint8_t[]> temp_plane {new uint8_t[plane.size]};
-
-        for (uint32_t block_y = 0; block_y < height_in_macro_blocks; block_y++) {
-            for (uint32_t block_x = 0; block_x < width_in_macro_blocks; block_x++) {
-                uint8_t * block_base = temp_plane.get() + block_y*(plane.block_order.mega_block_height*plane.line_stride) + block_x*mega_block_size;
-
-                for (uint32_t y = 0; y < plane.block_order.mega_block_height; y++) {
-                    const uint8_t * src_line = plane_base_ptr
-                                               + (block_y*plane.block_order.mega_block_height + y)*plane.line_stride;
-                    for (uint32_t x = 0; x < plane.block_order.mega_block_width; x++) {
-                        auto internal_coord = _get_block_order_coords(x, y, plane.block_order);
-                        // Get destination line of micro block.
-                        uint8_t* dst_line = block_base + internal_coord.second * mega_block_line_stride;
-                        copy_bits(dst_line, internal_coord.first*plane.block_stride, src_line , (block_x*plane.block_order.mega_block_width + x)*plane.block_stride, plane.block_stride );
+        geometry.height_in_macro_blocks = height_in_possible_blocks_lines / plane.block_order.mega_block_height;
+
+        return geometry;
+    }
+
+    // Move the blocks of one row of mega blocks between linear and block order, from a copy of the row to the row.
+    static void reorder_row(uint8_t *row, const uint8_t *row_copy, const xyuv::plane &plane,
+                            const reorder_geometry &geometry, const block_order_table &order, bool to_block_order) {
+        const uint8_t *row_copy_end = row_copy + geometry.mega_block_row_size;
+        const uint8_t *row_end = row + geometry.mega_block_row_size;
+
+        for (uint32_t block_x = 0; block_x < geometry.width_in_macro_blocks; block_x++) {
+            uint64_t block_base = static_cast<uint64_t>(block_x)*geometry.mega_block_size;
+
+            for (uint32_t y = 0; y < plane.block_order.mega_block_height; y++) {
+                // Linear line of the blocks.
+                uint64_t linear_line = static_cast<uint64_t>(y)*plane.line_stride;
+                for (uint32_t x = 0; x < plane.block_order.mega_block_width; x++) {
+                    auto internal_coord = order.coords(x, y);
+                    uint64_t blocked_bit = (block_base + internal_coord.second*geometry.mega_block_line_stride)*8
+                                           + static_cast<uint64_t>(internal_coord.first)*plane.block_stride;
+                    uint64_t linear_bit = linear_line*8
+                                          + static_cast<uint64_t>(block_x*plane.block_order.mega_block_width + x)*plane.block_stride;
+                    if (to_block_order) {
+                        copy_bits(row, row_end, blocked_bit, row_copy, row_copy_end, linear_bit, plane.block_stride);
+                    } else {
+                        copy_bits(row, row_end, linear_bit, row_copy, row_copy_end, blocked_bit, plane.block_stride);
                     }
                 }
             }
         }
-        memcpy(plane_base_ptr, temp_plane.get(), plane.size);
     }
 
-
-    void reorder_inverse( uint8_t * frame_base_ptr, const xyuv::plane &plane) {
-
+    static void reorder_plane(uint8_t * frame_base_ptr, const xyuv::plane &plane, bool to_block_order) {
         if (plane.block_order.mega_block_height == 1
-            && plane.block_order.mega_block_width == 1) {
+                && plane.block_order.mega_block_width == 1) {
             return;
         }
 
         uint8_t * plane_base_ptr = frame_base_ptr + plane.base_offset;
+        reorder_geometry geometry = get_reorder_geometry(plane);
+        block_order_table order(plane.block_order);
+
+        // Reorder in place, only the row being moved is copied aside.
+        std::unique_ptr<uint8_t[]> row_copy { new uint8_t[geometry.mega_block_row_size] };
+        for (uint32_t block_y = 0; block_y < geometry.height_in_macro_blocks; block_y++) {
+            uint8_t *row = plane_base_ptr + block_y*geometry.mega_block_row_size;
+            memcpy(row_copy.get(), row, geometry.mega_block_row_size);
+            reorder_row(row, row_copy.get(), plane, geometry, order, to_block_order);
+        }
+    }
 
-        uint32_t mega_block_line_stride = plane.block_order.mega_block_width*plane.block_stride;
-
-        XYUV_ASSERT((mega_block_line_stride % 8) == 0
-                    && "Assert that block line_stride is full multiple of bytes.");
-        mega_block_line_stride /= 8;
-
-        uint32_t mega_block_size = mega_block_line_stride*plane.block_order.mega_block_height;
-
-
-        uint32_t width_in_possible_blocks = plane.line_stride*8 / plane.block_stride;
-        uint32_t width_in_macro_blocks = width_in_possible_blocks / plane.block_order.mega_block_width;
-
-        uint32_t height_in_possible_blocks_lines = static_cast<uint32_t>(plane.size / plane.line_stride);
-        uint32_t height_in_macro_blocks = height_in_possible_blocks_lines / plane.block_order.mega_block_height;
-
-        std::unique_ptr<uint8_t[]> temp_plane { new uint8_t[plane.size] };
-
-        for (uint32_t block_y = 0; block_y < height_in_macro_blocks; block_y++) {
-            for (uint32_t block_x = 0; block_x < width_in_macro_blocks; block_x++) {
-
-                const uint8_t * block_base = plane_base_ptr + block_y*(plane.block_order.mega_block_height*plane.line_stride) + block_x*mega_block_size;
-
-                for (uint32_t y = 0; y < plane.block_order.mega_block_height; y++) {
-                    // Linear output line
-                    uint8_t * dst_line = temp_plane.get() + (block_y*plane.block_order.mega_block_height + y)*plane.line_stride;
-                    for (uint32_t x = 0; x < plane.block_order.mega_block_width; x++) {
-                        auto internal_coord = _get_block_order_coords(x, y, plane.block_order);
-                        // Get destination line of micro block.
-                        const uint8_t* blocked_line = block_base + internal_coord.second * mega_block_line_stride;
-                        copy_bits(dst_line, (block_x*plane.block_order.mega_block_width + x)*plane.block_stride, blocked_line , internal_coord.first*plane.block_stride, plane.block_stride );
-                    }
-                }
+    void reorder_transform( uint8_t * frame_base_ptr, const xyuv::plane &plane) {
+        reorder_plane(frame_base_ptr, plane, true);
+    }
 
-            }
-        }
-        memcpy(plane_base_ptr, temp_plane.get(), plane.size);
+    void reorder_inverse( uint8_t * frame_base_ptr, const xyuv::plane &plane) {
+        reorder_plane(frame_base_ptr, plane, false);
     }
 
 }
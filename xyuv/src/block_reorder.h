@@ -25,7 +25,12 @@
 #ifndef CROSSYUV_BLOCK_REORDER_H
 #define CROSSYUV_BLOCK_REORDER_H
 
+#include <xyuv/structures/block_order.h>
+
 #include <cstdint>
+#include <utility>
+#include <vector>
+
 namespace xyuv {
 
     struct format;
@@ -33,6 +38,28 @@ namespace xyuv {
     uint32_t get_block_order_offset(uint32_t block_x, uint32_t block_y, const ::block_order & block_order);
     std::pair<uint32_t,uint32_t > get_block_order_coords(uint32_t block_x, uint32_t block_y, const ::block_order & block_order);
 
+    //! \brief A block_order compiled into one lookup table per axis.
+    //! \details Each mask bit maps one coordinate bit to one offset bit, so the offset of a block is the xor of what its
+    //! x and y coordinate contribute. The tables hold these contributions for the coordinates inside a mega block,
+    //! turning get_block_order_offset() into two lookups and an xor.
+    class block_order_table {
+    public:
+        explicit block_order_table(const ::block_order & block_order);
+
+        //! \brief Same as get_block_order_offset() for a block inside the mega block.
+        uint32_t offset(uint32_t block_x, uint32_t block_y) const { return x_offsets_[block_x] ^ y_offsets_[block_y]; }
+
+        //! \brief Same as get_block_order_coords() for a block inside the mega block.
+        std::pair<uint32_t, uint32_t> coords(uint32_t block_x, uint32_t block_y) const {
+            uint32_t offset = this->offset(block_x, block_y);
+            return std::make_pair(offset % mega_block_width_, offset / mega_block_width_);
+        }
+
+    private:
+        uint32_t mega_block_width_;
+        std::vector<uint32_t> x_offsets_, y_offsets_;
+    };
+
     bool needs_reorder(const xyuv::format & format );
     void reorder_transform(uint8_t *frame_base_ptr, const xyuv::plane &plane);
     void reorder_inverse(uint8_t *frame_base_ptr, const xyuv::plane &plane);
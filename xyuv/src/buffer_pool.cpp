@@ -0,0 +1,234 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <xyuv/buffer_pool.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace xyuv {
+
+// Buffers of at least this size are backed by huge pages when requested, their length is rounded up to a multiple.
+static const std::size_t huge_page_size = std::size_t(2) << 20;
+
+// The cache outlives the buffer_pool as long as some allocator or deleter refers to it.
+struct buffer_pool::cache {
+    bool huge_pages = false;
+    // Set when the buffer_pool is destroyed, buffers returned after that are released directly.
+    bool closed = false;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::size_t, std::vector<void *>> free_buffers;
+    statistics stats = statistics();
+
+    bool uses_huge_pages(std::size_t size) const {
+#if defined(__linux__)
+        return huge_pages && size >= huge_page_size;
+#else
+        (void)size;
+        return false;
+#endif
+    }
+
+    void *allocate_new(std::size_t size) const {
+#if defined(__linux__)
+        if (uses_huge_pages(size)) {
+            std::size_t length = (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+            void *buffer = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (buffer == MAP_FAILED) {
+                // No reserved huge pages, let the kernel back the mapping by transparent huge pages instead.
+                buffer = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (buffer == MAP_FAILED) {
+                    throw std::bad_alloc();
+                }
+#if defined(MADV_HUGEPAGE)
+                madvise(buffer, length, MADV_HUGEPAGE);
+#endif
+            }
+            return buffer;
+        }
+#endif
+        return aligned_allocator<uint8_t, buffer_alignment>().allocate(size);
+    }
+
+    void release(void *buffer, std::size_t size) const {
+#if defined(__linux__)
+        if (uses_huge_pages(size)) {
+            munmap(buffer, (size + huge_page_size - 1) / huge_page_size * huge_page_size);
+            return;
+        }
+#endif
+        aligned_allocator<uint8_t, buffer_alignment>().deallocate(static_cast<uint8_t *>(buffer), size);
+    }
+
+    void release_all() {
+        for (auto &entry : free_buffers) {
+            for (void *buffer : entry.second) {
+                release(buffer, entry.first);
+            }
+        }
+        free_buffers.clear();
+        stats.cached_buffers = 0;
+        stats.cached_bytes = 0;
+    }
+
+    ~cache() {
+        release_all();
+    }
+};
+
+buffer_pool::buffer_pool(bool huge_pages)
+    : cache_(std::make_shared<cache>())
+{
+    cache_->huge_pages = huge_pages;
+}
+
+buffer_pool::~buffer_pool() {
+    std::lock_guard<std::mutex> lock(cache_->mutex);
+    cache_->closed = true;
+    cache_->release_all();
+}
+
+void *buffer_pool::allocate(cache &cache, std::size_t size) {
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        auto it = cache.free_buffers.find(size);
+        if (it != cache.free_buffers.end() && !it->second.empty()) {
+            void *buffer = it->second.back();
+            it->second.pop_back();
+            cache.stats.hits++;
+            cache.stats.cached_buffers--;
+            cache.stats.cached_bytes -= size;
+            return buffer;
+        }
+        cache.stats.misses++;
+    }
+    return cache.allocate_new(size);
+}
+
+void buffer_pool::deallocate(cache &cache, void *buffer, std::size_t size) {
+    if (!buffer) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        if (!cache.closed) {
+            try {
+                cache.free_buffers[size].push_back(buffer);
+                cache.stats.cached_buffers++;
+                cache.stats.cached_bytes += size;
+                return;
+            } catch (const std::bad_alloc &) {
+                // Not enough memory to remember the buffer, release it instead.
+            }
+        }
+    }
+    cache.release(buffer, size);
+}
+
+void *buffer_pool::allocate(std::size_t size) {
+    return allocate(*cache_, size);
+}
+
+void buffer_pool::deallocate(void *buffer, std::size_t size) {
+    deallocate(*cache_, buffer, size);
+}
+
+frame_buffer buffer_pool::acquire(std::size_t size) {
+    return frame_buffer(static_cast<uint8_t *>(allocate(*cache_, size)), buffer_deleter(cache_, size));
+}
+
+void buffer_pool::trim() {
+    std::lock_guard<std::mutex> lock(cache_->mutex);
+    cache_->release_all();
+}
+
+buffer_pool::statistics buffer_pool::stats() const {
+    std::lock_guard<std::mutex> lock(cache_->mutex);
+    return cache_->stats;
+}
+
+std::shared_ptr<plane_arena> plane_arena::create(const std::vector<std::size_t> &slot_sizes, buffer_pool *pool) {
+    std::shared_ptr<plane_arena> arena(new plane_arena);
+    arena->slots_.reset(new slot[slot_sizes.size()]);
+    arena->n_slots_ = slot_sizes.size();
+
+    // Every slot starts on a multiple of buffer_alignment.
+    std::size_t offset = 0;
+    for (std::size_t i = 0; i < slot_sizes.size(); i++) {
+        arena->slots_[i].offset = offset;
+        arena->slots_[i].size = slot_sizes[i];
+        arena->slots_[i].in_use = false;
+        offset += (slot_sizes[i] + buffer_alignment - 1) / buffer_alignment * buffer_alignment;
+    }
+    arena->size_ = offset;
+
+    if (pool) {
+        arena->cache_ = pool->cache_;
+        arena->base_ = static_cast<uint8_t *>(buffer_pool::allocate(*arena->cache_, arena->size_));
+    } else {
+        arena->base_ = aligned_allocator<uint8_t, buffer_alignment>().allocate(arena->size_);
+    }
+    return arena;
+}
+
+plane_arena::~plane_arena() {
+    if (cache_) {
+        buffer_pool::deallocate(*cache_, base_, size_);
+    } else {
+        aligned_allocator<uint8_t, buffer_alignment>().deallocate(base_, size_);
+    }
+}
+
+void *plane_arena::take(std::size_t size) {
+    for (std::size_t i = 0; i < n_slots_; i++) {
+        bool expected = false;
+        if (slots_[i].size == size && slots_[i].in_use.compare_exchange_strong(expected, true)) {
+            return base_ + slots_[i].offset;
+        }
+    }
+    return nullptr;
+}
+
+bool plane_arena::give_back(void *buffer) {
+    uintptr_t offset = reinterpret_cast<uintptr_t>(buffer) - reinterpret_cast<uintptr_t>(base_);
+    if (reinterpret_cast<uintptr_t>(buffer) < reinterpret_cast<uintptr_t>(base_) || offset >= size_) {
+        return false;
+    }
+    for (std::size_t i = 0; i < n_slots_; i++) {
+        if (slots_[i].offset == offset && slots_[i].in_use) {
+            slots_[i].in_use = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace xyuv
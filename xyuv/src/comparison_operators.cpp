@@ -25,6 +25,11 @@
 #include <xyuv/structures/format.h>
 #include <cstring>
 
+// Declared in the global namespace along with block_order.
+bool operator==(const block_order & lhs, const block_order & rhs) {
+    return !memcmp(&lhs, &rhs, sizeof(block_order));
+}
+
 namespace xyuv {
 
 bool operator==(const subsampling &lhs, const subsampling &rhs) {
@@ -47,16 +52,13 @@ bool operator==(const conversion_matrix &lhs, const conversion_matrix &rhs) {
            &&  ( lhs.v_range == rhs.v_range );
 }
 
-bool operator==(const block_order & lhs, const block_order & rhs) {
-    return !memcmp(&lhs, &rhs, sizeof(block_order));
-}
-
 bool operator==(const plane &lhs, const plane &rhs) {
     return (lhs.base_offset == rhs.base_offset) &&
             (lhs.interleave_mode == rhs.interleave_mode) &&
             (lhs.block_stride == rhs.block_stride) &&
             (lhs.line_stride == rhs.line_stride) &&
-            (lhs.size == rhs.size );
+            (lhs.size == rhs.size ) &&
+            (lhs.block_order == rhs.block_order);
 }
 
 bool operator==(const sample &lhs, const sample &rhs) {
@@ -70,7 +72,7 @@ bool operator==(const sample &lhs, const sample &rhs) {
 bool operator==(const channel_block &lhs, const channel_block &rhs) {
     if (lhs.samples.size() != rhs.samples.size()
         || lhs.h != rhs.h
-        || lhs.w != rhs.h
+        || lhs.w != rhs.w
             ) {
         return false;
     }
@@ -91,7 +93,8 @@ bool operator==(const format &lhs, const format &rhs) {
     equalThusFar = lhs.fourcc == rhs.fourcc
                    && lhs.origin == rhs.origin
                    && lhs.planes.size() == rhs.planes.size()
-                   && lhs.chroma_siting == rhs.chroma_siting;
+                   && lhs.chroma_siting == rhs.chroma_siting
+                   && lhs.conversion_matrix == rhs.conversion_matrix;
 
     if (!equalThusFar) return false;
 
@@ -147,11 +147,12 @@ bool validate_format_template(const xyuv::format_template &format_template) {
             // on-transformed blocks.
             uint64_t expected_sum = block_size*(block_size-1) / 2;
             uint64_t observed_sum = 0;
+            block_order_table table(plane.block_order);
             for (uint32_t x = 0; x < plane.block_order.mega_block_width; x++) {
                 for (uint32_t y = 0; y < plane.block_order.mega_block_height; y++) {
-                    uint32_t offset = get_block_order_offset(x, y, plane.block_order);
+                    uint32_t offset = table.offset(x, y);
                     if (offset > block_size) {
-                        auto trans = get_block_order_coords(x, y, plane.block_order);
+                        auto trans = table.coords(x, y);
                         throw std::logic_error("Plane " + to_string(i) + ": x=" + to_string(x) + ", y="
                                                + to_string(y) + " gives transformed coordinates ("
                                                + to_string(trans.first) + ", " + to_string(trans.second) + ") which is larger than the supplied mega_block dimensions. "
@@ -0,0 +1,45 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <xyuv/structures/chroma_siting.h>
+#include <xyuv/yuv_image.h>
+
+#include <cstdint>
+
+namespace xyuv {
+
+class buffer_pool;
+
+//! \brief Create an image for the decoder, with all planes in one plane_arena as by create_contiguous_yuv_image().
+//! \details The samples of the luma and chroma planes are left uninitialised, the caller must write all of them. The
+//!          arena only has room for a full alpha plane if \a alpha_written is set.
+//! \param [in] pool buffer pool to draw the arena from, or nullptr to allocate it normally.
+template<typename T>
+basic_yuv_image<T> create_decode_yuv_image(uint32_t image_w, uint32_t image_h, const xyuv::chroma_siting &siting,
+                                           buffer_pool *pool, bool has_Y, bool has_U, bool has_V, bool has_A,
+                                           bool alpha_written);
+
+} // namespace xyuv
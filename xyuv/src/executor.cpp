@@ -0,0 +1,160 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <xyuv/executor.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace xyuv {
+
+// All workers take part in every job: run() publishes the job by bumping the generation and waits until every
+// worker has reported back, so the job fields are never modified while a worker may still read them.
+struct thread_executor::pool {
+    uint32_t n_threads;
+    std::vector<std::thread> workers;
+
+    // Serialises calls to run().
+    std::mutex run_mutex;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    uint32_t n_done = 0;
+    bool stop = false;
+
+    // The current job.
+    const std::function<void(uint32_t)> *task = nullptr;
+    uint32_t n_tasks = 0;
+    std::atomic<uint32_t> next_task;
+
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    // Stops and joins the workers, also those started by a constructor that failed to start the others.
+    ~pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+
+    void work() {
+        uint32_t i;
+        while ((i = next_task.fetch_add(1)) < n_tasks) {
+            try {
+                (*task)(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    }
+
+    void worker_loop() {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [&] { return stop || generation != seen; });
+            if (stop) {
+                return;
+            }
+            seen = generation;
+
+            lock.unlock();
+            work();
+            lock.lock();
+
+            if (++n_done == workers.size()) {
+                done.notify_one();
+            }
+        }
+    }
+};
+
+thread_executor::thread_executor(uint32_t n_threads)
+    : pool_(new pool)
+{
+    if (n_threads == 0) {
+        n_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    pool_->n_threads = n_threads;
+    pool_->next_task = 0;
+
+    // The thread calling run() is the last worker.
+    for (uint32_t i = 1; i < n_threads; i++) {
+        pool_->workers.emplace_back(&pool::worker_loop, pool_.get());
+    }
+}
+
+thread_executor::~thread_executor() = default;
+
+void thread_executor::run(uint32_t n_tasks, const std::function<void(uint32_t)> &task) {
+    if (pool_->workers.empty() || n_tasks <= 1) {
+        for (uint32_t i = 0; i < n_tasks; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> run_lock(pool_->run_mutex);
+    {
+        std::lock_guard<std::mutex> lock(pool_->mutex);
+        pool_->task = &task;
+        pool_->n_tasks = n_tasks;
+        pool_->next_task = 0;
+        pool_->error = nullptr;
+        pool_->n_done = 0;
+        pool_->generation++;
+    }
+    pool_->wake.notify_all();
+
+    pool_->work();
+
+    std::unique_lock<std::mutex> lock(pool_->mutex);
+    pool_->done.wait(lock, [&] { return pool_->n_done == pool_->workers.size(); });
+    pool_->task = nullptr;
+
+    if (pool_->error) {
+        std::rethrow_exception(pool_->error);
+    }
+}
+
+uint32_t thread_executor::concurrency() const {
+    return pool_->n_threads;
+}
+
+} // namespace xyuv
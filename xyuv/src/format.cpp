@@ -126,16 +126,16 @@ xyuv::format create_format(
     return format;
 }
 
-xyuv::frame create_frame(
+// Initialize a frame of format around buffer, which holds at least format.size bytes.
+static xyuv::frame create_frame(
         const xyuv::format &format,
         const uint8_t *raw_data,
-        uint64_t raw_data_size
+        uint64_t raw_data_size,
+        frame_buffer buffer
 ) {
     xyuv::frame frame;
     frame.format = format;
-
-	// First, allocate the buffer.
-	frame.data.reset(new uint8_t[format.size]);
+    frame.data = std::move(buffer);
 
     // If raw_data has been supplied. Copy it.
     if (raw_data != nullptr) {
@@ -143,6 +143,23 @@ xyuv::frame create_frame(
     }
 
     return frame;
+}
+
+xyuv::frame create_frame(
+        const xyuv::format &format,
+        const uint8_t *raw_data,
+        uint64_t raw_data_size
+) {
+    return create_frame(format, raw_data, raw_data_size, frame_buffer(new uint8_t[format.size]));
 };
 
+xyuv::frame create_frame(
+        const xyuv::format &format,
+        const uint8_t *raw_data,
+        uint64_t raw_data_size,
+        buffer_pool &pool
+) {
+    return create_frame(format, raw_data, raw_data_size, pool.acquire(format.size));
+}
+
 } // namespace xyuv
\ No newline at end of file
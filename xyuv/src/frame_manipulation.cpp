@@ -23,25 +23,46 @@
  */
 
 #include <xyuv.h>
+#include <xyuv/codec.h>
 #include <xyuv/frame.h>
 #include <xyuv/yuv_image.h>
+#include "repack.h"
+
+#include <utility>
 
 namespace xyuv {
 
+// Check whether two formats describe the same bits, possibly under different names (e.g. I420 and IYUV).
+static bool same_layout(const format &lhs, const format &rhs) {
+    format renamed = rhs;
+    renamed.fourcc = lhs.fourcc;
+    return lhs == renamed;
+}
+
 xyuv::frame convert_frame(const xyuv::frame &frame_in, const format &new_format) {
     // First, check if this is a no-op.
-/*    if (frame_in.format == new_format) {
-        return frame_in;
+    if (same_layout(frame_in.format, new_format)) {
+        return create_frame(new_format, frame_in.data.get(), frame_in.format.size);
     }
-*/
-    xyuv::yuv_image temporary_image = decode_frame(frame_in);
-    return encode_frame(temporary_image, new_format);
+
+    // If only the layout changes, move the packed samples without unpacking them.
+    xyuv::frame repacked;
+    if (repack_frame(frame_in, new_format, &repacked)) {
+        return repacked;
+    }
+
+    // Opaque alpha is carried as a constant, instead of unpacking and repacking a full plane of ones.
+    xyuv::codec decoder(frame_in.format);
+    decoder.set_detect_opaque_alpha(true);
+    xyuv::yuv_image temporary_image;
+    decoder.decode(frame_in.data.get(), &temporary_image);
+    return encode_frame(std::move(temporary_image), new_format);
 }
 
 
 xyuv::frame read_frame_from_rgb_image(const rgb_image &rgbImage_in, const format &new_format) {
     yuv_image temporary_image = rgb_to_yuv_image(rgbImage_in, new_format.conversion_matrix);
-    return encode_frame(temporary_image, new_format);
+    return encode_frame(std::move(temporary_image), new_format);
 }
 
 void write_frame_to_rgb_image(rgb_image *rgbImage_out, const xyuv::frame &frame_in) {
@@ -37,6 +37,9 @@ namespace xyuv {
 #   define be64toh(x) ntohll(x)
 #   define be32toh(x) ntohl(x)
 #   define be16toh(x) ntohs(x)
+    // All Windows targets are little endian.
+#   define htole64(x) (x)
+#   define le64toh(x) (x)
 #elif defined(__linux__)
 #   include <endian.h>
 #elif defined(__FreeBSD__) || defined(__NetBSD__)
@@ -46,6 +49,7 @@ namespace xyuv {
 #   define be16toh(x) betoh16(x)
 #   define be32toh(x) betoh32(x)
 #   define be64toh(x) betoh64(x)
+#   define le64toh(x) letoh64(x)
 #elif defined(__APPLE__)
 #	include <libkern/OSByteOrder.h>
 #	define htobe16(x) OSSwapHostToBigInt16(x)
@@ -54,6 +58,8 @@ namespace xyuv {
 #	define be16toh(x) OSSwapBigToHostInt16(x)
 #	define be32toh(x) OSSwapBigToHostInt32(x)
 #	define be64toh(x) OSSwapBigToHostInt64(x)
+#	define htole64(x) OSSwapHostToLittleInt64(x)
+#	define le64toh(x) OSSwapLittleToHostInt64(x)
 #endif
 
 inline uint64_t host_to_be(uint64_t val) {
@@ -96,4 +102,12 @@ inline bool be_to_host(bool val) {
 	return val;
 }
 
+inline uint64_t host_to_le(uint64_t val) {
+	return htole64(val);
+}
+
+inline uint64_t le_to_host(uint64_t val) {
+	return le64toh(val);
+}
+
 } // namespace xyuv
\ No newline at end of file
@@ -116,13 +116,18 @@ void read_frame(
     io_file_header file_header;
     read_file_header(istream, file_header);
 
+    // Reading a stream of frames of the same format into the same frame reuses its buffer.
+    uint64_t old_size = frame->data ? frame->format.size : 0;
+
     uint16_t version = be_to_host(file_header.version);
     XYUV_ASSERT(version < file_format_loaders.size() && "ERROR: File format too new for this library.");
 
     file_format_loaders[version](istream, frame->format, file_header);
 
     validate_format(frame->format);
-    frame->data.reset( new uint8_t[frame->format.size]);
+    if (!frame->data || old_size != frame->format.size) {
+        frame->data = frame_buffer(new uint8_t[frame->format.size]);
+    }
     read_large_buffer(istream, reinterpret_cast<char*>(frame->data.get()), frame->format.size);
 }
 
@@ -0,0 +1,397 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "pack_plan.h"
+#include "block_reorder.h"
+#include "assert.h"
+#include "utility.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace xyuv {
+
+static uint32_t get_line(uint32_t block_line, xyuv::interleave_pattern interleave_pattern, uint32_t height_in_blocks) {
+    switch (interleave_pattern) {
+    case xyuv::interleave_pattern::NO_INTERLEAVING:
+        return block_line;
+    case xyuv::interleave_pattern::INTERLEAVE_0_2_4__1_3_5:
+        if (block_line & 1) {
+            uint32_t split_at = (height_in_blocks + 1) / 2;
+            return split_at + (block_line/2);
+        }
+        else {
+            return (block_line/2);
+        }
+    case xyuv::interleave_pattern::INTERLEAVE_1_3_5__0_2_4:
+        if (block_line & 1) {
+            return (block_line/2);
+        }
+        else {
+            uint32_t split_at = (height_in_blocks) / 2;
+            return split_at + (block_line/2);
+        }
+    }
+    XYUV_ASSERT(false && "Unreachable");
+    return block_line;
+}
+
+static void compile_samples(channel_plan *plan, const channel_block &block, const std::vector<plane> &planes) {
+    for (std::size_t i = 0; i < block.samples.size();) {
+        value_plan value;
+        value.integer_bits = 0;
+        value.fractional_bits = 0;
+        value.first_part = static_cast<uint32_t>(plan->parts.size());
+        value.n_parts = 0;
+
+        // A sample with continuation spans all samples up to and including the next one without continuation.
+        // They are listed from most to least significant bits.
+        std::size_t end = i;
+        while (end < block.samples.size() && block.samples[end].has_continuation) {
+            end++;
+        }
+        if (end == block.samples.size()) {
+            throw std::logic_error("The last sample of a channel block cannot have continuation.");
+        }
+
+        for (std::size_t j = i; j <= end; j++) {
+            const xyuv::sample &sample = block.samples[j];
+            value.integer_bits += sample.integer_bits;
+            value.fractional_bits += sample.fractional_bits;
+
+            part_plan part;
+            part.plane = sample.plane;
+            part.bits = sample.integer_bits + sample.fractional_bits;
+            part.shift = 0;
+            part.offset = sample.offset;
+            part.block_stride = planes[sample.plane].block_stride;
+            part.line_size = planes[sample.plane].line_stride;
+            plan->parts.push_back(part);
+            value.n_parts++;
+        }
+
+        // Resolve the position of each part within the value, the last part holds the least significant bits.
+        uint8_t shift = 0;
+        for (uint32_t p = value.n_parts; p-- > 0; ) {
+            part_plan &part = plan->parts[value.first_part + p];
+            part.shift = shift;
+            shift += part.bits;
+        }
+
+        uint32_t index = static_cast<uint32_t>(plan->values.size());
+        value.x = static_cast<uint16_t>(index % block.w);
+        value.y = static_cast<uint16_t>(index / block.w);
+        plan->values.push_back(value);
+
+        i = end + 1;
+    }
+
+    if (plan->values.size() != static_cast<std::size_t>(block.w) * block.h) {
+        throw std::logic_error("The number of samples in a channel block must equal block_w * block_h.");
+    }
+}
+
+// Determine whether all values of the channel are plain 8 or 16 bit fields on byte boundaries.
+static uint8_t get_byte_width(const channel_plan &plan) {
+    uint8_t bits = plan.parts.front().bits;
+    if (bits != 8 && bits != 16) {
+        return 0;
+    }
+
+    for (const part_plan &part : plan.parts) {
+        if (part.bits != bits || (part.offset % 8) != 0 || (part.block_stride % 8) != 0) {
+            return 0;
+        }
+    }
+
+    // A single part per value means no continuation.
+    if (plan.parts.size() != plan.values.size()) {
+        return 0;
+    }
+
+    return static_cast<uint8_t>(bits / 8);
+}
+
+static channel_plan compile_channel(const xyuv::format &format, uint32_t channel_index, const std::pair<float, float> &range) {
+    const channel_block &block = format.channel_blocks[channel_index];
+
+    channel_plan plan;
+    plan.present = !block.samples.empty();
+    if (!plan.present) {
+        return plan;
+    }
+
+    plan.block_w = block.w;
+    plan.block_h = block.h;
+    plan.range = range;
+
+    // Surface dimensions, these must match the ones given by create_yuv_image.
+    plan.width = format.image_w;
+    plan.height = format.image_h;
+    if (channel_index == channel::U || channel_index == channel::V) {
+        const subsampling &subsampling = format.chroma_siting.subsampling;
+        plan.width = (format.image_w + subsampling.macro_px_w - 1) / subsampling.macro_px_w;
+        plan.height = (format.image_h + subsampling.macro_px_h - 1) / subsampling.macro_px_h;
+    }
+
+    plan.n_blocks_in_line = plan.width / block.w;
+    plan.n_block_lines = plan.height / block.h;
+
+    compile_samples(&plan, block, format.planes);
+    plan.byte_width = get_byte_width(plan);
+
+    // Resolve interleaving and line stride for every block line in every plane.
+    bool negative_line_stride = (format.origin == image_origin::LOWER_LEFT);
+    plan.line_offsets.resize(format.planes.size() * plan.n_block_lines);
+    for (std::size_t p = 0; p < format.planes.size(); p++) {
+        const xyuv::plane &plane = format.planes[p];
+
+        int64_t first_line = static_cast<int64_t>(plane.base_offset);
+        int64_t line_stride = static_cast<int64_t>(plane.line_stride);
+        if (negative_line_stride) {
+            // Each line is still left to right.
+            line_stride = -line_stride;
+            first_line += static_cast<int64_t>(plane.size) + line_stride;
+        }
+
+        for (uint32_t line = 0; line < plan.n_block_lines; line++) {
+            uint32_t interleaved_line = get_line(line, plane.interleave_mode, plan.n_block_lines);
+            plan.line_offsets[p * plan.n_block_lines + line] = first_line + interleaved_line * line_stride;
+        }
+    }
+
+    return plan;
+}
+
+static tiling_plan compile_tiling(const xyuv::plane &plane) {
+    const ::block_order &order = plane.block_order;
+
+    tiling_plan tiling;
+    if (order.mega_block_width == 1 && order.mega_block_height == 1) {
+        return tiling;
+    }
+
+    uint64_t mega_block_line_bits = static_cast<uint64_t>(order.mega_block_width) * plane.block_stride;
+    if ((mega_block_line_bits % 8) != 0) {
+        throw std::logic_error("The lines of a mega block must be a whole number of bytes.");
+    }
+    uint64_t mega_block_line_stride = mega_block_line_bits / 8;
+
+    tiling.tiled = true;
+    tiling.base_offset = plane.base_offset;
+    tiling.line_stride = plane.line_stride;
+    tiling.mega_block_w = order.mega_block_width;
+    tiling.mega_block_h = order.mega_block_height;
+    tiling.mega_block_size = mega_block_line_stride * order.mega_block_height;
+    tiling.mega_block_row_size = static_cast<uint64_t>(order.mega_block_height) * plane.line_stride;
+
+    // Must match the region reorder_transform() moves.
+    tiling.n_mega_blocks_in_row = (plane.line_stride * 8 / plane.block_stride) / order.mega_block_width;
+    tiling.n_mega_block_rows = static_cast<uint32_t>(plane.size / plane.line_stride) / order.mega_block_height;
+
+    block_order_table table(order);
+    tiling.block_offsets.resize(static_cast<std::size_t>(order.mega_block_width) * order.mega_block_height);
+    for (uint32_t y = 0; y < order.mega_block_height; y++) {
+        for (uint32_t x = 0; x < order.mega_block_width; x++) {
+            auto coords = table.coords(x, y);
+            tiling.block_offsets[y * order.mega_block_width + x] =
+                    static_cast<uint32_t>(coords.second * mega_block_line_stride * 8 + coords.first * plane.block_stride);
+        }
+    }
+
+    return tiling;
+}
+
+// Flag channels with bits in tiled planes. Blocks are moved whole, so every part must stay within one block.
+static void mark_tiled_channels(pack_plan *plan) {
+    for (channel_plan &channel : plan->channels) {
+        for (const part_plan &part : channel.parts) {
+            if (!plan->tilings[part.plane].tiled) {
+                continue;
+            }
+            if ((part.offset % part.block_stride) + part.bits > part.block_stride) {
+                throw std::logic_error("A sample in a block ordered plane cannot cross the end of its block.");
+            }
+            channel.tiled = true;
+        }
+    }
+}
+
+// Check whether any plane used by channel a overlaps in memory with any plane used by channel b.
+static bool channels_overlap(const channel_plan &a, const channel_plan &b, const std::vector<xyuv::plane> &planes) {
+    for (const part_plan &part_a : a.parts) {
+        const xyuv::plane &plane_a = planes[part_a.plane];
+        for (const part_plan &part_b : b.parts) {
+            const xyuv::plane &plane_b = planes[part_b.plane];
+            if (plane_a.base_offset < plane_b.base_offset + plane_b.size
+                && plane_b.base_offset < plane_a.base_offset + plane_a.size) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Check that the bits of a block line are contained in the line stride of their plane.
+static bool lines_are_disjoint(const channel_plan &plan) {
+    if (plan.n_blocks_in_line == 0) {
+        return true;
+    }
+    for (const part_plan &part : plan.parts) {
+        uint64_t last_bit = static_cast<uint64_t>(plan.n_blocks_in_line - 1) * part.block_stride + part.offset + part.bits;
+        if (last_bit > static_cast<uint64_t>(part.line_size) * 8) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Number of block lines of channel in a row of mega blocks of its tiled planes. Ranges of block lines starting on a
+// multiple of it never share a mega block. Zero if the rows of mega blocks do not follow the block lines in order,
+// e.g. for interleaved planes.
+static uint32_t mega_block_row_lines(const pack_plan &plan, const channel_plan &channel) {
+    uint32_t granularity = 1;
+    for (const part_plan &part : channel.parts) {
+        const tiling_plan &tiling = plan.tilings[part.plane];
+        if (!tiling.tiled || channel.n_block_lines == 0) {
+            continue;
+        }
+
+        // Same addressing as for_each_tiled_block().
+        auto mega_block_row = [&](uint32_t line) {
+            int64_t line_offset = channel.line_offset(part.plane, line) - static_cast<int64_t>(tiling.base_offset);
+            return static_cast<uint64_t>(line_offset) / tiling.line_stride / tiling.mega_block_h;
+        };
+
+        uint32_t lines = 1;
+        while (lines < channel.n_block_lines && mega_block_row(lines) == mega_block_row(0)) {
+            lines++;
+        }
+        for (uint32_t line = 0; line < channel.n_block_lines; line++) {
+            if (mega_block_row(line) != mega_block_row(0) + line / lines) {
+                return 0;
+            }
+        }
+        granularity = lcm(granularity, lines);
+    }
+    return granularity;
+}
+
+static std::vector<channel_group> compile_groups(const pack_plan &plan, const xyuv::format &format) {
+    // Each channel starts in its own group, then overlapping channels are merged into the lowest group.
+    std::array<uint32_t, 4> group_of = {{0, 1, 2, 3}};
+    for (uint32_t a = 0; a < 4; a++) {
+        for (uint32_t b = a + 1; b < 4; b++) {
+            if (plan.channels[a].present && plan.channels[b].present
+                && channels_overlap(plan.channels[a], plan.channels[b], format.planes)) {
+                uint32_t from = group_of[b], to = group_of[a];
+                for (auto &group : group_of) {
+                    if (group == from) group = to;
+                }
+            }
+        }
+    }
+
+    std::vector<channel_group> groups;
+    for (uint32_t g = 0; g < 4; g++) {
+        channel_group group;
+        group.splittable = true;
+        for (uint32_t c = 0; c < 4; c++) {
+            const channel_plan &channel = plan.channels[c];
+            if (!channel.present || group_of[c] != g) {
+                continue;
+            }
+            if (!group.channels.empty() && channel.n_block_lines != group.n_block_lines) {
+                group.splittable = false;
+            }
+            // Block lines of a tiled plane share mega blocks, so such planes are only split between rows of them.
+            uint32_t row_lines = mega_block_row_lines(plan, channel);
+            group.splittable = group.splittable && lines_are_disjoint(channel) && row_lines != 0;
+            if (row_lines != 0) {
+                group.split_granularity = lcm(group.split_granularity, row_lines);
+            }
+            group.n_block_lines = std::max(group.n_block_lines, channel.n_block_lines);
+            group.channels.push_back(c);
+        }
+        if (!group.channels.empty()) {
+            groups.push_back(group);
+        }
+    }
+    return groups;
+}
+
+// Stripes are sized to keep their input and output within this many bytes.
+static const uint64_t STRIPE_CACHE_BUDGET = 256 * 1024;
+
+static uint32_t compile_stripe_height(const pack_plan &plan, const xyuv::format &format) {
+    uint32_t stripe_height = 0;
+    for (const channel_group &group : plan.groups) {
+        if (group.n_block_lines == 0) {
+            continue;
+        }
+
+        // Every block line of the group touches one line of each plane used, and the rows of its surfaces.
+        std::vector<bool> plane_used(format.planes.size(), false);
+        uint64_t bytes_per_line = 0;
+        for (uint32_t c : group.channels) {
+            const channel_plan &channel = plan.channels[c];
+            for (const part_plan &part : channel.parts) {
+                if (!plane_used[part.plane]) {
+                    plane_used[part.plane] = true;
+                    bytes_per_line += part.line_size;
+                }
+            }
+            uint64_t surface_bytes = static_cast<uint64_t>(channel.width) * channel.block_h * sizeof(float);
+            bytes_per_line += surface_bytes * channel.n_block_lines / group.n_block_lines;
+        }
+
+        uint64_t lines = STRIPE_CACHE_BUDGET / std::max<uint64_t>(bytes_per_line, 1);
+        lines = std::max<uint64_t>(1, std::min<uint64_t>(lines, group.n_block_lines));
+        if (stripe_height == 0 || lines < stripe_height) {
+            stripe_height = static_cast<uint32_t>(lines);
+        }
+    }
+    return std::max(stripe_height, 1u);
+}
+
+pack_plan compile_pack_plan(const xyuv::format &format) {
+    pack_plan plan;
+
+    plan.channels[channel::Y] = compile_channel(format, channel::Y, format.conversion_matrix.y_packed_range);
+    plan.channels[channel::U] = compile_channel(format, channel::U, format.conversion_matrix.u_packed_range);
+    plan.channels[channel::V] = compile_channel(format, channel::V, format.conversion_matrix.v_packed_range);
+    plan.channels[channel::A] = compile_channel(format, channel::A, std::make_pair<float, float>(0.0f, 1.0f));
+
+    for (const xyuv::plane &plane : format.planes) {
+        plan.tilings.push_back(compile_tiling(plane));
+    }
+    mark_tiled_channels(&plan);
+
+    plan.groups = compile_groups(plan, format);
+    plan.stripe_height = compile_stripe_height(plan, format);
+
+    return plan;
+}
+
+} // namespace xyuv
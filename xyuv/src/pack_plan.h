@@ -0,0 +1,173 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <xyuv/structures/format.h>
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace xyuv {
+
+//! \brief A run of consecutive bits belonging to one sample value.
+//! \details A sample without continuation is stored in a single part, a sample with continuation is split into
+//! one part per continuation sample. Parts are stored most significant part first.
+struct part_plan {
+    //! Index of the plane holding the bits.
+    uint8_t plane;
+    //! Number of bits in this part.
+    uint8_t bits;
+    //! Position of the least significant bit of this part within the sample value.
+    uint8_t shift;
+    //! Offset in bits from the start of the block to the first bit of this part.
+    uint32_t offset;
+    //! Copy of the block stride (in bits) of the plane holding the bits.
+    uint32_t block_stride;
+    //! Copy of the line stride (in bytes) of the plane holding the bits, bounds word accesses to the line.
+    uint32_t line_size;
+};
+
+//! \brief A flattened sample value, i.e. the storage of one pixel in a channel block.
+struct value_plan {
+    //! Total number of integer bits of the sample value (including continuations).
+    uint8_t integer_bits;
+    //! Total number of fractional bits of the sample value (including continuations).
+    uint8_t fractional_bits;
+    //! Position of the pixel inside the block.
+    uint16_t x, y;
+    //! Index of the first part of this value in channel_plan::parts.
+    uint32_t first_part;
+    //! Number of parts making up this value.
+    uint32_t n_parts;
+};
+
+//! \brief Everything needed to pack or unpack one channel of a frame.
+struct channel_plan {
+    //! False if the format does not have this channel.
+    bool present = false;
+
+    //! Dimensions of the channel block in pixels.
+    uint16_t block_w = 0, block_h = 0;
+
+    //! Dimensions of the surface holding this channel.
+    uint32_t width = 0, height = 0;
+
+    //! Dimensions of the channel measured in blocks.
+    uint32_t n_blocks_in_line = 0, n_block_lines = 0;
+
+    //! Packed range of the channel, see conversion_matrix::y_packed_range.
+    std::pair<float, float> range;
+
+    //! One entry per pixel in the block, in the order they appear in the block.
+    std::vector<value_plan> values;
+
+    //! Bit runs of all values.
+    std::vector<part_plan> parts;
+
+    //! True if any part is stored in a block ordered plane, such channels look up the address of every block.
+    bool tiled = false;
+
+    //! \brief Size in bytes of every value if the channel can use the byte aligned fast path, 0 otherwise.
+    //! \details Set to 1 or 2 when all values are stored without continuation as 8 or 16 bit little endian
+    //! integers starting on a byte boundary.
+    uint8_t byte_width = 0;
+
+    //! \brief Byte offset from the start of the frame to the first byte of each block line.
+    //! \details The offset for block line l in plane p is found at index p*n_block_lines + l. Interleaving and negative
+    //! line strides (lower left origin) are already resolved.
+    std::vector<int64_t> line_offsets;
+
+    //! \brief Get the byte offset of block line \a line in plane \a plane.
+    int64_t line_offset(uint32_t plane, uint32_t line) const {
+        return line_offsets[static_cast<std::size_t>(plane) * n_block_lines + line];
+    }
+};
+
+//! \brief The block order of a plane, resolved so that blocks can be addressed directly at their tiled position.
+//! \details Like reorder_transform(), only blocks inside complete mega blocks are stored.
+struct tiling_plan {
+    //! False for planes stored in plain line order, the remaining fields are then unused.
+    bool tiled = false;
+
+    //! Byte offset of the plane from the start of the frame.
+    uint64_t base_offset = 0;
+
+    //! Line stride of the plane in bytes.
+    uint32_t line_stride = 0;
+
+    //! Dimensions of a mega block in blocks.
+    uint32_t mega_block_w = 1, mega_block_h = 1;
+
+    //! Number of complete mega blocks in a row of mega blocks, and number of complete rows of mega blocks.
+    uint32_t n_mega_blocks_in_row = 0, n_mega_block_rows = 0;
+
+    //! Size in bytes of a mega block, and of a row of mega blocks (mega_block_h lines of the plane).
+    uint64_t mega_block_size = 0, mega_block_row_size = 0;
+
+    //! Offset in bits from the start of a mega block to its block (x, y), found at index y*mega_block_w + x.
+    std::vector<uint32_t> block_offsets;
+};
+
+//! \brief Channels that store bits in the same planes, and therefore must be packed by the same task.
+struct channel_group {
+    //! Indices of the channels in the group, in increasing order.
+    std::vector<uint32_t> channels;
+
+    //! Number of block lines to process, the largest of the channels.
+    uint32_t n_block_lines = 0;
+
+    //! \brief True if ranges of block lines may be packed in parallel.
+    //! \details This requires all channels to have the same number of block lines and every block line to stay within
+    //! its own line of the plane, so that different block lines never share a byte.
+    bool splittable = false;
+
+    //! \brief Ranges of block lines packed in parallel start on a multiple of this many block lines.
+    //! \details Keeps every row of mega blocks of a tiled plane within one range.
+    uint32_t split_granularity = 1;
+};
+
+//! \brief A format compiled into the tables needed by the pixel packer.
+struct pack_plan {
+    //! Channel plans, the layout of the array is { Y, U, V, A }.
+    std::array<channel_plan, 4> channels;
+
+    //! Groups of present channels touching disjoint bytes of the frame.
+    std::vector<channel_group> groups;
+
+    //! \brief Default number of block lines of a group to pack for all of its channels before moving on.
+    //! \details Chosen such that the packed lines and the surface rows of a stripe fit in a typical L2 cache.
+    uint32_t stripe_height = 1;
+
+    //! One entry per plane of the format.
+    std::vector<tiling_plan> tilings;
+};
+
+//! \brief Precompute all format dependent tables used when en-/decoding a frame of format \a format.
+//! \throw std::logic_error if the format cannot be compiled.
+pack_plan compile_pack_plan(const xyuv::format &format);
+
+} // namespace xyuv
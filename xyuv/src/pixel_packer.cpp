@@ -25,542 +25,888 @@
 #include <xyuv.h>
 #include <xyuv/yuv_image.h>
 #include <xyuv/frame.h>
+#include <xyuv/codec.h>
+#include <xyuv/executor.h>
 #include <xyuv/structures/constants.h>
 
 #include "config-parser/minicalc/minicalc.h"
 #include "utility.h"
 #include "assert.h"
-#include "block_reorder.h"
+#include "bit_stream.h"
+#include "block_access.h"
+#include "contiguous_image.h"
+#include "pack_plan.h"
+#include "quantize.h"
+#include "scaler.h"
 
 #include <algorithm>
+#include <array>
+#include <stdexcept>
 #include <string.h>
 
 namespace xyuv {
 
-using unorm_t = uint64_t;
+//! \brief Buffer is seen as a continuous stream of bits from lsb of LSB to msb of MSB.
+//! Offset is in bits from least significant bit of buffer to least significant bit of value
+//! Value is sent by reference because it needs to be destroyed when writing continuation blocks.
+void write_bits(uint8_t *buffer, uint64_t offset, uint8_t bits, unorm_t &value) {
+    // Without a known buffer end, only touch the bytes covered by the value.
+    insert_bits(buffer, buffer + (offset + bits + 7) / 8, offset, bits, value);
+    value = bits < 64 ? value >> bits : 0;
+}
 
-    static uint32_t get_line(uint32_t block_line, xyuv::interleave_pattern interleave_pattern, uint32_t height_in_blocks) {
-        switch (interleave_pattern) {
-        case xyuv::interleave_pattern::NO_INTERLEAVING:
-            return block_line;
-        case xyuv::interleave_pattern::INTERLEAVE_0_2_4__1_3_5:
-            if (block_line & 1) {
-                uint32_t split_at = (height_in_blocks + 1) / 2;
-                return split_at + (block_line/2);
-            }
-            else {
-                return (block_line/2);
-            }
-        case xyuv::interleave_pattern::INTERLEAVE_1_3_5__0_2_4:
-            if (block_line & 1) {
-                return (block_line/2);
+//! \brief Buffer is seen as a continuous stream of bits from lsb of LSB to msb of MSB.
+//! Offset is in bits from least significant bit of buffer to least significant bit of value
+unorm_t read_bits(unorm_t & value, const uint8_t *buffer, uint64_t offset, uint8_t bits) {
+    unorm_t read = extract_bits(buffer, buffer + (offset + bits + 7) / 8, offset, bits);
+    value = bits < 64 ? (value << bits) | read : read;
+    return value;
+}
+
+// Fast path for channels where every value is a plain byte aligned 8 or 16 bit field, see channel_plan::byte_width.
+// Each value of the block is scattered along the line with a fixed byte stride.
+template <typename T, typename Q>
+static void encode_channel_aligned(uint8_t *base_addr, const channel_plan &plan, const surface_view<const Q> &surf,
+                                   uint32_t first_line, uint32_t last_line) {
+    std::vector<uint16_t> codes(plan.n_blocks_in_line);
+    for (uint32_t line = first_line; line < last_line; line++) {
+        uint32_t y = line * plan.block_h;
+        for (const value_plan &value : plan.values) {
+            const part_plan &part = plan.parts[value.first_part];
+            uint8_t *dst = base_addr + plan.line_offset(part.plane, line) + part.offset / 8;
+            uint32_t dst_stride = part.block_stride / 8;
+            const Q *src = surf.scanline(y + value.y) + value.x;
+
+            to_unorm_batch(src, plan.block_w, codes.size(), value.integer_bits, value.fractional_bits, plan.range,
+                           codes.data());
+            for (uint32_t b = 0; b < plan.n_blocks_in_line; b++) {
+                store_le(dst + b * dst_stride, static_cast<T>(codes[b]));
             }
-            else {
-                uint32_t split_at = (height_in_blocks) / 2;
-                return split_at + (block_line/2);
+        }
+    }
+}
+
+// The blocks to unpack: blocks [first_block, last_block) of block lines [first_line, last_line). Block first_block of
+// block line origin_line is unpacked to pixel (0, 0) of the destination surface.
+struct block_window {
+    uint32_t first_line, last_line;
+    uint32_t first_block, last_block;
+    uint32_t origin_line;
+};
+
+template <typename T, typename Q>
+static void decode_channel_aligned(const uint8_t *base_addr, const channel_plan &plan, const surface_view<Q> &surf,
+                                   const block_window &window) {
+    std::vector<uint16_t> codes(window.last_block - window.first_block);
+    for (uint32_t line = window.first_line; line < window.last_line; line++) {
+        uint32_t y = (line - window.origin_line) * plan.block_h;
+        for (const value_plan &value : plan.values) {
+            const part_plan &part = plan.parts[value.first_part];
+            uint32_t src_stride = part.block_stride / 8;
+            const uint8_t *src = base_addr + plan.line_offset(part.plane, line) + part.offset / 8
+                                 + static_cast<uint64_t>(window.first_block) * src_stride;
+            Q *dst = surf.scanline(y + value.y) + value.x;
+
+            for (uint32_t b = 0; b < codes.size(); b++) {
+                codes[b] = load_le<T>(src + b * src_stride);
             }
+            from_unorm_batch(codes.data(), codes.size(), value.integer_bits, value.fractional_bits, plan.range,
+                             dst, plan.block_w);
         }
-        XYUV_ASSERT(false && "Unreachable");
     }
+}
 
+// Quantize one value of every block in a block line, using the batch conversion where the value is narrow enough.
+template <typename Q>
+static void quantize_line(const Q *src, const channel_plan &plan, const value_plan &value,
+                          std::vector<uint16_t> *batch, std::vector<unorm_t> *codes) {
+    if (value.integer_bits + value.fractional_bits <= MAX_BATCH_BITS) {
+        to_unorm_batch(src, plan.block_w, batch->size(), value.integer_bits, value.fractional_bits, plan.range,
+                       batch->data());
+        std::copy(batch->begin(), batch->end(), codes->begin());
+    } else {
+        for (uint32_t b = 0; b < codes->size(); b++) {
+            (*codes)[b] = to_unorm(quantum_traits<Q>::to_float(src[b * plan.block_w]),
+                                   value.integer_bits, value.fractional_bits, plan.range);
+        }
+    }
+}
 
-static inline unorm_t round_to_unorm(double val) {
-    using std::floor;
-    return static_cast<unorm_t>(floor(val + 0.5));
+template <typename Q>
+static void dequantize_line(const std::vector<unorm_t> &codes, const channel_plan &plan, const value_plan &value,
+                            std::vector<uint16_t> *batch, Q *dst) {
+    if (value.integer_bits + value.fractional_bits <= MAX_BATCH_BITS) {
+        std::copy(codes.begin(), codes.end(), batch->begin());
+        from_unorm_batch(batch->data(), batch->size(), value.integer_bits, value.fractional_bits, plan.range,
+                         dst, plan.block_w);
+    } else {
+        for (uint32_t b = 0; b < codes.size(); b++) {
+            dst[b * plan.block_w] = quantum_traits<Q>::from_float(
+                    from_unorm(codes[b], value.integer_bits, value.fractional_bits, plan.range));
+        }
+    }
 }
 
-static unorm_t to_unorm(float value, uint8_t integer_bits, uint8_t fractional_bits,
-                        const std::pair<float, float> &range) {
-    using std::min;
-    XYUV_ASSERT_RANGE(0.0f, 1.0f, value);
-    XYUV_ASSERT(integer_bits + fractional_bits <= 8 * sizeof(unorm_t));
-    XYUV_ASSERT(integer_bits < 8 * sizeof(unorm_t));
+// Generic path, handles any bit alignment and continuation samples.
+template <typename Q>
+static void encode_channel_bits(uint8_t *base_addr, const channel_plan &plan, const surface_view<const Q> &surf,
+                                uint32_t first_line, uint32_t last_line) {
+    std::vector<uint16_t> batch(plan.n_blocks_in_line);
+    std::vector<unorm_t> codes(plan.n_blocks_in_line);
+
+    for (uint32_t line = first_line; line < last_line; line++) {
+        uint32_t y = line * plan.block_h;
+        for (const value_plan &value : plan.values) {
+            quantize_line(surf.scanline(y + value.y) + value.x, plan, value, &batch, &codes);
+
+            // Write each part of the value, for samples without continuation there is only one.
+            for (uint32_t p = value.first_part; p < value.first_part + value.n_parts; p++) {
+                const part_plan &part = plan.parts[p];
+                uint8_t *ptr_to_line = base_addr + plan.line_offset(part.plane, line);
+
+                for (uint32_t b = 0; b < plan.n_blocks_in_line; b++) {
+                    insert_bits(ptr_to_line, ptr_to_line + part.line_size,
+                                b * part.block_stride + part.offset, part.bits, codes[b] >> part.shift);
+                }
+            }
+        }
+    }
+}
 
-    // What is the largest integer value representable
-    unorm_t max = (0x1ull << integer_bits) - 1;
-    max <<= fractional_bits;
+template <typename Q>
+static void decode_channel_bits(const uint8_t *base_addr, const channel_plan &plan, const surface_view<Q> &surf,
+                                const block_window &window) {
+    std::vector<uint16_t> batch(window.last_block - window.first_block);
+    std::vector<unorm_t> codes(window.last_block - window.first_block);
 
-    double dbl_val = value;
+    for (uint32_t line = window.first_line; line < window.last_line; line++) {
+        uint32_t y = (line - window.origin_line) * plan.block_h;
+        for (const value_plan &value : plan.values) {
+            std::fill(codes.begin(), codes.end(), 0);
 
-    // Scale value to range boundaries:
-    dbl_val *= (range.second - range.first);
-    dbl_val += range.first;
+            for (uint32_t p = value.first_part; p < value.first_part + value.n_parts; p++) {
+                const part_plan &part = plan.parts[p];
+                const uint8_t *ptr_to_line = base_addr + plan.line_offset(part.plane, line);
 
-    // Convert to unorm
-    unorm_t bits = round_to_unorm(dbl_val * max);
+                for (uint32_t b = window.first_block; b < window.last_block; b++) {
+                    codes[b - window.first_block] |= extract_bits(ptr_to_line, ptr_to_line + part.line_size,
+                            static_cast<uint64_t>(b) * part.block_stride + part.offset, part.bits) << part.shift;
+                }
+            }
 
-    return bits;
+            dequantize_line(codes, plan, value, &batch, surf.scanline(y + value.y) + value.x);
+        }
+    }
 }
 
-static float from_unorm(unorm_t unorm, uint8_t integer_bits, uint8_t fractional_bits,
-                        const std::pair<float, float> &range) {
-    XYUV_ASSERT(integer_bits + fractional_bits <= 8 * sizeof(unorm_t));
-    XYUV_ASSERT(integer_bits < 8 * sizeof(unorm_t));
+// Path for channels with bits in block ordered planes. Blocks are written straight to their tiled position rather than
+// packing the plane linearly and reordering it afterwards.
+template <typename Q>
+static void encode_channel_tiled(uint8_t *base_addr, const pack_plan &pack, const channel_plan &plan,
+                                 const surface_view<const Q> &surf, uint32_t first_line, uint32_t last_line) {
+    std::vector<uint16_t> batch(plan.n_blocks_in_line);
+    std::vector<unorm_t> codes(plan.n_blocks_in_line);
+
+    for (uint32_t line = first_line; line < last_line; line++) {
+        uint32_t y = line * plan.block_h;
+        for (const value_plan &value : plan.values) {
+            quantize_line(surf.scanline(y + value.y) + value.x, plan, value, &batch, &codes);
+
+            for (uint32_t p = value.first_part; p < value.first_part + value.n_parts; p++) {
+                const part_plan &part = plan.parts[p];
+                for_each_tiled_block(base_addr, pack.tilings[part.plane], plan, part, line, 0, plan.n_blocks_in_line,
+                    [&](uint32_t b, uint8_t *region, const uint8_t *region_end, uint64_t bit) {
+                        insert_bits(region, region_end, bit, part.bits, codes[b] >> part.shift);
+                    });
+            }
+        }
+    }
+}
 
-    unorm_t max = (0x1ull << integer_bits) - 1;
-    max <<= fractional_bits;
+// Blocks that are not stored decode as zero.
+template <typename Q>
+static void decode_channel_tiled(const uint8_t *base_addr, const pack_plan &pack, const channel_plan &plan,
+                                 const surface_view<Q> &surf, const block_window &window) {
+    std::vector<uint16_t> batch(window.last_block - window.first_block);
+    std::vector<unorm_t> codes(window.last_block - window.first_block);
+
+    for (uint32_t line = window.first_line; line < window.last_line; line++) {
+        uint32_t y = (line - window.origin_line) * plan.block_h;
+        for (const value_plan &value : plan.values) {
+            std::fill(codes.begin(), codes.end(), 0);
+
+            for (uint32_t p = value.first_part; p < value.first_part + value.n_parts; p++) {
+                const part_plan &part = plan.parts[p];
+                for_each_tiled_block(base_addr, pack.tilings[part.plane], plan, part, line,
+                                     window.first_block, window.last_block,
+                    [&](uint32_t b, const uint8_t *region, const uint8_t *region_end, uint64_t bit) {
+                        codes[b - window.first_block] |= extract_bits(region, region_end, bit, part.bits) << part.shift;
+                    });
+            }
 
-    // Convert to double
-    double dbl_val = static_cast<double>(unorm) / max;
+            dequantize_line(codes, plan, value, &batch, surf.scanline(y + value.y) + value.x);
+        }
+    }
+}
 
-    // Convert back to [0,1]
-    dbl_val -= range.first;
-    dbl_val /= (range.second - range.first);
+// Path for constant surfaces: every block holds the same codes, so each value is quantized once and only written.
+static void encode_channel_constant(uint8_t *base_addr, const pack_plan &pack, const channel_plan &plan, float sample,
+                                    uint32_t first_line, uint32_t last_line) {
+    for (const value_plan &value : plan.values) {
+        unorm_t code = to_unorm(sample, value.integer_bits, value.fractional_bits, plan.range);
+
+        for (uint32_t p = value.first_part; p < value.first_part + value.n_parts; p++) {
+            const part_plan &part = plan.parts[p];
+            unorm_t bits = code >> part.shift;
+
+            for (uint32_t line = first_line; line < last_line; line++) {
+                if (plan.tiled) {
+                    for_each_tiled_block(base_addr, pack.tilings[part.plane], plan, part, line, 0, plan.n_blocks_in_line,
+                        [&](uint32_t, uint8_t *region, const uint8_t *region_end, uint64_t bit) {
+                            insert_bits(region, region_end, bit, part.bits, bits);
+                        });
+                    continue;
+                }
 
-    return clamp(0.0f, 1.0f, static_cast<float>(dbl_val));
+                uint8_t *ptr_to_line = base_addr + plan.line_offset(part.plane, line);
+                if (plan.byte_width == 1 && part.block_stride == 8) {
+                    // Consecutive bytes, e.g. a plane of its own.
+                    memset(ptr_to_line + part.offset / 8, static_cast<int>(bits), plan.n_blocks_in_line);
+                } else if (plan.byte_width != 0) {
+                    uint8_t *dst = ptr_to_line + part.offset / 8;
+                    uint32_t dst_stride = part.block_stride / 8;
+                    for (uint32_t b = 0; b < plan.n_blocks_in_line; b++) {
+                        if (plan.byte_width == 1) {
+                            dst[b * dst_stride] = static_cast<uint8_t>(bits);
+                        } else {
+                            store_le(dst + b * dst_stride, static_cast<uint16_t>(bits));
+                        }
+                    }
+                } else {
+                    for (uint32_t b = 0; b < plan.n_blocks_in_line; b++) {
+                        insert_bits(ptr_to_line, ptr_to_line + part.line_size,
+                                    static_cast<uint64_t>(b) * part.block_stride + part.offset, part.bits, bits);
+                    }
+                }
+            }
+        }
+    }
 }
 
+template <typename Q>
+static void encode_channel(uint8_t *base_addr, const pack_plan &pack, uint32_t channel,
+                           const surface_view<const Q> &surf, uint32_t first_line, uint32_t last_line) {
+    // A channel the image does not carry leaves the (poisoned) bits untouched.
+    if (surf.empty()) {
+        return;
+    }
 
+    const channel_plan &plan = pack.channels[channel];
+    if (surf.is_constant()) {
+        encode_channel_constant(base_addr, pack, plan, quantum_traits<Q>::to_float(surf.constant_value()),
+                                first_line, last_line);
+        return;
+    }
+    if (plan.tiled) {
+        encode_channel_tiled(base_addr, pack, plan, surf, first_line, last_line);
+        return;
+    }
 
-//! \brief Buffer is seen as a continuous stream of bits from lsb of LSB to msb of MSB.
-//! Offset is in bits from least significant bit of buffer to least significant bit of value
-//! Value is sent by reference because it needs to be destroyed when writing continuation blocks.
-void write_bits(uint8_t *buffer, uint64_t offset, uint8_t bits, unorm_t &value) {
-
-    for (uint8_t i = 0; i < bits; i++) {
-        set_bit(buffer, offset + i, (value & 0x1) != 0);
-        value >>= 1;
+    switch (plan.byte_width) {
+        case 1:
+            encode_channel_aligned<uint8_t>(base_addr, plan, surf, first_line, last_line);
+            break;
+        case 2:
+            encode_channel_aligned<uint16_t>(base_addr, plan, surf, first_line, last_line);
+            break;
+        default:
+            encode_channel_bits(base_addr, plan, surf, first_line, last_line);
+            break;
     }
 }
 
-//! \brief Buffer is seen as a continuous stream of bits from lsb of LSB to msb of MSB.
-//! Offset is in bits from least significant bit of buffer to least significant bit of value
-unorm_t read_bits(unorm_t & value, const uint8_t *buffer, uint64_t offset, uint8_t bits) {
+template <typename Q>
+static void decode_channel(const uint8_t *base_addr, const pack_plan &pack, uint32_t channel,
+                           const surface_view<Q> &surf, const block_window &window) {
+    const channel_plan &plan = pack.channels[channel];
+    if (plan.tiled) {
+        decode_channel_tiled(base_addr, pack, plan, surf, window);
+        return;
+    }
 
-    for (uint8_t i = bits-1; i < bits; i--) {
-        value <<= 1;
-        if (get_bit(buffer, offset + i)) {
-            value |= 0x1;
-        }
+    switch (plan.byte_width) {
+        case 1:
+            decode_channel_aligned<uint8_t>(base_addr, plan, surf, window);
+            break;
+        case 2:
+            decode_channel_aligned<uint16_t>(base_addr, plan, surf, window);
+            break;
+        default:
+            decode_channel_bits(base_addr, plan, surf, window);
+            break;
     }
-    return value;
 }
 
-// The block iterator will iterate over each pixel in a block before moving on to the next one.
-class block_iterator {
-public:
-    block_iterator(uint16_t block_w, uint16_t block_h, surface<float> *surf) :
-            block_w(block_w), block_h(block_h),
-            block_x(0), block_y(0),
-            x(0), y(0),
-            surf(surf) { }
-
-    block_iterator(uint16_t block_w, uint16_t block_h, const surface<float> *surf) :
-            block_w(block_w), block_h(block_h),
-            block_x(0), block_y(0),
-            x(0), y(0),
-            surf(const_cast<surface<float> *>(surf)) { }
-
-    float *advance() {
-        float *ret = &(surf->at(block_x + x, block_y + y));
-        if (++x == block_w) {
-            x = 0;
-            if (++y == block_h) {
-                y = 0;
-                if ((block_x += block_w) >= surf->width()) {
-                    block_x = 0;
-                    block_y += block_h;
-                }
+template <typename Q>
+static void check_surface(const channel_plan &plan, const surface_view<const Q> &surf) {
+    if (!surf.empty() && (surf.width() != plan.width || surf.height() != plan.height)) {
+        throw std::logic_error("The dimensions of the yuv_image does not match the format.");
+    }
+}
+
+// Call fn(channel, first_line, last_line) so that every block line of every present channel is covered once.
+// Each group is processed in stripes of stripe_height block lines, packing a stripe for all channels of the group
+// before moving on to the next, so that the bytes of the stripe stay in cache. Without an executor the groups are
+// processed in order, otherwise each group is split into ranges of block lines that are processed in parallel.
+template <typename Fn>
+static void for_each_line_range(const pack_plan &plan, executor *exec, uint32_t stripe_height, const Fn &fn) {
+    auto run_group = [&](const channel_group &group, uint32_t first_line, uint32_t last_line) {
+        for (uint32_t stripe = first_line; stripe < last_line; ) {
+            uint32_t stripe_end = (last_line - stripe > stripe_height) ? stripe + stripe_height : last_line;
+
+            // Channels with fewer block lines than the group get the proportional part of the stripe.
+            for (uint32_t c : group.channels) {
+                uint64_t n_block_lines = plan.channels[c].n_block_lines;
+                fn(c, static_cast<uint32_t>(n_block_lines * stripe / group.n_block_lines),
+                   static_cast<uint32_t>(n_block_lines * stripe_end / group.n_block_lines));
             }
+            stripe = stripe_end;
+        }
+    };
+
+    if (exec == nullptr) {
+        for (const channel_group &group : plan.groups) {
+            run_group(group, 0, group.n_block_lines);
         }
-        return ret;
+        return;
     }
 
-private:
-    uint32_t block_w, block_h;
-    uint32_t block_x, block_y;
-    uint32_t x, y;
-    surface<float> *surf;
-};
+    struct task {
+        const channel_group *group;
+        uint32_t first_line, last_line;
+    };
+
+    // Aim for a few tasks per thread to even out the load.
+    uint32_t max_tasks_per_group = std::max(1u, 4 * exec->concurrency());
+
+    std::vector<task> tasks;
+    for (const channel_group &group : plan.groups) {
+        // Tasks are split in units of split_granularity block lines, the last unit may be partial.
+        uint32_t granularity = group.split_granularity;
+        uint32_t n_units = (group.n_block_lines + granularity - 1) / granularity;
+        uint32_t n_tasks = group.splittable ? std::min(n_units, max_tasks_per_group) : 1;
+        n_tasks = std::max(n_tasks, 1u);
+        for (uint32_t t = 0; t < n_tasks; t++) {
+            uint64_t first_line = static_cast<uint64_t>(n_units) * t / n_tasks * granularity;
+            uint64_t last_line = static_cast<uint64_t>(n_units) * (t + 1) / n_tasks * granularity;
+            first_line = std::min<uint64_t>(first_line, group.n_block_lines);
+            last_line = std::min<uint64_t>(last_line, group.n_block_lines);
+            tasks.push_back(task{&group, static_cast<uint32_t>(first_line), static_cast<uint32_t>(last_line)});
+        }
+    }
 
+    exec->run(static_cast<uint32_t>(tasks.size()), [&](uint32_t i) {
+        run_group(*tasks[i].group, tasks[i].first_line, tasks[i].last_line);
+    });
+}
 
+codec::codec(const xyuv::format &format)
+    : format_(format)
+    , plan_(new pack_plan(compile_pack_plan(format)))
+{ }
 
-static void encode_channel(uint8_t *base_addr, const channel_block &block, const surface<float> &surf,
-                           const std::vector<plane> &planes, const std::pair<float, float> range, bool negative_line_stride) {
-    block_iterator it(block.w, block.h, &surf);
+codec::~codec() = default;
 
-    uint32_t n_blocks_in_line = (surf.width() / block.w);
-    uint32_t n_block_lines = (surf.height() / block.h);
+codec::codec(codec &&rhs) = default;
 
-    // We need to support negative line stride.
-    std::vector<std::pair<std::ptrdiff_t , std::ptrdiff_t >> line_offsets;
-    for (const auto & plane : planes ) {
-        if (negative_line_stride) {
-            std::ptrdiff_t line_stride = -static_cast<std::ptrdiff_t>(plane.line_stride);
-            // Each line  is still left to right.
-            line_offsets.emplace_back(line_stride, plane.size + line_stride);
-        } else {
-            line_offsets.emplace_back(plane.line_stride, 0);
-        }
+codec &codec::operator=(codec &&rhs) = default;
+
+template <typename T>
+void codec::encode(const basic_yuv_image<T> &yuva_in, uint8_t *buffer) const {
+    encode<T>(make_view(yuva_in), buffer);
+}
+
+template <typename T>
+void codec::encode(const basic_yuv_image_view<const T> &yuva_in, uint8_t *buffer) const {
+    if (yuva_in.image_w != format_.image_w || yuva_in.image_h != format_.image_h
+        || !(yuva_in.siting.subsampling == format_.chroma_siting.subsampling)) {
+        throw std::logic_error("The dimensions of the yuv_image does not match the format.");
     }
 
-    // We need to preprocess the sample array to support continuation samples.
-    std::vector<sample> samples;
-    for (std::size_t i = 0; i < block.samples.size();) {
-        const xyuv::sample &sample = block.samples[i];
-        if (!sample.has_continuation) {
-            samples.push_back(sample);
-            ++i;
-        }
-        else {
-            // Create a descriptor block containing all the bits of the samples.
-            xyuv::sample sample_descriptor;
-            sample_descriptor.integer_bits = 0;
-            sample_descriptor.fractional_bits = 0;
-            sample_descriptor.has_continuation = true;
-            samples.push_back(sample_descriptor);
-            size_t descriptor_pos = samples.size() -1;
-
-            // Create a stack of all the bits in the sample.
-            // We need to reverse the order of the samples to encode them correctly.
-            std::vector<const xyuv::sample*> bit_stack;
-            do {
-                // Update descriptor
-                samples[descriptor_pos].integer_bits += block.samples[i].integer_bits;
-                samples[descriptor_pos].fractional_bits += block.samples[i].fractional_bits;
-                bit_stack.push_back(&(block.samples[i]));
-            } while(block.samples[i++].has_continuation);
-
-            for (auto rit = bit_stack.rbegin(); rit != bit_stack.rend(); ++rit) {
-                samples.push_back(*(*rit));
-                samples.back().has_continuation = true;
-            }
+    const channel_plan &a_plan = plan_->channels[channel::A];
+
+    std::array<surface_view<const T>, 4> surfaces = {{
+            yuva_in.y_plane, yuva_in.u_plane, yuva_in.v_plane, yuva_in.a_plane
+    }};
 
-            samples.back().has_continuation = false;
+    // Alpha is special, if it is not present it defaults to one.
+    surface<T> opaque;
+    if (a_plan.present && yuva_in.a_plane.empty()) {
+        opaque = surface<T>::constant(yuva_in.image_w, yuva_in.image_h, quantum_traits<T>::from_float(1.0f));
+        surfaces[channel::A] = opaque.view();
+    }
+
+    for (uint32_t c = 0; c < surfaces.size(); c++) {
+        if (plan_->channels[c].present) {
+            check_surface(plan_->channels[c], surfaces[c]);
         }
     }
 
-    // Finally iterate over the image
-    for (uint32_t line = 0; line < n_block_lines; line++) {
-        // Precompute interleaved lines
-        uint32_t interleaved_line[3] = {
-                get_line(line, static_cast<interleave_pattern>(0), n_block_lines),
-                get_line(line, static_cast<interleave_pattern>(1), n_block_lines),
-                get_line(line, static_cast<interleave_pattern>(2), n_block_lines),
-        };
-        for (uint32_t b = 0; b < n_blocks_in_line; b++) {
-            for (std::size_t s = 0; s < samples.size(); ) {
-                uint8_t integer_bits = samples[s].integer_bits;
-                uint8_t fractional_bits = samples[s].fractional_bits;
-
-                float value = *it.advance();
-                unorm_t unorm = to_unorm(value, integer_bits, fractional_bits, range);
-
-                // If we hit a continuation block here, it means that we have the
-                // Total bits descriptor and should skip it for the purpose of actual storing.
-                if (samples[s].has_continuation) {
-                    s++;
-                }
+    for_each_line_range(*plan_, executor_, stripe_height(), [&](uint32_t c, uint32_t first_line, uint32_t last_line) {
+        encode_channel(buffer, *plan_, c, surfaces[c], first_line, last_line);
+    });
+}
+
+// Get the subsampling factors of a channel.
+static std::pair<uint32_t, uint32_t> get_channel_subsampling(uint32_t channel, const subsampling &subsampling) {
+    if (channel == channel::U || channel == channel::V) {
+        return std::make_pair<uint32_t, uint32_t>(subsampling.macro_px_w, subsampling.macro_px_h);
+    }
+    return std::make_pair(1u, 1u);
+}
+
+// Check whether yuva has the channels of plan, and the given dimensions and siting.
+template <typename T>
+static bool layout_matches(const pack_plan &plan, const chroma_siting &siting, uint32_t image_w, uint32_t image_h,
+                           const basic_yuv_image_view<T> &yuva) {
+    std::array<const surface_view<T> *, 4> surfaces = {{
+            &yuva.y_plane, &yuva.u_plane, &yuva.v_plane, &yuva.a_plane
+    }};
+
+    if (yuva.image_w != image_w || yuva.image_h != image_h || !(yuva.siting == siting)) {
+        return false;
+    }
 
-                do {
-                    const xyuv::sample &sample = samples[s];
-
-                    uint8_t * ptr_to_line =
-                            // Start with offset to frame
-                            base_addr +
-                            // Add offset to lowest byte in plane.
-                            planes[sample.plane].base_offset +
-                            // Add the size of the plane if applicable.
-                            line_offsets[sample.plane].second +
-                            // Add offset to current line.
-                            interleaved_line[static_cast<uint32_t>(planes[sample.plane].interleave_mode)] * line_offsets[sample.plane].first;
-
-                    // Read bits written bits from LSb fractional to MSb integer bit.
-                    write_bits( ptr_to_line,
-                               b * planes[sample.plane].block_stride + sample.offset,
-                               sample.integer_bits + sample.fractional_bits, unorm);
-
-                } while (samples[s++].has_continuation);
+    for (uint32_t c = 0; c < surfaces.size(); c++) {
+        const surface_view<T> &surf = *surfaces[c];
+        if (!plan.channels[c].present) {
+            if (!surf.empty()) {
+                return false;
             }
+            continue;
+        }
+
+        auto factors = get_channel_subsampling(c, siting.subsampling);
+        if (surf.empty() || surf.width() != (image_w + factors.first - 1) / factors.first
+            || surf.height() != (image_h + factors.second - 1) / factors.second) {
+            return false;
         }
     }
+    return true;
 }
 
-static xyuv::frame internal_encode_frame(const yuv_image &yuva_in, const xyuv::format &format) {
+template <typename T>
+bool codec::matches(const basic_yuv_image<T> &yuva) const {
+    return layout_matches(*plan_, format_.chroma_siting, format_.image_w, format_.image_h, make_view(yuva));
+}
 
-    // Determine the byte size of each plane.
-    bool has_y = !format.channel_blocks[channel::Y].samples.empty();
-    bool has_u = !format.channel_blocks[channel::U].samples.empty();
-    bool has_v = !format.channel_blocks[channel::V].samples.empty();
-    bool has_a = !format.channel_blocks[channel::A].samples.empty();
+// Check whether every value of the channel decodes to 1.0, unpacking one block line at a time.
+static bool channel_is_opaque(const uint8_t *buffer, const pack_plan &pack, uint32_t channel) {
+    const channel_plan &plan = pack.channels[channel];
+    surface<float> blocks(plan.n_blocks_in_line * plan.block_w, plan.block_h);
+    for (uint32_t line = 0; line < plan.n_block_lines; line++) {
+        block_window window = { line, line + 1, 0, plan.n_blocks_in_line, line };
+        decode_channel(buffer, pack, channel, blocks.mutable_view(), window);
+        for (uint32_t y = 0; y < blocks.height(); y++) {
+            const float *row = blocks.scanline(y);
+            if (std::any_of(row, row + blocks.width(), [](float value) { return value != 1.0f; })) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
 
-    std::unique_ptr<uint8_t[]> buffer = std::unique_ptr<uint8_t[]>(new uint8_t[format.size]);
-    // Fill buffer with poison values to make padding "undefined" yet deterministic.
-    poison_buffer(buffer.get(), format.size);
+// Decode every block line of the channels into planes, channels with an empty plane are skipped.
+template <typename T>
+static void decode_planes(const uint8_t *buffer, const pack_plan &pack, executor *exec, uint32_t stripe_height,
+                          const std::array<surface_view<T>, 4> &planes) {
+    for_each_line_range(pack, exec, stripe_height, [&](uint32_t c, uint32_t first_line, uint32_t last_line) {
+        if (planes[c].empty()) {
+            return;
+        }
+        block_window window = { first_line, last_line, 0, pack.channels[c].n_blocks_in_line, 0 };
+        decode_channel(buffer, pack, c, planes[c], window);
+    });
+}
 
-    bool has_negative_line_stride = (format.origin == image_origin::LOWER_LEFT);
-
-    if (has_y)
-        encode_channel(
-                buffer.get(),
-                format.channel_blocks[channel::Y],
-                yuva_in.y_plane,
-                format.planes,
-                format.conversion_matrix.y_packed_range,
-                has_negative_line_stride
-        );
-    if (has_u)
-        encode_channel(
-                buffer.get(),
-                format.channel_blocks[channel::U],
-                yuva_in.u_plane,
-                format.planes,
-                format.conversion_matrix.u_packed_range,
-                has_negative_line_stride
-        );
-    if (has_v)
-        encode_channel(
-                buffer.get(),
-                format.channel_blocks[channel::V],
-                yuva_in.v_plane,
-                format.planes,
-                format.conversion_matrix.v_packed_range,
-                has_negative_line_stride
-        );
-
-    if (has_a) {
-        const surface<pixel_quantum> *surf = &(yuva_in.a_plane);
-
-        // Alpha is special, if it is not present, we need to
-        // create a surface and default it to one.
-        std::unique_ptr<surface<pixel_quantum>> tempsurf;
-        if (yuva_in.a_plane.empty()) {
-            tempsurf.reset(new surface<pixel_quantum>(yuva_in.image_w, yuva_in.image_h));
-            tempsurf->fill(1.0f);
-            surf = tempsurf.get();
+// Create a w x h image with the channels of plan to decode to, see codec::set_buffer_pool() and
+// codec::set_contiguous_planes(). alpha_written tells whether the alpha plane will be decoded to.
+template <typename T>
+static basic_yuv_image<T> create_decode_target(uint32_t w, uint32_t h, const chroma_siting &siting,
+                                               const pack_plan &plan, buffer_pool *pool, bool contiguous,
+                                               bool alpha_written) {
+    bool has_Y = plan.channels[channel::Y].present;
+    bool has_U = plan.channels[channel::U].present;
+    bool has_V = plan.channels[channel::V].present;
+    bool has_A = plan.channels[channel::A].present;
+
+    if (contiguous) {
+        // The luma and chroma samples are left uninitialised, as decoding overwrites them.
+        basic_yuv_image<T> result =
+                create_decode_yuv_image<T>(w, h, siting, pool, has_Y, has_U, has_V, has_A, alpha_written);
+
+        // The samples of partial blocks at the right and bottom edges are not decoded, they must read as 0 as in an
+        // image from create_yuv_image().
+        std::array<surface<T> *, 3> chroma_and_luma = {{ &result.y_plane, &result.u_plane, &result.v_plane }};
+        for (uint32_t c = 0; c < chroma_and_luma.size(); c++) {
+            const channel_plan &channel = plan.channels[c];
+            if (channel.present && (channel.width % channel.block_w != 0 || channel.height % channel.block_h != 0)) {
+                chroma_and_luma[c]->fill(T());
+            }
         }
+        return result;
+    }
+    return create_yuv_image<T>(w, h, siting, pool ? pool_allocator<T>(*pool) : pool_allocator<T>(),
+                               has_Y, has_U, has_V, has_A);
+}
 
-        encode_channel(
-                buffer.get(),
-                format.channel_blocks[channel::A],
-                *surf,
-                format.planes,
-                std::make_pair<float, float>(0.0f, 1.0f),
-                has_negative_line_stride
-        );
+template <typename T>
+void codec::decode(const uint8_t *buffer, basic_yuv_image<T> *yuva_out) const {
+    const channel_plan &a_plan = plan_->channels[channel::A];
 
+    // An opaque alpha channel becomes a constant plane, all other surfaces are written to (possibly in parallel).
+    bool opaque = detect_opaque_alpha_ && a_plan.present && channel_is_opaque(buffer, *plan_, channel::A);
 
+    // Reuse the storage of yuva_out if it already has the right layout.
+    if (!matches(*yuva_out)) {
+        *yuva_out = create_decode_target<T>(format_.image_w, format_.image_h, format_.chroma_siting, *plan_,
+                                            buffer_pool_, contiguous_planes_, a_plan.present && !opaque);
     }
 
-    for (auto & plane : format.planes ) {
-        reorder_transform(buffer.get(), plane );
+    if (opaque) {
+        yuva_out->a_plane = surface<T>::constant(a_plan.width, a_plan.height, quantum_traits<T>::from_float(1.0f),
+                                                 yuva_out->a_plane.get_allocator());
     }
 
-    // Init frame info.
-    xyuv::frame frame;
-    frame.data = std::move(buffer);
-    frame.format = format;
-
-    return frame;
+    std::array<surface_view<T>, 4> planes = {{
+            yuva_out->y_plane.mutable_view(), yuva_out->u_plane.mutable_view(), yuva_out->v_plane.mutable_view(),
+            opaque ? surface_view<T>() : yuva_out->a_plane.mutable_view()
+    }};
+    decode_planes(buffer, *plan_, executor_, stripe_height(), planes);
 }
 
-static void decode_channel(const uint8_t *base_addr, const channel_block &block, surface<float> *surf,
-                           const std::vector<plane> &planes, const std::pair<float, float> range, bool negative_line_stride) {
-    block_iterator it(block.w, block.h, surf);
-
-    uint32_t n_blocks_in_line = (surf->width() / block.w);
-    uint32_t n_block_lines = (surf->height() / block.h);
+template <typename T>
+void codec::decode(const uint8_t *buffer, const basic_yuv_image_view<T> &yuva_out) const {
+    if (!layout_matches(*plan_, format_.chroma_siting, format_.image_w, format_.image_h, yuva_out)) {
+        throw std::logic_error("The dimensions of the yuv_image does not match the format.");
+    }
 
-    // We need to support negative line stride.
-    std::vector<std::pair<std::ptrdiff_t , std::ptrdiff_t >> line_offsets;
-    for (const auto & plane : planes ) {
-        if (negative_line_stride) {
-            std::ptrdiff_t line_stride = -static_cast<std::ptrdiff_t>(plane.line_stride);
-            // Each line  is still left to right.
-            line_offsets.emplace_back(line_stride, plane.size + line_stride);
-        } else {
-            line_offsets.emplace_back(plane.line_stride, 0);
+    std::array<surface_view<T>, 4> planes = {{
+            yuva_out.y_plane, yuva_out.u_plane, yuva_out.v_plane, yuva_out.a_plane
+    }};
+    for (const surface_view<T> &plane : planes) {
+        if (plane.is_constant()) {
+            throw std::logic_error("Cannot decode to a constant surface.");
         }
     }
+    decode_planes(buffer, *plan_, executor_, stripe_height(), planes);
+}
 
-    // We need to preprocess the sample array to support continuation samples.
-    std::vector<sample> samples;
-    for (std::size_t i = 0; i < block.samples.size(); ) {
-        const xyuv::sample &sample = block.samples[i];
-        if (!sample.has_continuation) {
-            samples.push_back(sample);
-            i++;
+template <typename T>
+void codec::decode_region(const uint8_t *buffer, uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                          basic_yuv_image<T> *yuva_out) const {
+    const subsampling &subsampling = format_.chroma_siting.subsampling;
+    if (w == 0 || h == 0 || x >= format_.image_w || w > format_.image_w - x
+        || y >= format_.image_h || h > format_.image_h - y) {
+        throw std::logic_error("The region must be non-empty and inside the frame.");
+    }
+    if ((x % subsampling.macro_px_w) != 0 || (y % subsampling.macro_px_h) != 0) {
+        throw std::logic_error("The region must start on a macro pixel of the chroma subsampling.");
+    }
+
+    if (!layout_matches(*plan_, format_.chroma_siting, w, h, make_view(*yuva_out))) {
+        *yuva_out = create_decode_target<T>(w, h, format_.chroma_siting, *plan_, buffer_pool_, contiguous_planes_,
+                                            plan_->channels[channel::A].present);
+    }
+
+    std::array<surface<T> *, 4> surfaces = {{
+            &yuva_out->y_plane, &yuva_out->u_plane, &yuva_out->v_plane, &yuva_out->a_plane
+    }};
+
+    for (uint32_t c = 0; c < surfaces.size(); c++) {
+        const channel_plan &plan = plan_->channels[c];
+        if (!plan.present) {
+            continue;
         }
-        else {
-            // Create a descriptor block containing all the bits of the samples.
-            xyuv::sample sample_descriptor;
-            sample_descriptor.integer_bits = 0;
-            sample_descriptor.fractional_bits = 0;
-            sample_descriptor.has_continuation = true;
-            samples.push_back(sample_descriptor);
-            size_t descriptor_pos = samples.size() -1;
-            do {
-                // Update descriptor
-                samples[descriptor_pos].integer_bits += block.samples[i].integer_bits;
-                samples[descriptor_pos].fractional_bits += block.samples[i].fractional_bits;
-                samples.push_back(block.samples[i]);
-            } while(block.samples[i++].has_continuation);
+
+        // The rectangle in the coordinates of the channel.
+        surface_view<T> dst = surfaces[c]->mutable_view();
+        auto factors = get_channel_subsampling(c, subsampling);
+        uint32_t cx = x / factors.first, cy = y / factors.second;
+        uint32_t cw = dst.width(), ch = dst.height();
+
+        // Pixels not stored in any block decode as in decode().
+        if (cx + cw > plan.n_blocks_in_line * plan.block_w || cy + ch > plan.n_block_lines * plan.block_h) {
+            surfaces[c]->fill(quantum_traits<T>::from_float(c == channel::A ? 1.0f : 0.0f));
         }
-    }
 
-    for (uint32_t line = 0; line < n_block_lines; line++) {
-        for (uint32_t b = 0; b < n_blocks_in_line; b++) {
-            for (std::size_t s = 0; s < samples.size(); ) {
+        block_window window;
+        window.first_block = cx / plan.block_w;
+        window.last_block = std::min(plan.n_blocks_in_line, (cx + cw + plan.block_w - 1) / plan.block_w);
+        window.first_line = cy / plan.block_h;
+        window.last_line = std::min(plan.n_block_lines, (cy + ch + plan.block_h - 1) / plan.block_h);
+        window.origin_line = window.first_line;
+        if (window.first_block >= window.last_block || window.first_line >= window.last_line) {
+            continue;
+        }
 
+        uint32_t window_w = (window.last_block - window.first_block) * plan.block_w;
+        uint32_t window_h = (window.last_line - window.first_line) * plan.block_h;
+        uint32_t offset_x = cx - window.first_block * plan.block_w;
+        uint32_t offset_y = cy - window.first_line * plan.block_h;
 
-                uint8_t integer_bits = samples[s].integer_bits;
-                uint8_t fractional_bits = samples[s].fractional_bits;
+        // Unpack straight into the result when the blocks line up with it, otherwise go through the whole blocks.
+        if (offset_x == 0 && offset_y == 0 && window_w <= cw && window_h <= ch) {
+            decode_channel(buffer, *plan_, c, dst, window);
+            continue;
+        }
 
+        surface<T> blocks(window_w, window_h);
+        decode_channel(buffer, *plan_, c, blocks.mutable_view(), window);
 
-                // If we hit a continuation block here, it means that we have the
-                // Total bits descriptor and should skip it for the purpose of actual loading.
-                if (samples[s].has_continuation) {
-                    s++;
-                }
+        uint32_t copy_w = std::min(cw, window_w - offset_x);
+        uint32_t copy_h = std::min(ch, window_h - offset_y);
+        for (uint32_t row = 0; row < copy_h; row++) {
+            const T *src = blocks.scanline(offset_y + row) + offset_x;
+            std::copy(src, src + copy_w, dst.scanline(row));
+        }
+    }
+}
 
-                unorm_t unorm = 0;
-                do {
-                    const xyuv::sample &sample = samples[s];
-
-                    const uint8_t * ptr_to_line =
-                            // Start with offset to frame
-                            base_addr +
-                            // Add offset to lowest byte in plane.
-                            planes[sample.plane].base_offset +
-                            // Add the size of the plane if applicable.
-                            line_offsets[sample.plane].second +
-                            // Add offset to current line.
-                            get_line(line, planes[sample.plane].interleave_mode, n_block_lines) * line_offsets[sample.plane].first;
-
-                    // Read bits reads bits from MSb integer to LSb fractional bit.
-                    read_bits( unorm,
-                               ptr_to_line,
-                               b * planes[sample.plane].block_stride + sample.offset,
-                               sample.integer_bits + sample.fractional_bits);
-
-                } while (samples[s++].has_continuation);
-
-                float *value = it.advance();
-                *value = from_unorm(unorm, integer_bits, fractional_bits, range);
-            }
+void codec::decode_bands(const uint8_t *buffer, uint32_t band_height, const band_callback &callback) const {
+    // A band must consist of whole block lines of every channel.
+    const subsampling &subsampling = format_.chroma_siting.subsampling;
+    uint32_t granularity = subsampling.macro_px_h;
+    for (uint32_t c = 0; c < plan_->channels.size(); c++) {
+        if (plan_->channels[c].present) {
+            granularity = lcm(granularity, plan_->channels[c].block_h * get_channel_subsampling(c, subsampling).second);
         }
     }
+    band_height = next_multiple(std::max(band_height, 1u), granularity);
+
+    // The same image is reused for every band, only the last one may need to be resized.
+    yuv_image band;
+    for (uint32_t first_row = 0; first_row < format_.image_h; first_row += band_height) {
+        uint32_t n_rows = std::min(band_height, format_.image_h - first_row);
+        decode_region(buffer, 0, first_row, format_.image_w, n_rows, &band);
+        callback(first_row, band);
+    }
 }
 
+void codec::set_executor(xyuv::executor *exec) {
+    own_executor_.reset();
+    executor_ = exec;
+}
 
-yuv_image decode_frame(const xyuv::frame &frame_in) {
+void codec::set_buffer_pool(xyuv::buffer_pool *pool) {
+    buffer_pool_ = pool;
+}
 
-    // Determine the size of each plane.
-    bool has_y = !frame_in.format.channel_blocks[channel::Y].samples.empty();
-    bool has_u = !frame_in.format.channel_blocks[channel::U].samples.empty();
-    bool has_v = !frame_in.format.channel_blocks[channel::V].samples.empty();
-    bool has_a = !frame_in.format.channel_blocks[channel::A].samples.empty();
-
-    yuv_image yuva_out = create_yuv_image(
-            frame_in.format.image_w,
-            frame_in.format.image_h,
-            frame_in.format.chroma_siting,
-            has_y,
-            has_u,
-            has_v,
-            has_a
-    );
-
-    bool has_negative_line_stride = (frame_in.format.origin == image_origin::LOWER_LEFT);
-
-    const uint8_t * raw_data = frame_in.data.get();
-
-    std::unique_ptr<uint8_t[]> tmp_buffer;
-    if (needs_reorder(frame_in.format)) {
-        // Todo: If needed optimize this for memory.
-        // At some point we will have allocated 2x frame + 1 plane.
-        tmp_buffer.reset(new uint8_t[frame_in.format.size]);
-        memcpy(tmp_buffer.get(), raw_data, frame_in.format.size);
-
-        // Use the copy instead.
-        raw_data = tmp_buffer.get();
-
-        for (auto & plane : frame_in.format.planes) {
-            reorder_inverse(tmp_buffer.get(), plane);
-        }
+void codec::set_contiguous_planes(bool enable) {
+    contiguous_planes_ = enable;
+}
+
+void codec::set_detect_opaque_alpha(bool enable) {
+    detect_opaque_alpha_ = enable;
+}
+
+void codec::set_stripe_height(uint32_t block_lines) {
+    stripe_height_ = block_lines;
+}
+
+uint32_t codec::stripe_height() const {
+    return stripe_height_ != 0 ? stripe_height_ : plan_->stripe_height;
+}
+
+void codec::set_thread_count(uint32_t n_threads) {
+    if (n_threads == 1) {
+        set_executor(nullptr);
+        return;
     }
+    own_executor_.reset(new thread_executor(n_threads));
+    executor_ = own_executor_.get();
+}
+
+static xyuv::frame internal_encode_frame(const yuv_image &yuva_in, const xyuv::format &format, executor *exec,
+                                        buffer_pool *pool) {
+    frame_buffer buffer = pool ? pool->acquire(format.size) : frame_buffer(new uint8_t[format.size]);
+    // Fill buffer with poison values to make padding "undefined" yet deterministic.
+    poison_buffer(buffer.get(), format.size);
+
+    xyuv::codec codec(format);
+    codec.set_executor(exec);
+    codec.encode(yuva_in, buffer.get());
 
-    if (has_y)
-        decode_channel(
-                raw_data,
-                frame_in.format.channel_blocks[channel::Y],
-                &(yuva_out.y_plane),
-                frame_in.format.planes,
-                frame_in.format.conversion_matrix.y_packed_range,
-                has_negative_line_stride
-        );
-    if (has_u)
-        decode_channel(
-                raw_data,
-                frame_in.format.channel_blocks[channel::U],
-                &(yuva_out.u_plane),
-                frame_in.format.planes,
-                frame_in.format.conversion_matrix.u_packed_range,
-                has_negative_line_stride
-        );
-    if (has_v)
-        decode_channel(
-                raw_data,
-                frame_in.format.channel_blocks[channel::V],
-                &(yuva_out.v_plane),
-                frame_in.format.planes,
-                frame_in.format.conversion_matrix.v_packed_range,
-                has_negative_line_stride
-        );
-    if (has_a)
-        decode_channel(
-                raw_data,
-                frame_in.format.channel_blocks[channel::A],
-                &(yuva_out.a_plane),
-                frame_in.format.planes,
-                std::make_pair<float, float>(0.0f, 1.0f),
-                has_negative_line_stride
-        );
+    // Init frame info.
+    xyuv::frame frame;
+    frame.data = std::move(buffer);
+    frame.format = format;
 
+    return frame;
+}
 
+static yuv_image internal_decode_frame(const xyuv::frame &frame_in, executor *exec, buffer_pool *pool) {
+    xyuv::codec codec(frame_in.format);
+    codec.set_executor(exec);
+    codec.set_buffer_pool(pool);
+    codec.set_contiguous_planes(true);
 
+    yuv_image yuva_out;
+    codec.decode(frame_in.data.get(), &yuva_out);
     return yuva_out;
 }
 
-// This is the entry_point for the encode function, and will make sure the result
-// sane.
-xyuv::frame encode_frame(const xyuv::yuv_image &yuva_in, const xyuv::format &format) {
+yuv_image decode_frame(const xyuv::frame &frame_in) {
+    return internal_decode_frame(frame_in, nullptr, nullptr);
+}
+
+yuv_image decode_frame(const xyuv::frame &frame_in, executor &exec) {
+    return internal_decode_frame(frame_in, &exec, nullptr);
+}
+
+yuv_image decode_frame(const xyuv::frame &frame_in, buffer_pool &pool) {
+    return internal_decode_frame(frame_in, nullptr, &pool);
+}
+
+// Convert yuva_in to the dimensions and chroma siting of format, then encode it. Every conversion consumes the image
+// produced by the previous one, and yuva_in itself when it is an rvalue, so untouched planes are moved rather than
+// copied.
+template <typename Image>
+static xyuv::frame checked_encode_frame(Image &&yuva_in, const xyuv::format &format, executor *exec,
+                                        buffer_pool *pool) {
     bool dimensions_match = yuva_in.image_w == format.image_w && yuva_in.image_h == format.image_h;
 
     // Short path.
     if (dimensions_match && yuva_in.siting == format.chroma_siting) {
-        return internal_encode_frame(yuva_in, format);
+        return internal_encode_frame(yuva_in, format, exec, pool);
     }
 
     // Otherwise we will need to do some conversion.
-    const yuv_image *image = &yuva_in;
-    yuv_image temp;
-
     if (!dimensions_match) {
-        if (!is_444(image->siting.subsampling)) {
-            temp = up_sample(*image);
-            image = &temp;
-        }
-        temp = scale_yuv_image(*image, format.image_w, format.image_h);
-        image = &temp;
+        // Subsampled planes are scaled at their own resolution.
+        return checked_encode_frame(scale_image(std::forward<Image>(yuva_in), format.image_w, format.image_h,
+                                                scaling_filter::NEAREST, exec), format, exec, pool);
     }
 
-    if (!(image->siting == format.chroma_siting)) {
-        if (image->siting.subsampling.macro_px_w > 1 ||
-            image->siting.subsampling.macro_px_h > 1) {
-            temp = up_sample(*image);
-            image = &temp;
-        }
+    if (yuva_in.siting.subsampling == format.chroma_siting.subsampling) {
+        // Only the sample points differ, resample the chroma planes without leaving the subsampled resolution.
+        return internal_encode_frame(resite_chroma(std::forward<Image>(yuva_in), format.chroma_siting), format, exec,
+                                     pool);
+    }
 
-        // At this point *image is 444
-        if (format.chroma_siting.subsampling.macro_px_w > 1 ||
-            format.chroma_siting.subsampling.macro_px_h > 1) {
-            temp = down_sample(*image, format.chroma_siting);
-            image = &temp;
+    if (yuva_in.siting.subsampling.macro_px_w > 1 ||
+        yuva_in.siting.subsampling.macro_px_h > 1) {
+        yuv_image full = up_sample(std::forward<Image>(yuva_in));
+        if (is_444(format.chroma_siting.subsampling)) {
+            return internal_encode_frame(full, format, exec, pool);
         }
+        return internal_encode_frame(down_sample(std::move(full), format.chroma_siting), format, exec, pool);
     }
 
-    return internal_encode_frame(*image, format);
+    // At this point yuva_in is 444
+    return internal_encode_frame(down_sample(std::forward<Image>(yuva_in), format.chroma_siting), format, exec,
+                                 pool);
+}
+
+xyuv::frame encode_frame(const xyuv::yuv_image &yuva_in, const xyuv::format &format) {
+    return checked_encode_frame(yuva_in, format, nullptr, nullptr);
+}
+
+xyuv::frame encode_frame(const xyuv::yuv_image &yuva_in, const xyuv::format &format, executor &exec) {
+    return checked_encode_frame(yuva_in, format, &exec, nullptr);
+}
+
+xyuv::frame encode_frame(xyuv::yuv_image &&yuva_in, const xyuv::format &format) {
+    return checked_encode_frame(std::move(yuva_in), format, nullptr, nullptr);
 }
 
+xyuv::frame encode_frame(xyuv::yuv_image &&yuva_in, const xyuv::format &format, executor &exec) {
+    return checked_encode_frame(std::move(yuva_in), format, &exec, nullptr);
+}
+
+xyuv::frame encode_frame(const xyuv::yuv_image &yuva_in, const xyuv::format &format, buffer_pool &pool) {
+    return checked_encode_frame(yuva_in, format, nullptr, &pool);
+}
+
+template <typename T>
+static void internal_encode_frame_into(const basic_yuv_image<T> &yuva_in, const xyuv::format &format,
+                                       uint8_t *dst, uint64_t dst_size, executor *exec) {
+    if (dst == nullptr || dst_size < format.size) {
+        throw std::logic_error("The destination buffer is smaller than the frame size of the format.");
+    }
+
+    xyuv::codec codec(format);
+    codec.set_executor(exec);
+    codec.encode(yuva_in, dst);
+}
+
+template <typename T>
+void encode_frame_into(const basic_yuv_image<T> &yuva_in, const xyuv::format &format, uint8_t *dst,
+                       uint64_t dst_size) {
+    internal_encode_frame_into(yuva_in, format, dst, dst_size, nullptr);
+}
+
+template <typename T>
+void encode_frame_into(const basic_yuv_image<T> &yuva_in, const xyuv::format &format, uint8_t *dst,
+                       uint64_t dst_size, executor &exec) {
+    internal_encode_frame_into(yuva_in, format, dst, dst_size, &exec);
+}
+
+template <typename T>
+static void internal_decode_frame_into(const xyuv::frame &frame_in, basic_yuv_image<T> *yuva_out, executor *exec) {
+    xyuv::codec codec(frame_in.format);
+    if (!codec.matches(*yuva_out)) {
+        throw std::logic_error("The dimensions of the yuv_image does not match the format.");
+    }
+
+    codec.set_executor(exec);
+    codec.decode(frame_in.data.get(), yuva_out);
+}
+
+template <typename T>
+void decode_frame_into(const xyuv::frame &frame_in, basic_yuv_image<T> *yuva_out) {
+    internal_decode_frame_into(frame_in, yuva_out, nullptr);
+}
+
+template <typename T>
+void decode_frame_into(const xyuv::frame &frame_in, basic_yuv_image<T> *yuva_out, executor &exec) {
+    internal_decode_frame_into(frame_in, yuva_out, &exec);
+}
+
+void decode_frame_bands(const xyuv::frame &frame_in, uint32_t band_height, const band_callback &callback) {
+    xyuv::codec codec(frame_in.format);
+    codec.decode_bands(frame_in.data.get(), band_height, callback);
+}
+
+yuv_image decode_frame_region(const xyuv::frame &frame_in, uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+    xyuv::codec codec(frame_in.format);
+    codec.set_contiguous_planes(true);
+
+    yuv_image yuva_out;
+    codec.decode_region(frame_in.data.get(), x, y, w, h, &yuva_out);
+    return yuva_out;
+}
+
+// The sample storage types supported by the en-/decoders, see quantum_traits.
+#define XYUV_INSTANTIATE_CODEC(T) \
+    template void codec::encode<T>(const basic_yuv_image<T> &, uint8_t *) const; \
+    template void codec::encode<T>(const basic_yuv_image_view<const T> &, uint8_t *) const; \
+    template void codec::decode<T>(const uint8_t *, basic_yuv_image<T> *) const; \
+    template void codec::decode<T>(const uint8_t *, const basic_yuv_image_view<T> &) const; \
+    template void codec::decode_region<T>(const uint8_t *, uint32_t, uint32_t, uint32_t, uint32_t, \
+                                          basic_yuv_image<T> *) const; \
+    template bool codec::matches<T>(const basic_yuv_image<T> &) const; \
+    template void encode_frame_into<T>(const basic_yuv_image<T> &, const xyuv::format &, uint8_t *, uint64_t); \
+    template void encode_frame_into<T>(const basic_yuv_image<T> &, const xyuv::format &, uint8_t *, uint64_t, \
+                                       executor &); \
+    template void decode_frame_into<T>(const xyuv::frame &, basic_yuv_image<T> *); \
+    template void decode_frame_into<T>(const xyuv::frame &, basic_yuv_image<T> *, executor &);
+
+XYUV_INSTANTIATE_CODEC(float)
+XYUV_INSTANTIATE_CODEC(half)
+XYUV_INSTANTIATE_CODEC(uint16_t)
+
+#undef XYUV_INSTANTIATE_CODEC
+
 } // namespace xyuv
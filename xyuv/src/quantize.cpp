@@ -0,0 +1,486 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "quantize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define XYUV_HAVE_SSE2 1
+#   include <emmintrin.h>
+#   if defined(__GNUC__)
+        // AVX2 kernels are compiled with function level target attributes and selected at runtime.
+#       define XYUV_HAVE_AVX2 1
+#       define XYUV_TARGET_AVX2 __attribute__((target("avx2")))
+#       include <immintrin.h>
+#   endif
+#endif
+
+/*
+ * The vector kernels mirror the scalar reference operation by operation in double precision, so they
+ * are bit exact as long as no multiply-add is fused (the avx2 target does not enable fma).
+ * Truncation is used in place of floor, which is only equal for non-negative values, hence to_unorm
+ * falls back to the scalar code for ranges that could produce negative intermediates.
+ */
+
+namespace xyuv {
+
+static unorm_t unorm_max(uint8_t integer_bits, uint8_t fractional_bits) {
+    unorm_t max = (0x1ull << integer_bits) - 1;
+    return max << fractional_bits;
+}
+
+static void to_unorm_scalar(const pixel_quantum *src, std::size_t src_stride, std::size_t n,
+                            uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                            uint16_t *dst) {
+    for (std::size_t i = 0; i < n; i++) {
+        dst[i] = static_cast<uint16_t>(to_unorm(src[i * src_stride], integer_bits, fractional_bits, range));
+    }
+}
+
+static void from_unorm_scalar(const uint16_t *src, std::size_t n,
+                              uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                              pixel_quantum *dst, std::size_t dst_stride) {
+    for (std::size_t i = 0; i < n; i++) {
+        dst[i * dst_stride] = from_unorm(src[i], integer_bits, fractional_bits, range);
+    }
+}
+
+#ifdef XYUV_HAVE_SSE2
+
+static inline __m128 load_4(const pixel_quantum *src, std::size_t stride) {
+    if (stride == 1) {
+        return _mm_loadu_ps(src);
+    }
+    return _mm_set_ps(src[3 * stride], src[2 * stride], src[stride], src[0]);
+}
+
+static inline void store_4(pixel_quantum *dst, std::size_t stride, __m128 val) {
+    if (stride == 1) {
+        _mm_storeu_ps(dst, val);
+        return;
+    }
+    float tmp[4];
+    _mm_storeu_ps(tmp, val);
+    for (std::size_t i = 0; i < 4; i++) {
+        dst[i * stride] = tmp[i];
+    }
+}
+
+static void to_unorm_sse2(const pixel_quantum *src, std::size_t src_stride, std::size_t n,
+                          uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                          uint16_t *dst) {
+    const __m128d scale = _mm_set1_pd(static_cast<float>(range.second - range.first));
+    const __m128d first = _mm_set1_pd(range.first);
+    const __m128d max = _mm_set1_pd(static_cast<double>(unorm_max(integer_bits, fractional_bits)));
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128i bias = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i codes[2];
+        for (int h = 0; h < 2; h++) {
+            __m128 val = load_4(src + (i + 4 * h) * src_stride, src_stride);
+            __m128d lo = _mm_cvtps_pd(val);
+            __m128d hi = _mm_cvtps_pd(_mm_movehl_ps(val, val));
+
+            lo = _mm_add_pd(_mm_mul_pd(_mm_add_pd(_mm_mul_pd(lo, scale), first), max), half);
+            hi = _mm_add_pd(_mm_mul_pd(_mm_add_pd(_mm_mul_pd(hi, scale), first), max), half);
+
+            codes[h] = _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+        }
+
+        // SSE2 only has a signed saturating pack, so shift the unsigned codes into the signed range and back.
+        __m128i packed = _mm_packs_epi32(_mm_sub_epi32(codes[0], bias), _mm_sub_epi32(codes[1], bias));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_xor_si128(packed, bias16));
+    }
+
+    to_unorm_scalar(src + i * src_stride, src_stride, n - i, integer_bits, fractional_bits, range, dst + i);
+}
+
+static void from_unorm_sse2(const uint16_t *src, std::size_t n,
+                            uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                            pixel_quantum *dst, std::size_t dst_stride) {
+    const __m128d scale = _mm_set1_pd(static_cast<float>(range.second - range.first));
+    const __m128d first = _mm_set1_pd(range.first);
+    const __m128d max = _mm_set1_pd(static_cast<double>(unorm_max(integer_bits, fractional_bits)));
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i codes = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i)),
+                                           _mm_setzero_si128());
+        __m128d lo = _mm_cvtepi32_pd(codes);
+        __m128d hi = _mm_cvtepi32_pd(_mm_srli_si128(codes, 8));
+
+        lo = _mm_div_pd(_mm_sub_pd(_mm_div_pd(lo, max), first), scale);
+        hi = _mm_div_pd(_mm_sub_pd(_mm_div_pd(hi, max), first), scale);
+
+        __m128 val = _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi));
+
+        // Same operand order as clamp(): NaN and -0.0 become 0.
+        val = _mm_min_ps(_mm_max_ps(val, zero), one);
+        store_4(dst + i * dst_stride, dst_stride, val);
+    }
+
+    from_unorm_scalar(src + i, n - i, integer_bits, fractional_bits, range, dst + i * dst_stride, dst_stride);
+}
+
+#endif // XYUV_HAVE_SSE2
+
+#ifdef XYUV_HAVE_AVX2
+
+XYUV_TARGET_AVX2
+static inline __m256 load_8(const pixel_quantum *src, std::size_t stride) {
+    if (stride == 1) {
+        return _mm256_loadu_ps(src);
+    }
+    return _mm256_set_ps(src[7 * stride], src[6 * stride], src[5 * stride], src[4 * stride],
+                         src[3 * stride], src[2 * stride], src[stride], src[0]);
+}
+
+XYUV_TARGET_AVX2
+static inline void store_8(pixel_quantum *dst, std::size_t stride, __m256 val) {
+    if (stride == 1) {
+        _mm256_storeu_ps(dst, val);
+        return;
+    }
+    float tmp[8];
+    _mm256_storeu_ps(tmp, val);
+    for (std::size_t i = 0; i < 8; i++) {
+        dst[i * stride] = tmp[i];
+    }
+}
+
+XYUV_TARGET_AVX2
+static void to_unorm_avx2(const pixel_quantum *src, std::size_t src_stride, std::size_t n,
+                          uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                          uint16_t *dst) {
+    const __m256d scale = _mm256_set1_pd(static_cast<float>(range.second - range.first));
+    const __m256d first = _mm256_set1_pd(range.first);
+    const __m256d max = _mm256_set1_pd(static_cast<double>(unorm_max(integer_bits, fractional_bits)));
+    const __m256d half = _mm256_set1_pd(0.5);
+
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 val = load_8(src + i * src_stride, src_stride);
+        __m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(val));
+        __m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(val, 1));
+
+        lo = _mm256_add_pd(_mm256_mul_pd(_mm256_add_pd(_mm256_mul_pd(lo, scale), first), max), half);
+        hi = _mm256_add_pd(_mm256_mul_pd(_mm256_add_pd(_mm256_mul_pd(hi, scale), first), max), half);
+
+        __m128i packed = _mm_packus_epi32(_mm256_cvttpd_epi32(lo), _mm256_cvttpd_epi32(hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), packed);
+    }
+
+    to_unorm_scalar(src + i * src_stride, src_stride, n - i, integer_bits, fractional_bits, range, dst + i);
+}
+
+XYUV_TARGET_AVX2
+static void from_unorm_avx2(const uint16_t *src, std::size_t n,
+                            uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                            pixel_quantum *dst, std::size_t dst_stride) {
+    const __m256d scale = _mm256_set1_pd(static_cast<float>(range.second - range.first));
+    const __m256d first = _mm256_set1_pd(range.first);
+    const __m256d max = _mm256_set1_pd(static_cast<double>(unorm_max(integer_bits, fractional_bits)));
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i codes = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+        __m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(codes));
+        __m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(codes, 1));
+
+        lo = _mm256_div_pd(_mm256_sub_pd(_mm256_div_pd(lo, max), first), scale);
+        hi = _mm256_div_pd(_mm256_sub_pd(_mm256_div_pd(hi, max), first), scale);
+
+        __m256 val = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(lo)), _mm256_cvtpd_ps(hi), 1);
+
+        // Same operand order as clamp(): NaN and -0.0 become 0.
+        val = _mm256_min_ps(_mm256_max_ps(val, zero), one);
+        store_8(dst + i * dst_stride, dst_stride, val);
+    }
+
+    from_unorm_scalar(src + i, n - i, integer_bits, fractional_bits, range, dst + i * dst_stride, dst_stride);
+}
+
+#endif // XYUV_HAVE_AVX2
+
+simd_level detect_simd_level() {
+#if defined(XYUV_HAVE_AVX2)
+    static const simd_level level = __builtin_cpu_supports("avx2") ? simd_level::AVX2 : simd_level::SSE2;
+    return level;
+#elif defined(XYUV_HAVE_SSE2)
+    return simd_level::SSE2;
+#else
+    return simd_level::SCALAR;
+#endif
+}
+
+void to_unorm_batch(simd_level level, const pixel_quantum *src, std::size_t src_stride, std::size_t n,
+                    uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                    uint16_t *dst) {
+    XYUV_ASSERT(integer_bits + fractional_bits <= MAX_BATCH_BITS);
+
+    // Truncation only equals floor when every intermediate is non-negative.
+    bool vector_safe = range.first >= 0.0f && range.second >= range.first;
+
+    switch (vector_safe ? level : simd_level::SCALAR) {
+#ifdef XYUV_HAVE_AVX2
+        case simd_level::AVX2:
+            to_unorm_avx2(src, src_stride, n, integer_bits, fractional_bits, range, dst);
+            break;
+#endif
+#ifdef XYUV_HAVE_SSE2
+        case simd_level::SSE2:
+            to_unorm_sse2(src, src_stride, n, integer_bits, fractional_bits, range, dst);
+            break;
+#endif
+        default:
+            to_unorm_scalar(src, src_stride, n, integer_bits, fractional_bits, range, dst);
+            break;
+    }
+}
+
+void from_unorm_batch(simd_level level, const uint16_t *src, std::size_t n,
+                      uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                      pixel_quantum *dst, std::size_t dst_stride) {
+    XYUV_ASSERT(integer_bits + fractional_bits <= MAX_BATCH_BITS);
+
+    switch (level) {
+#ifdef XYUV_HAVE_AVX2
+        case simd_level::AVX2:
+            from_unorm_avx2(src, n, integer_bits, fractional_bits, range, dst, dst_stride);
+            break;
+#endif
+#ifdef XYUV_HAVE_SSE2
+        case simd_level::SSE2:
+            from_unorm_sse2(src, n, integer_bits, fractional_bits, range, dst, dst_stride);
+            break;
+#endif
+        default:
+            from_unorm_scalar(src, n, integer_bits, fractional_bits, range, dst, dst_stride);
+            break;
+    }
+}
+
+void to_unorm_batch(const pixel_quantum *src, std::size_t src_stride, std::size_t n,
+                    uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                    uint16_t *dst) {
+    to_unorm_batch(detect_simd_level(), src, src_stride, n, integer_bits, fractional_bits, range, dst);
+}
+
+void from_unorm_batch(const uint16_t *src, std::size_t n,
+                      uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                      pixel_quantum *dst, std::size_t dst_stride) {
+    from_unorm_batch(detect_simd_level(), src, n, integer_bits, fractional_bits, range, dst, dst_stride);
+}
+
+// Other sample types are converted to or from float in chunks small enough to stay in the L1 cache.
+static const std::size_t CONVERT_CHUNK = 256;
+
+template<typename Q>
+static void load_values_scalar(const Q *src, std::size_t src_stride, std::size_t n, float *dst) {
+    for (std::size_t i = 0; i < n; i++) {
+        dst[i] = quantum_traits<Q>::to_float(src[i * src_stride]);
+    }
+}
+
+template<typename Q>
+static void store_values_scalar(const float *src, std::size_t n, Q *dst, std::size_t dst_stride) {
+    for (std::size_t i = 0; i < n; i++) {
+        dst[i * dst_stride] = quantum_traits<Q>::from_float(src[i]);
+    }
+}
+
+#ifdef XYUV_HAVE_AVX2
+// Every cpu with avx2 also has the half conversion instructions, which round to nearest even like float_to_half().
+#define XYUV_TARGET_F16C __attribute__((target("avx2,f16c")))
+
+XYUV_TARGET_F16C
+static void load_values_f16c(const half *src, std::size_t src_stride, std::size_t n, float *dst) {
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16_t bits[8];
+        for (std::size_t j = 0; j < 8; j++) {
+            bits[j] = src[(i + j) * src_stride].bits;
+        }
+        __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bits));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(packed));
+    }
+    load_values_scalar(src + i * src_stride, src_stride, n - i, dst + i);
+}
+
+XYUV_TARGET_F16C
+static void store_values_f16c(const float *src, std::size_t n, half *dst, std::size_t dst_stride) {
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16_t bits[8];
+        __m128i packed = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(bits), packed);
+        for (std::size_t j = 0; j < 8; j++) {
+            dst[(i + j) * dst_stride].bits = bits[j];
+        }
+    }
+    store_values_scalar(src + i, n - i, dst + i * dst_stride, dst_stride);
+}
+#endif // XYUV_HAVE_AVX2
+
+static void load_values(const half *src, std::size_t src_stride, std::size_t n, float *dst) {
+#ifdef XYUV_HAVE_AVX2
+    if (detect_simd_level() == simd_level::AVX2) {
+        load_values_f16c(src, src_stride, n, dst);
+        return;
+    }
+#endif
+    load_values_scalar(src, src_stride, n, dst);
+}
+
+static void store_values(const float *src, std::size_t n, half *dst, std::size_t dst_stride) {
+#ifdef XYUV_HAVE_AVX2
+    if (detect_simd_level() == simd_level::AVX2) {
+        store_values_f16c(src, n, dst, dst_stride);
+        return;
+    }
+#endif
+    store_values_scalar(src, n, dst, dst_stride);
+}
+
+static void load_values(const uint16_t *src, std::size_t src_stride, std::size_t n, float *dst) {
+    load_values_scalar(src, src_stride, n, dst);
+}
+
+static void store_values(const float *src, std::size_t n, uint16_t *dst, std::size_t dst_stride) {
+    store_values_scalar(src, n, dst, dst_stride);
+}
+
+template<typename Q>
+static void to_unorm_converted(const Q *src, std::size_t src_stride, std::size_t n,
+                               uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                               uint16_t *dst) {
+    float values[CONVERT_CHUNK];
+    for (std::size_t i = 0; i < n; i += CONVERT_CHUNK) {
+        std::size_t chunk = std::min(CONVERT_CHUNK, n - i);
+        load_values(src + i * src_stride, src_stride, chunk, values);
+        to_unorm_batch(values, 1, chunk, integer_bits, fractional_bits, range, dst + i);
+    }
+}
+
+template<typename Q>
+static void from_unorm_converted(const uint16_t *src, std::size_t n,
+                                 uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                                 Q *dst, std::size_t dst_stride) {
+    float values[CONVERT_CHUNK];
+    for (std::size_t i = 0; i < n; i += CONVERT_CHUNK) {
+        std::size_t chunk = std::min(CONVERT_CHUNK, n - i);
+        from_unorm_batch(src + i, chunk, integer_bits, fractional_bits, range, values, 1);
+        store_values(values, chunk, dst + i * dst_stride, dst_stride);
+    }
+}
+
+void to_unorm_batch(const half *src, std::size_t src_stride, std::size_t n,
+                    uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                    uint16_t *dst) {
+    to_unorm_converted(src, src_stride, n, integer_bits, fractional_bits, range, dst);
+}
+
+void to_unorm_batch(const uint16_t *src, std::size_t src_stride, std::size_t n,
+                    uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                    uint16_t *dst) {
+    to_unorm_converted(src, src_stride, n, integer_bits, fractional_bits, range, dst);
+}
+
+void from_unorm_batch(const uint16_t *src, std::size_t n,
+                      uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                      half *dst, std::size_t dst_stride) {
+    from_unorm_converted(src, n, integer_bits, fractional_bits, range, dst, dst_stride);
+}
+
+void from_unorm_batch(const uint16_t *src, std::size_t n,
+                      uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                      uint16_t *dst, std::size_t dst_stride) {
+    from_unorm_converted(src, n, integer_bits, fractional_bits, range, dst, dst_stride);
+}
+
+half float_to_half(float value) {
+    uint32_t f;
+    memcpy(&f, &value, sizeof(f));
+    uint16_t sign = static_cast<uint16_t>((f >> 16) & 0x8000);
+    uint32_t magnitude = f & 0x7fffffff;
+
+    uint16_t bits;
+    if (magnitude >= 0x7f800000) {
+        // Infinity stays infinity, NaN becomes a quiet NaN.
+        bits = magnitude > 0x7f800000 ? 0x7e00 : 0x7c00;
+    } else if (magnitude >= 0x477ff000) {
+        // At least 65520, which rounds past the largest half.
+        bits = 0x7c00;
+    } else if (magnitude < 0x38800000) {
+        // Below the smallest normal half: adding 0.5 lines the subnormal mantissa up with the low bits of the float,
+        // and the addition rounds it to nearest even.
+        float magic = 0.5f, sum;
+        memcpy(&sum, &magnitude, sizeof(sum));
+        sum += magic;
+        uint32_t sum_bits, magic_bits;
+        memcpy(&sum_bits, &sum, sizeof(sum_bits));
+        memcpy(&magic_bits, &magic, sizeof(magic_bits));
+        bits = static_cast<uint16_t>(sum_bits - magic_bits);
+    } else {
+        // Rebias the exponent from 127 to 15 and round the mantissa to nearest even.
+        uint32_t odd = (magnitude >> 13) & 1;
+        magnitude += 0xc8000fff + odd;
+        bits = static_cast<uint16_t>(magnitude >> 13);
+    }
+
+    half result;
+    result.bits = sign | bits;
+    return result;
+}
+
+float half_to_float(half value) {
+    uint32_t sign = static_cast<uint32_t>(value.bits & 0x8000) << 16;
+    uint32_t exponent = (value.bits >> 10) & 0x1f;
+    uint32_t mantissa = value.bits & 0x3ff;
+
+    if (exponent == 0) {
+        // Zero or subnormal, exactly representable as mantissa * 2^-24.
+        float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -magnitude : magnitude;
+    }
+
+    uint32_t f = sign | (mantissa << 13);
+    f |= exponent == 0x1f ? 0x7f800000 : (exponent + 112) << 23;
+
+    float result;
+    memcpy(&result, &f, sizeof(result));
+    return result;
+}
+
+} // namespace xyuv
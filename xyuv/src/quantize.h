@@ -0,0 +1,150 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <xyuv/structures/color.h>
+#include <xyuv/quantum.h>
+#include "assert.h"
+#include "utility.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/** \file Conversion between pixel_quantum and the unsigned normalized integers stored in a frame. */
+
+namespace xyuv {
+
+using unorm_t = uint64_t;
+
+static inline unorm_t round_to_unorm(double val) {
+    using std::floor;
+    return static_cast<unorm_t>(floor(val + 0.5));
+}
+
+//! \brief Convert a value in [0,1] to an unsigned normalized integer with the given number of bits,
+//! remapped into the packed \p range.
+static inline unorm_t to_unorm(float value, uint8_t integer_bits, uint8_t fractional_bits,
+                               const std::pair<float, float> &range) {
+    XYUV_ASSERT_RANGE(0.0f, 1.0f, value);
+    XYUV_ASSERT(integer_bits + fractional_bits <= 8 * sizeof(unorm_t));
+    XYUV_ASSERT(integer_bits < 8 * sizeof(unorm_t));
+
+    // What is the largest integer value representable
+    unorm_t max = (0x1ull << integer_bits) - 1;
+    max <<= fractional_bits;
+
+    double dbl_val = value;
+
+    // Scale value to range boundaries:
+    dbl_val *= (range.second - range.first);
+    dbl_val += range.first;
+
+    // Convert to unorm
+    unorm_t bits = round_to_unorm(dbl_val * max);
+
+    return bits;
+}
+
+//! \brief Inverse of to_unorm(), the result is clamped to [0,1].
+static inline float from_unorm(unorm_t unorm, uint8_t integer_bits, uint8_t fractional_bits,
+                               const std::pair<float, float> &range) {
+    XYUV_ASSERT(integer_bits + fractional_bits <= 8 * sizeof(unorm_t));
+    XYUV_ASSERT(integer_bits < 8 * sizeof(unorm_t));
+
+    unorm_t max = (0x1ull << integer_bits) - 1;
+    max <<= fractional_bits;
+
+    // Convert to double
+    double dbl_val = static_cast<double>(unorm) / max;
+
+    // Convert back to [0,1]
+    dbl_val -= range.first;
+    dbl_val /= (range.second - range.first);
+
+    return clamp(0.0f, 1.0f, static_cast<float>(dbl_val));
+}
+
+//! \brief Instruction sets available to the batch conversions.
+enum class simd_level {
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+//! \brief The best instruction set supported by both the build and the running cpu.
+simd_level detect_simd_level();
+
+//! \brief The widest unorm handled by the batch conversions.
+static const uint8_t MAX_BATCH_BITS = 16;
+
+//! \brief Convert \p n values to unorm codes, bit exact with to_unorm().
+//! \param [in] src First value, subsequent values are read every \p src_stride floats.
+//! \param [out] dst Contiguous array of \p n codes.
+//! \details integer_bits + fractional_bits must not exceed MAX_BATCH_BITS.
+void to_unorm_batch(const pixel_quantum *src, std::size_t src_stride, std::size_t n,
+                    uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                    uint16_t *dst);
+
+//! \brief Convert \p n unorm codes to values, bit exact with from_unorm().
+//! \param [in] src Contiguous array of \p n codes.
+//! \param [out] dst First value, subsequent values are written every \p dst_stride floats.
+//! \details integer_bits + fractional_bits must not exceed MAX_BATCH_BITS.
+void from_unorm_batch(const uint16_t *src, std::size_t n,
+                      uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                      pixel_quantum *dst, std::size_t dst_stride);
+
+//! \brief As to_unorm_batch(), for half samples which are converted to float in chunks first.
+void to_unorm_batch(const half *src, std::size_t src_stride, std::size_t n,
+                    uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                    uint16_t *dst);
+
+//! \brief As to_unorm_batch(), for 16 bit normalized samples which are converted to float in chunks first.
+void to_unorm_batch(const uint16_t *src, std::size_t src_stride, std::size_t n,
+                    uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                    uint16_t *dst);
+
+//! \brief As from_unorm_batch(), for half samples.
+void from_unorm_batch(const uint16_t *src, std::size_t n,
+                      uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                      half *dst, std::size_t dst_stride);
+
+//! \brief As from_unorm_batch(), for 16 bit normalized samples.
+void from_unorm_batch(const uint16_t *src, std::size_t n,
+                      uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                      uint16_t *dst, std::size_t dst_stride);
+
+//! \brief As to_unorm_batch() but forcing the instruction set, \p level must be supported.
+void to_unorm_batch(simd_level level, const pixel_quantum *src, std::size_t src_stride, std::size_t n,
+                    uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                    uint16_t *dst);
+
+//! \brief As from_unorm_batch() but forcing the instruction set, \p level must be supported.
+void from_unorm_batch(simd_level level, const uint16_t *src, std::size_t n,
+                      uint8_t integer_bits, uint8_t fractional_bits, const std::pair<float, float> &range,
+                      pixel_quantum *dst, std::size_t dst_stride);
+
+} // namespace xyuv
@@ -0,0 +1,204 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "repack.h"
+#include <xyuv/surface.h>
+#include <xyuv.h>
+#include "bit_stream.h"
+#include "block_access.h"
+#include "pack_plan.h"
+#include "quantize.h"
+#include "utility.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace xyuv {
+
+// Get the bit depth shared by all values of the channel, fails if they differ or are too wide to repack.
+static bool get_value_depth(const channel_plan &plan, std::pair<uint8_t, uint8_t> *depth) {
+    const value_plan &first = plan.values.front();
+    for (const value_plan &value : plan.values) {
+        if (value.integer_bits != first.integer_bits || value.fractional_bits != first.fractional_bits) {
+            return false;
+        }
+    }
+    *depth = std::make_pair(first.integer_bits, first.fractional_bits);
+    return first.integer_bits + first.fractional_bits <= MAX_BATCH_BITS;
+}
+
+// Rows of pixels are repacked in bands of about this many rows, so that the codes stay in cache.
+static const uint32_t BAND_HEIGHT = 16;
+
+// Get the block lines lying entirely within the rows [first_row, last_row), first_row must start a block line.
+static std::pair<uint32_t, uint32_t> get_block_lines(const channel_plan &plan, uint32_t first_row, uint32_t last_row) {
+    return std::make_pair(first_row / plan.block_h, std::min(plan.n_block_lines, last_row / plan.block_h));
+}
+
+// Read the code of every pixel stored in the rows [first_row, last_row) of the frame clamped to [lo, hi], row y is
+// written to row y - first_row of codes. Pixels outside the blocks of the channel are left untouched.
+static void gather_codes(const uint8_t *base_addr, const pack_plan &pack, const channel_plan &plan,
+                         uint16_t lo, uint16_t hi, uint32_t first_row, uint32_t last_row, surface<uint16_t> *codes) {
+    std::vector<uint16_t> line_codes(plan.n_blocks_in_line);
+
+    auto lines = get_block_lines(plan, first_row, last_row);
+    for (uint32_t line = lines.first; line < lines.second; line++) {
+        uint32_t y = line * plan.block_h - first_row;
+        for (const value_plan &value : plan.values) {
+            uint16_t *dst = codes->scanline(y + value.y) + value.x;
+
+            if (plan.byte_width != 0 && !plan.tiled) {
+                const part_plan &part = plan.parts[value.first_part];
+                const uint8_t *src = base_addr + plan.line_offset(part.plane, line) + part.offset / 8;
+                uint32_t src_stride = part.block_stride / 8;
+                if (plan.byte_width == 1) {
+                    for (uint32_t b = 0; b < plan.n_blocks_in_line; b++) {
+                        dst[b * plan.block_w] = std::min(std::max<uint16_t>(src[b * src_stride], lo), hi);
+                    }
+                } else {
+                    for (uint32_t b = 0; b < plan.n_blocks_in_line; b++) {
+                        dst[b * plan.block_w] = std::min(std::max(load_le<uint16_t>(src + b * src_stride), lo), hi);
+                    }
+                }
+                continue;
+            }
+
+            std::fill(line_codes.begin(), line_codes.end(), 0);
+            for (uint32_t p = value.first_part; p < value.first_part + value.n_parts; p++) {
+                const part_plan &part = plan.parts[p];
+                for_each_tiled_block(base_addr, pack.tilings[part.plane], plan, part, line, 0, plan.n_blocks_in_line,
+                    [&](uint32_t b, const uint8_t *region, const uint8_t *region_end, uint64_t bit) {
+                        line_codes[b] |= static_cast<uint16_t>(extract_bits(region, region_end, bit, part.bits) << part.shift);
+                    });
+            }
+            for (uint32_t b = 0; b < plan.n_blocks_in_line; b++) {
+                dst[b * plan.block_w] = std::min(std::max(line_codes[b], lo), hi);
+            }
+        }
+    }
+}
+
+static void scatter_codes(uint8_t *base_addr, const pack_plan &pack, const channel_plan &plan,
+                          uint32_t first_row, uint32_t last_row, const surface<uint16_t> &codes) {
+    auto lines = get_block_lines(plan, first_row, last_row);
+    for (uint32_t line = lines.first; line < lines.second; line++) {
+        uint32_t y = line * plan.block_h - first_row;
+        for (const value_plan &value : plan.values) {
+            const uint16_t *src = codes.scanline(y + value.y) + value.x;
+
+            if (plan.byte_width != 0 && !plan.tiled) {
+                const part_plan &part = plan.parts[value.first_part];
+                uint8_t *dst = base_addr + plan.line_offset(part.plane, line) + part.offset / 8;
+                uint32_t dst_stride = part.block_stride / 8;
+                for (uint32_t b = 0; b < plan.n_blocks_in_line; b++) {
+                    if (plan.byte_width == 1) {
+                        store_le(dst + b * dst_stride, static_cast<uint8_t>(src[b * plan.block_w]));
+                    } else {
+                        store_le(dst + b * dst_stride, src[b * plan.block_w]);
+                    }
+                }
+                continue;
+            }
+
+            for (uint32_t p = value.first_part; p < value.first_part + value.n_parts; p++) {
+                const part_plan &part = plan.parts[p];
+                for_each_tiled_block(base_addr, pack.tilings[part.plane], plan, part, line, 0, plan.n_blocks_in_line,
+                    [&](uint32_t b, uint8_t *region, const uint8_t *region_end, uint64_t bit) {
+                        insert_bits(region, region_end, bit, part.bits, src[b * plan.block_w] >> part.shift);
+                    });
+            }
+        }
+    }
+}
+
+bool repack_frame(const xyuv::frame &frame_in, const xyuv::format &format, xyuv::frame *frame_out) {
+    const xyuv::format &src_format = frame_in.format;
+    if (src_format.image_w != format.image_w || src_format.image_h != format.image_h
+        || !(src_format.chroma_siting == format.chroma_siting)
+        || !(src_format.conversion_matrix == format.conversion_matrix)) {
+        return false;
+    }
+
+    pack_plan src_plan = compile_pack_plan(src_format);
+    pack_plan dst_plan = compile_pack_plan(format);
+
+    std::array<std::pair<uint8_t, uint8_t>, 4> depths;
+    for (uint32_t c = 0; c < 4; c++) {
+        const channel_plan &src = src_plan.channels[c];
+        const channel_plan &dst = dst_plan.channels[c];
+        if (!dst.present) {
+            continue;
+        }
+        if (!get_value_depth(dst, &depths[c])) {
+            return false;
+        }
+        std::pair<uint8_t, uint8_t> src_depth;
+        if (src.present && (!get_value_depth(src, &src_depth) || src_depth != depths[c])) {
+            return false;
+        }
+    }
+
+    xyuv::frame result = create_frame(format, nullptr, 0);
+    poison_buffer(result.data.get(), format.size);
+
+    for (uint32_t c = 0; c < 4; c++) {
+        const channel_plan &src = src_plan.channels[c];
+        const channel_plan &dst = dst_plan.channels[c];
+        if (!dst.present || (!src.present && c != channel::A)) {
+            // Like encode_frame(), a channel missing from the image is not written.
+            continue;
+        }
+
+        // The codes the float path ends up with for 0.0 and 1.0, all others survive the round trip unchanged.
+        uint8_t integer_bits = depths[c].first, fractional_bits = depths[c].second;
+        unorm_t zero = to_unorm(0.0f, integer_bits, fractional_bits, dst.range);
+        unorm_t one = to_unorm(1.0f, integer_bits, fractional_bits, dst.range);
+        uint16_t lo = static_cast<uint16_t>(std::min(zero, one));
+        uint16_t hi = static_cast<uint16_t>(std::max(zero, one));
+
+        // Bands must hold whole block lines of both formats.
+        uint32_t block_h = src.present ? lcm(src.block_h, dst.block_h) : dst.block_h;
+        uint32_t band_height = next_multiple(BAND_HEIGHT, block_h);
+        surface<uint16_t> codes(dst.width, band_height);
+
+        // Pixels not covered by the blocks of the source are 0.0, except alpha which defaults to 1.0.
+        bool covered = src.present && src.n_blocks_in_line * src.block_w == src.width
+                       && src.n_block_lines * src.block_h == src.height;
+
+        for (uint32_t first_row = 0; first_row < dst.height; first_row += band_height) {
+            uint32_t last_row = std::min(dst.height, first_row + band_height);
+            if (!covered) {
+                codes.fill(static_cast<uint16_t>(c == channel::A ? one : zero));
+            }
+            if (src.present) {
+                gather_codes(frame_in.data.get(), src_plan, src, lo, hi, first_row, last_row, &codes);
+            }
+            scatter_codes(result.data.get(), dst_plan, dst, first_row, last_row, codes);
+        }
+    }
+
+    *frame_out = std::move(result);
+    return true;
+}
+
+} // namespace xyuv
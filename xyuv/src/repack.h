@@ -0,0 +1,40 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <xyuv/frame.h>
+
+namespace xyuv {
+
+//! \brief Convert \a frame_in to \a format by moving its packed codes, without unpacking them to floating point.
+//! \details This is possible when both formats have the same dimensions, chroma siting and conversion matrix, and
+//!          every channel stores all its values with the same bit depth (at most 16 bits) in both formats, e.g.
+//!          NV12 to YV12. The result is bit exact with encode_frame(decode_frame(frame_in), format).
+//! \param [in] frame_in frame to convert.
+//! \param [in] format target format.
+//! \param [out] frame_out the converted frame.
+//! \returns false, leaving \a frame_out untouched, if the conversion changes the samples.
+bool repack_frame(const xyuv::frame &frame_in, const xyuv::format &format, xyuv::frame *frame_out);
+
+} // namespace xyuv
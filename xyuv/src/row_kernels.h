@@ -0,0 +1,77 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <xyuv/aligned_allocator.h>
+#include <xyuv/quantum.h>
+#include <xyuv/surface.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define XYUV_HAVE_SSE2 1
+#   include <emmintrin.h>
+#endif
+
+/** \file Row kernels shared by the resampling code. */
+
+namespace xyuv {
+
+//! \brief A row of samples aligned like the rows of a surface.
+using row_buffer = std::vector<pixel_quantum, aligned_allocator<pixel_quantum, max_row_alignment>>;
+
+//! \brief Get the number of samples a row kernel may process in every row of \a surf.
+//! \details This is the width rounded up to whole SSE registers when the row padding of \a surf allows it, so that
+//!          blend_rows() runs without a scalar tail. The extra samples are padding.
+static inline uint32_t vector_row_width(const surface<pixel_quantum> &surf) {
+    uint32_t padded = (surf.width() + 3) & ~3u;
+    return surf.stride() >= padded ? padded : surf.width();
+}
+
+//! \brief dst[x] = sum of weights[k]*rows[k][x] for x in [0, width).
+static inline void blend_rows(const pixel_quantum *const *rows, const float *weights, std::size_t n_rows,
+                              uint32_t width, pixel_quantum *dst) {
+    uint32_t x = 0;
+#ifdef XYUV_HAVE_SSE2
+    for (; x + 4 <= width; x += 4) {
+        __m128 acc = _mm_mul_ps(_mm_set1_ps(weights[0]), _mm_loadu_ps(rows[0] + x));
+        for (std::size_t k = 1; k < n_rows; k++) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(rows[k] + x)));
+        }
+        _mm_storeu_ps(dst + x, acc);
+    }
+#endif
+    for (; x < width; x++) {
+        pixel_quantum acc = weights[0] * rows[0][x];
+        for (std::size_t k = 1; k < n_rows; k++) {
+            acc += weights[k] * rows[k][x];
+        }
+        dst[x] = acc;
+    }
+}
+
+} // namespace xyuv
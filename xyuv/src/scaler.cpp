@@ -0,0 +1,349 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "scaler.h"
+#include "row_kernels.h"
+
+#include <xyuv.h>
+#include <xyuv/executor.h>
+#include <xyuv/structures/chroma_siting.h>
+#include <xyuv/yuv_image.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace xyuv {
+
+static const double PI = 3.14159265358979323846;
+
+// Radius of the filter kernels in samples, before widening for shrinking.
+static double filter_support(scaling_filter filter) {
+    switch (filter) {
+        case scaling_filter::BOX:
+            return 0.5;
+        case scaling_filter::BILINEAR:
+            return 1.0;
+        case scaling_filter::BICUBIC:
+            return 2.0;
+        case scaling_filter::LANCZOS:
+            return 3.0;
+        default:
+            return 0.0;
+    }
+}
+
+static double sinc(double x) {
+    if (x == 0.0) {
+        return 1.0;
+    }
+    x *= PI;
+    return std::sin(x) / x;
+}
+
+static double filter_weight(scaling_filter filter, double x) {
+    x = std::fabs(x);
+    switch (filter) {
+        case scaling_filter::BOX:
+            // Half open, so a sample exactly between two others is only counted once.
+            return x < 0.5 ? 1.0 : 0.0;
+        case scaling_filter::BILINEAR:
+            return x < 1.0 ? 1.0 - x : 0.0;
+        case scaling_filter::BICUBIC:
+            // Catmull-Rom spline, i.e. Keys' cubic with a = -0.5.
+            if (x < 1.0) {
+                return (1.5 * x - 2.5) * x * x + 1.0;
+            }
+            if (x < 2.0) {
+                return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+            }
+            return 0.0;
+        case scaling_filter::LANCZOS:
+            return x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+        default:
+            return 0.0;
+    }
+}
+
+scale_coefficients compute_scale_coefficients(uint32_t src_size, uint32_t dst_size, double ratio, double shift,
+                                              scaling_filter filter) {
+    const int64_t last = static_cast<int64_t>(src_size) - 1;
+    const double stretch = std::max(ratio, 1.0);
+    const double radius = filter_support(filter) * stretch;
+
+    // Non-zero taps of every destination sample with their indices clamped to the source.
+    std::vector<std::vector<std::pair<uint32_t, double>>> taps(dst_size);
+    uint32_t n_taps = 1;
+
+    for (uint32_t j = 0; j < dst_size; j++) {
+        double center = j * ratio + shift;
+        auto &dst_taps = taps[j];
+
+        if (filter != scaling_filter::NEAREST) {
+            double sum = 0.0;
+            int64_t lo = static_cast<int64_t>(std::floor(center - radius));
+            int64_t hi = static_cast<int64_t>(std::ceil(center + radius));
+            for (int64_t i = lo; i <= hi; i++) {
+                double weight = filter_weight(filter, (i - center) / stretch);
+                if (weight != 0.0) {
+                    dst_taps.emplace_back(static_cast<uint32_t>(std::min(std::max<int64_t>(i, 0), last)), weight);
+                    sum += weight;
+                }
+            }
+            for (auto &tap : dst_taps) {
+                tap.second /= sum;
+            }
+        }
+
+        // Nearest neighbour, also used if the kernel misses every sample.
+        if (dst_taps.empty()) {
+            int64_t nearest = static_cast<int64_t>(std::floor(center + 0.5));
+            dst_taps.emplace_back(static_cast<uint32_t>(std::min(std::max<int64_t>(nearest, 0), last)), 1.0);
+        }
+
+        n_taps = std::max(n_taps, dst_taps.back().first - dst_taps.front().first + 1);
+    }
+
+    scale_coefficients coeffs;
+    coeffs.n_taps = n_taps;
+    coeffs.first.resize(dst_size);
+    coeffs.weights.assign(static_cast<std::size_t>(dst_size) * n_taps, 0.0f);
+
+    for (uint32_t j = 0; j < dst_size; j++) {
+        uint32_t first = std::min(taps[j].front().first, src_size - n_taps);
+        coeffs.first[j] = first;
+
+        // Clamped taps may land on the same sample, accumulate in double before rounding.
+        std::vector<double> weights(n_taps, 0.0);
+        for (auto &tap : taps[j]) {
+            weights[tap.first - first] += tap.second;
+        }
+        std::copy(weights.begin(), weights.end(), coeffs.weights.begin() + static_cast<std::size_t>(j) * n_taps);
+    }
+
+    return coeffs;
+}
+
+// dst[j] = sum of the taps of destination sample j applied to src.
+static void scale_row(const pixel_quantum *src, const scale_coefficients &coeffs, uint32_t dst_width,
+                      pixel_quantum *dst) {
+    const uint32_t n_taps = coeffs.n_taps;
+    const uint32_t *first = coeffs.first.data();
+    const float *weights = coeffs.weights.data();
+
+    if (n_taps == 1) {
+        for (uint32_t j = 0; j < dst_width; j++) {
+            dst[j] = weights[j] * src[first[j]];
+        }
+        return;
+    }
+
+    if (n_taps == 2) {
+        for (uint32_t j = 0; j < dst_width; j++) {
+            const pixel_quantum *s = src + first[j];
+            const float *w = weights + 2 * j;
+            dst[j] = w[0] * s[0] + w[1] * s[1];
+        }
+        return;
+    }
+
+    for (uint32_t j = 0; j < dst_width; j++) {
+        const pixel_quantum *s = src + first[j];
+        const float *w = weights + static_cast<std::size_t>(j) * n_taps;
+        uint32_t k = 0;
+        pixel_quantum acc = 0.0f;
+#ifdef XYUV_HAVE_SSE2
+        __m128 sum = _mm_setzero_ps();
+        for (; k + 4 <= n_taps; k += 4) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(w + k), _mm_loadu_ps(s + k)));
+        }
+        // Horizontal sum of the four lanes.
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+        acc = _mm_cvtss_f32(sum);
+#endif
+        for (; k < n_taps; k++) {
+            acc += w[k] * s[k];
+        }
+        dst[j] = acc;
+    }
+}
+
+static bool has_negative_weights(const scale_coefficients &coeffs) {
+    return std::any_of(coeffs.weights.begin(), coeffs.weights.end(), [](float weight) { return weight < 0.0f; });
+}
+
+// Produce the output rows [first_row, last_row) of dst, clamping them to [0, 1] if the filters may overshoot.
+static void scale_rows(const surface<pixel_quantum> &src, const scale_coefficients &coeffs_x,
+                       const scale_coefficients &coeffs_y, bool overshoot, surface<pixel_quantum> *dst,
+                       uint32_t first_row, uint32_t last_row) {
+    const uint32_t dst_width = dst->width();
+    const uint32_t n_taps = coeffs_y.n_taps;
+
+    // Rows are blended and clamped including the padding of dst, so the ring rows are padded the same way.
+    const uint32_t blend_width = vector_row_width(*dst);
+
+    // The taps of consecutive output rows move monotonically down the source, so a ring of n_taps horizontally
+    // scaled rows holds every row an output row needs. Slot r % n_taps holds source row r.
+    row_buffer ring(static_cast<std::size_t>(n_taps) * blend_width);
+    std::vector<int64_t> ring_rows(n_taps, -1);
+    std::vector<const pixel_quantum *> rows(n_taps);
+
+    for (uint32_t y = first_row; y < last_row; y++) {
+        for (uint32_t k = 0; k < n_taps; k++) {
+            uint32_t source_row = coeffs_y.first[y] + k;
+            uint32_t slot = source_row % n_taps;
+            pixel_quantum *row = ring.data() + static_cast<std::size_t>(slot) * blend_width;
+            if (ring_rows[slot] != source_row) {
+                scale_row(src.scanline(source_row), coeffs_x, dst_width, row);
+                ring_rows[slot] = source_row;
+            }
+            rows[k] = row;
+        }
+
+        pixel_quantum *out = dst->scanline(y);
+        blend_rows(rows.data(), coeffs_y.weights.data() + static_cast<std::size_t>(y) * n_taps, n_taps, blend_width,
+                   out);
+        if (overshoot) {
+            for (uint32_t x = 0; x < blend_width; x++) {
+                out[x] = std::min(std::max(out[x], 0.0f), 1.0f);
+            }
+        }
+    }
+}
+
+void scale_surface(const surface<pixel_quantum> &src, const scale_coefficients &coeffs_x,
+                   const scale_coefficients &coeffs_y, surface<pixel_quantum> *dst, executor *exec) {
+    if (src.empty() || dst->empty()) {
+        return;
+    }
+
+    // Every filter preserves constants.
+    if (src.is_constant()) {
+        *dst = surface<pixel_quantum>::constant(dst->width(), dst->height(), src.constant_value(),
+                                                dst->get_allocator());
+        return;
+    }
+
+    // Make sure the surface is allocated before tasks write to disjoint rows of it.
+    dst->materialize();
+    bool overshoot = has_negative_weights(coeffs_x) || has_negative_weights(coeffs_y);
+
+    uint32_t n_rows = dst->height();
+    uint32_t n_tasks = exec ? std::min(n_rows, std::max(1u, 4 * exec->concurrency())) : 1;
+    if (n_tasks <= 1) {
+        scale_rows(src, coeffs_x, coeffs_y, overshoot, dst, 0, n_rows);
+        return;
+    }
+
+    exec->run(n_tasks, [&](uint32_t t) {
+        uint64_t first_row = static_cast<uint64_t>(n_rows) * t / n_tasks;
+        uint64_t last_row = static_cast<uint64_t>(n_rows) * (t + 1) / n_tasks;
+        scale_rows(src, coeffs_x, coeffs_y, overshoot, dst, static_cast<uint32_t>(first_row), static_cast<uint32_t>(last_row));
+    });
+}
+
+// Scale a plane sampled once per block of factor pixels, at sample_point inside the block. Pixel centres are mapped
+// between the images, so the sample of destination block j maps to (j*factor + sample_point + 0.5)*ratio - 0.5 in
+// source pixels, i.e. the shift below in source samples. Nearest neighbour keeps the mapping of surface<T>::scale
+// instead, sample j reads source sample floor(j*ratio + 0.5).
+static void scale_plane(const surface<pixel_quantum> &src, uint32_t src_w, uint32_t src_h, uint32_t dst_w,
+                        uint32_t dst_h, const subsampling &subsampling, const std::pair<float, float> &sample_point,
+                        scaling_filter filter, surface<pixel_quantum> *dst, executor *exec) {
+    if (src.empty()) {
+        return;
+    }
+
+    double ratio_x = static_cast<double>(src_w) / dst_w;
+    double ratio_y = static_cast<double>(src_h) / dst_h;
+    double shift_x = ((sample_point.first + 0.5) * ratio_x - 0.5 - sample_point.first) / subsampling.macro_px_w;
+    double shift_y = ((sample_point.second + 0.5) * ratio_y - 0.5 - sample_point.second) / subsampling.macro_px_h;
+    if (filter == scaling_filter::NEAREST) {
+        shift_x = shift_y = 0.0;
+    }
+
+    scale_coefficients coeffs_x = compute_scale_coefficients(src.width(), dst->width(), ratio_x, shift_x, filter);
+    scale_coefficients coeffs_y = compute_scale_coefficients(src.height(), dst->height(), ratio_y, shift_y, filter);
+    scale_surface(src, coeffs_x, coeffs_y, dst, exec);
+}
+
+// Scale every plane of yuva_in. If consumed is set (to yuva_in), each plane is released as soon as it is scaled, so
+// that the source and result of only one plane are held at the same time. The result draws from the buffer_pool of
+// the luma plane of yuva_in, if any.
+static yuv_image scale_planes(const yuv_image &yuva_in, uint32_t new_width, uint32_t new_height,
+                              scaling_filter filter, executor *exec, yuv_image *consumed) {
+    yuv_image result = create_yuv_image(
+            new_width,
+            new_height,
+            yuva_in.siting,
+            yuva_in.y_plane.get_allocator(),
+            !yuva_in.y_plane.empty(),
+            !yuva_in.u_plane.empty(),
+            !yuva_in.v_plane.empty(),
+            !yuva_in.a_plane.empty()
+    );
+
+    // Luma and alpha have one sample per pixel.
+    const xyuv::subsampling full = {1, 1};
+    const std::pair<float, float> center = {0.0f, 0.0f};
+
+    auto release = [consumed](surface<pixel_quantum> yuv_image::*plane) {
+        if (consumed) {
+            consumed->*plane = surface<pixel_quantum>();
+        }
+    };
+
+    scale_plane(yuva_in.y_plane, yuva_in.image_w, yuva_in.image_h, new_width, new_height, full, center, filter,
+                &result.y_plane, exec);
+    release(&yuv_image::y_plane);
+    scale_plane(yuva_in.u_plane, yuva_in.image_w, yuva_in.image_h, new_width, new_height, yuva_in.siting.subsampling,
+                yuva_in.siting.u_sample_point, filter, &result.u_plane, exec);
+    release(&yuv_image::u_plane);
+    scale_plane(yuva_in.v_plane, yuva_in.image_w, yuva_in.image_h, new_width, new_height, yuva_in.siting.subsampling,
+                yuva_in.siting.v_sample_point, filter, &result.v_plane, exec);
+    release(&yuv_image::v_plane);
+    scale_plane(yuva_in.a_plane, yuva_in.image_w, yuva_in.image_h, new_width, new_height, full, center, filter,
+                &result.a_plane, exec);
+    release(&yuv_image::a_plane);
+
+    return result;
+}
+
+yuv_image scale_image(const yuv_image &yuva_in, uint32_t new_width, uint32_t new_height, scaling_filter filter,
+                      executor *exec) {
+    if (yuva_in.image_w == new_width && yuva_in.image_h == new_height) {
+        return yuva_in;
+    }
+    return scale_planes(yuva_in, new_width, new_height, filter, exec, nullptr);
+}
+
+yuv_image scale_image(yuv_image &&yuva_in, uint32_t new_width, uint32_t new_height, scaling_filter filter,
+                      executor *exec) {
+    if (yuva_in.image_w == new_width && yuva_in.image_h == new_height) {
+        return std::move(yuva_in);
+    }
+    return scale_planes(yuva_in, new_width, new_height, filter, exec, &yuva_in);
+}
+
+} // namespace xyuv
@@ -0,0 +1,81 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Stian Valentin Svedenborg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <xyuv/structures/constants.h>
+#include <xyuv/surface.h>
+#include <xyuv/quantum.h>
+
+#include <cstdint>
+#include <vector>
+
+/** \file Separable polyphase resampling of surfaces and yuv_images. */
+
+namespace xyuv {
+
+class executor;
+
+template<typename T>
+struct basic_yuv_image;
+using yuv_image = basic_yuv_image<pixel_quantum>;
+
+//! \brief Resampling coefficients of one axis, dst[j] = sum of weights[j*n_taps + k] * src[first[j] + k].
+//! \details Taps falling outside the source are folded into the edge samples, so first[j] + n_taps never exceeds the
+//!          source size.
+struct scale_coefficients {
+    //! Number of taps of every destination sample.
+    uint32_t n_taps = 0;
+    //! Index of the first source sample of every destination sample.
+    std::vector<uint32_t> first;
+    //! n_taps weights per destination sample.
+    std::vector<float> weights;
+};
+
+//! \brief Compute the coefficients resampling \a src_size samples to \a dst_size samples using \a filter.
+//! \details Destination sample j is centred on source position j*ratio + shift, where position i is the centre of
+//!          source sample i. When shrinking (ratio > 1) the filter is widened by \a ratio to average the samples it
+//!          covers.
+scale_coefficients compute_scale_coefficients(uint32_t src_size, uint32_t dst_size, double ratio, double shift,
+                                              scaling_filter filter);
+
+//! \brief Resample \a src into \a dst, which must already have its final dimensions.
+//! \details Samples are clamped to [0, 1] if any weight is negative, as sharpening filters may overshoot.
+//! \details Rows are scaled horizontally once and kept in a ring buffer while the vertical taps of the output rows
+//!          use them.
+//!          With an executor, ranges of output rows are produced in parallel, every task keeping its own ring
+//!          buffer, so the result does not depend on the executor.
+void scale_surface(const surface<pixel_quantum> &src, const scale_coefficients &coeffs_x,
+                   const scale_coefficients &coeffs_y, surface<pixel_quantum> *dst, executor *exec);
+
+//! \brief Scale every plane of \a yuva_in to an image of \a new_width x \a new_height, see scale_yuv_image().
+yuv_image scale_image(const yuv_image &yuva_in, uint32_t new_width, uint32_t new_height, scaling_filter filter,
+                      executor *exec);
+
+//! \brief Same as scale_image(const yuv_image &, uint32_t, uint32_t, scaling_filter, executor *), but the planes of
+//!        \a yuva_in are moved to the result if the dimensions do not change, and released once scaled otherwise.
+yuv_image scale_image(yuv_image &&yuva_in, uint32_t new_width, uint32_t new_height, scaling_filter filter,
+                      executor *exec);
+
+} // namespace xyuv
@@ -22,76 +22,162 @@
  * THE SOFTWARE.
  */
 
+#include <xyuv.h>
 #include <xyuv/structures/chroma_siting.h>
 #include <xyuv/yuv_image.h>
 #include "assert.h"
+#include "row_kernels.h"
+#include <algorithm>
 #include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 namespace xyuv {
 
-yuv_image up_sample(const yuv_image &yuva_in) {
+// The center of the left-topmost pixel in the block has coordinate 0.0 and step by 1.0 to the center of the next
+// pixel in each dimension. Downsampling is calculated as the weighted average of the (<= four) pixels (inside the
+// block) closest to the sampling point. The weights are separable, so they are computed once per axis and applied as
+// a vertical pass blending source rows followed by a horizontal pass reducing each block to one sample.
+// For future reference: http://www.pcmag.com/encyclopedia/term/57460/chroma-subsampling
+struct axis_filter {
+    //! Size of the block along the axis.
+    uint32_t factor;
+    //! Weight of every position in the block, 0 for positions further than one pixel from the sample point.
+    std::vector<float> weights;
+    //! Positions in the block with a non-zero weight.
+    std::vector<uint32_t> taps;
+};
+
+static axis_filter make_axis_filter(uint32_t factor, float sample_point) {
+    axis_filter filter;
+    filter.factor = factor;
+    filter.weights.assign(factor, 0.0f);
+    for (uint32_t b = 0; b < factor; b++) {
+        float weight = 1.0f - std::fabs(sample_point - b);
+        if (weight > 0.0f) {
+            filter.weights[b] = weight;
+            filter.taps.push_back(b);
+        }
+    }
+    return filter;
+}
 
-    // If input is already 444, simply copy it.
-    if (yuva_in.siting.subsampling.macro_px_w == 1 && yuva_in.siting.subsampling.macro_px_h == 1) {
-        return yuva_in;
+// Reduce every block of filter.factor pixels of src to one sample of dst, clamping to the last pixel of src.
+static void decimate_row(const pixel_quantum *src, uint32_t src_width, const axis_filter &filter,
+                         uint32_t dst_width, pixel_quantum *dst) {
+    const uint32_t factor = filter.factor;
+    const float *w = filter.weights.data();
+
+    if (factor == 1 && w[0] == 1.0f) {
+        std::copy(src, src + std::min(src_width, dst_width), dst);
+        return;
     }
 
-    chroma_siting siting;
-    siting.subsampling.macro_px_w = 1;
-    siting.subsampling.macro_px_h = 1;
-    siting.u_sample_point = {0, 0};
-    siting.u_sample_point = {0, 0};
+    // Blocks lying completely inside the row need no clamping. Positions with zero weight may be included in the
+    // vector sums, adding 0 does not change the result.
+    uint32_t n_inner = std::min(dst_width, src_width / factor);
+    uint32_t x = 0;
+#ifdef XYUV_HAVE_SSE2
+    if (factor == 2) {
+        const __m128 w0 = _mm_set1_ps(w[0]), w1 = _mm_set1_ps(w[1]);
+        for (; x + 4 <= n_inner; x += 4) {
+            __m128 lo = _mm_loadu_ps(src + 2 * x);
+            __m128 hi = _mm_loadu_ps(src + 2 * x + 4);
+            __m128 even = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 odd = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+            _mm_storeu_ps(dst + x, _mm_add_ps(_mm_mul_ps(w0, even), _mm_mul_ps(w1, odd)));
+        }
+    } else if (factor == 4) {
+        const __m128 w0 = _mm_set1_ps(w[0]), w1 = _mm_set1_ps(w[1]), w2 = _mm_set1_ps(w[2]), w3 = _mm_set1_ps(w[3]);
+        for (; x + 4 <= n_inner; x += 4) {
+            __m128 c0 = _mm_loadu_ps(src + 4 * x);
+            __m128 c1 = _mm_loadu_ps(src + 4 * x + 4);
+            __m128 c2 = _mm_loadu_ps(src + 4 * x + 8);
+            __m128 c3 = _mm_loadu_ps(src + 4 * x + 12);
+            _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+            __m128 acc = _mm_add_ps(_mm_mul_ps(w0, c0), _mm_mul_ps(w1, c1));
+            acc = _mm_add_ps(acc, _mm_mul_ps(w2, c2));
+            acc = _mm_add_ps(acc, _mm_mul_ps(w3, c3));
+            _mm_storeu_ps(dst + x, acc);
+        }
+    }
+#endif
+    for (; x < n_inner; x++) {
+        const pixel_quantum *block = src + x * factor;
+        pixel_quantum acc = 0.0f;
+        for (uint32_t b : filter.taps) {
+            acc += w[b] * block[b];
+        }
+        dst[x] = acc;
+    }
+    for (; x < dst_width; x++) {
+        pixel_quantum acc = 0.0f;
+        for (uint32_t b : filter.taps) {
+            acc += w[b] * src[std::min(x * factor + b, src_width - 1)];
+        }
+        dst[x] = acc;
+    }
+}
+
+static void down_sample_channel(const surface<pixel_quantum> &src, const subsampling &subsampling,
+                                const std::pair<float, float> &sample_point, surface<pixel_quantum> *dst) {
+    axis_filter filter_x = make_axis_filter(subsampling.macro_px_w, sample_point.first);
+    axis_filter filter_y = make_axis_filter(subsampling.macro_px_h, sample_point.second);
+
+    if (filter_x.taps.empty() || filter_y.taps.empty()) {
+        dst->fill(0.0f);
+        return;
+    }
 
-    yuv_image result = create_yuv_image(
+    std::vector<const pixel_quantum *> rows(filter_y.taps.size());
+    std::vector<float> row_weights(filter_y.taps.size());
+    const uint32_t blend_width = vector_row_width(src);
+    row_buffer blended(blend_width);
+
+    for (uint32_t y = 0; y < dst->height(); y++) {
+        for (std::size_t k = 0; k < rows.size(); k++) {
+            uint32_t source_y = std::min(y * subsampling.macro_px_h + filter_y.taps[k], src.height() - 1);
+            rows[k] = src.scanline(source_y);
+            row_weights[k] = filter_y.weights[filter_y.taps[k]];
+        }
+
+        const pixel_quantum *line = rows[0];
+        if (rows.size() > 1 || row_weights[0] != 1.0f) {
+            blend_rows(rows.data(), row_weights.data(), rows.size(), blend_width, blended.data());
+            line = blended.data();
+        }
+
+        decimate_row(line, src.width(), filter_x, dst->width(), dst->scanline(y));
+    }
+}
+
+// Create the result of converting the chroma of yuva_in to siting. Only the chroma planes are allocated, the caller
+// copies or moves the luma and alpha planes of yuva_in, which chroma conversions leave untouched. The planes are
+// allocated like the chroma of yuva_in, i.e. from the same buffer_pool if it has one.
+static yuv_image create_chroma_result(const yuv_image &yuva_in, const chroma_siting &siting) {
+    return create_yuv_image(
             yuva_in.image_w,
             yuva_in.image_h,
             siting,
-            !yuva_in.y_plane.empty(),
+            yuva_in.u_plane.empty() ? yuva_in.v_plane.get_allocator() : yuva_in.u_plane.get_allocator(),
+            false,
             !yuva_in.u_plane.empty(),
             !yuva_in.v_plane.empty(),
-            !yuva_in.a_plane.empty()
+            false
     );
+}
 
-    const xyuv::subsampling &subsampling = yuva_in.siting.subsampling;
+// Down-sample the chroma of a 444 image, see create_chroma_result().
+static yuv_image down_sample_chroma(const yuv_image &yuva_in, const chroma_siting &siting) {
+    yuv_image result = create_chroma_result(yuva_in, siting);
 
-    bool has_u = !yuva_in.u_plane.empty();
-    bool has_v = !yuva_in.v_plane.empty();
-
-    if (has_u || has_v) {
-
-        uint32_t subsampled_w = (yuva_in.image_w + subsampling.macro_px_w - 1) / subsampling.macro_px_w;
-        uint32_t subsampled_h = (yuva_in.image_h + subsampling.macro_px_h - 1) / subsampling.macro_px_h;
-
-        // Upsample: For each u/v sample, populate the affected pixels in the result-surface.
-        for (uint32_t y = 0; y < subsampled_h; y++) {
-            for (uint32_t x = 0; x < subsampled_w; x++) {
-                // TODO: Determine whether interpolation is appropriate here.
-                // (It probably is.)
-
-                pixel_quantum u_sample = 0;
-                pixel_quantum v_sample = 0;
-                if (has_u) u_sample = yuva_in.u_plane.get(x, y);
-                if (has_v) v_sample = yuva_in.v_plane.get(x, y);
-
-                for (uint32_t b_y = 0; b_y < yuva_in.siting.subsampling.macro_px_h; b_y++) {
-                    uint32_t target_y = y * yuva_in.siting.subsampling.macro_px_h + b_y;
-                    if (target_y < result.image_h) {
-                        for (uint32_t b_x = 0; b_x < yuva_in.siting.subsampling.macro_px_w; b_x++) {
-                            uint32_t target_x = x * yuva_in.siting.subsampling.macro_px_w + b_x;
-                            if (target_x < result.image_w) {
-                                if (has_u) result.u_plane.set(target_x, target_y, u_sample);
-                                if (has_v) result.v_plane.set(target_x, target_y, v_sample);
-                            }
-                        }
-                    }
-                }
-            }
-        }
+    if (!yuva_in.u_plane.empty()) {
+        down_sample_channel(yuva_in.u_plane, siting.subsampling, siting.u_sample_point, &result.u_plane);
+    }
+    if (!yuva_in.v_plane.empty()) {
+        down_sample_channel(yuva_in.v_plane, siting.subsampling, siting.v_sample_point, &result.v_plane);
     }
-
-    // Simply copy remaining planes.
-    result.y_plane = yuva_in.y_plane;
-    result.a_plane = yuva_in.a_plane;
 
     return result;
 }
@@ -108,73 +194,159 @@ yuv_image down_sample(const yuv_image &yuva_in, const chroma_siting &siting) {
         return down_sample(up_sample(yuva_in), siting);
     }
 
-    yuv_image result = create_yuv_image(
-            yuva_in.image_w,
-            yuva_in.image_h,
-            siting,
-            !yuva_in.y_plane.empty(),
-            !yuva_in.u_plane.empty(),
-            !yuva_in.v_plane.empty(),
-            !yuva_in.a_plane.empty()
-    );
+    yuv_image result = down_sample_chroma(yuva_in, siting);
 
-    bool has_u = !yuva_in.u_plane.empty();
-    bool has_v = !yuva_in.v_plane.empty();
-
-    if (has_u || has_v) {
-
-        uint32_t subsampled_w = (yuva_in.image_w + siting.subsampling.macro_px_w - 1) / siting.subsampling.macro_px_w;
-        uint32_t subsampled_h = (yuva_in.image_h + siting.subsampling.macro_px_h - 1) / siting.subsampling.macro_px_h;
-
-        // Downsample: For each u/v sample in the target, sample the affected pixels in the source-surface.
-        for (uint32_t y = 0; y < subsampled_h; y++) {
-            for (uint32_t x = 0; x < subsampled_w; x++) {
-                pixel_quantum u_sample = 0.0f;
-                pixel_quantum v_sample = 0.0f;
-
-                // The center of the left-topmost pixel in the block has coordinate 0.0 and step by 1.0 to the center of the next
-                // pixel in each dimension.
-                // Downsampling is calculated as the weighted average of the (<= four) pixels (inside the block) closest to the sampling point.
-                // For future reference: http://www.pcmag.com/encyclopedia/term/57460/chroma-subsampling
-                for (uint32_t b_y = 0; b_y < siting.subsampling.macro_px_h; b_y++) {
-                    float dy_u = 1.0f - std::fabs(siting.u_sample_point.second - b_y);
-                    float dy_v = 1.0f - std::fabs(siting.v_sample_point.second - b_y);
-
-                    if (dy_u < 0.0f && dy_v < 0.0f) {
-                        continue;
-                    }
-
-                    uint32_t source_y = y * siting.subsampling.macro_px_h + b_y;
-                    source_y = std::min(source_y,
-                                        yuva_in.image_h - 1); // Clamp to edge TODO: check that this behaves as expected
-
-                    for (uint32_t b_x = 0; b_x < siting.subsampling.macro_px_w; b_x++) {
-                        float dx_u = 1.0f - std::fabs(siting.u_sample_point.first - b_x);
-                        float dx_v = 1.0f - std::fabs(siting.v_sample_point.first - b_x);
-
-                        if (dx_u <= 0.0f && dx_v <= 0.0f) {
-                            continue;
-                        }
-
-                        uint32_t source_x = x * siting.subsampling.macro_px_w + b_x;
-                        source_x = std::min(source_x, yuva_in.image_w - 1); // Clamp to edge TODO: check this.
-
-                        // TODO: Perform some testing here to ensure that we don't hit any funky floating point errors.
-                        if (has_u && dx_u > 0.0f) {
-                            u_sample += dx_u * dy_u * yuva_in.u_plane.get(source_x, source_y);
-                        }
-                        if (has_v && dx_v > 0.0f) {
-                            v_sample += dx_v * dy_v * yuva_in.v_plane.get(source_x, source_y);
-                        }
-                    }
-                }
-
-                if (has_u) result.u_plane.set(x, y, u_sample);
-                if (has_v) result.v_plane.set(x, y, v_sample);
-            }
+    // Simply copy y and alpha
+    result.y_plane = yuva_in.y_plane;
+    result.a_plane = yuva_in.a_plane;
+
+    return result;
+}
+
+yuv_image down_sample(yuv_image &&yuva_in, const chroma_siting &siting) {
+    if (yuva_in.siting == siting) {
+        return std::move(yuva_in);
+    }
+
+    if (yuva_in.siting.subsampling.macro_px_w > 1 || yuva_in.siting.subsampling.macro_px_h > 1) {
+        return down_sample(up_sample(std::move(yuva_in)), siting);
+    }
+
+    yuv_image result = down_sample_chroma(yuva_in, siting);
+    result.y_plane = std::move(yuva_in.y_plane);
+    result.a_plane = std::move(yuva_in.a_plane);
+
+    return result;
+}
+
+// A chroma sample stands for its whole block, so moving the sample point by d pixels moves it by d/factor samples.
+// The re-sited sample is linearly interpolated between the two samples surrounding the new position.
+struct phase_filter {
+    //! Offsets in samples of the taps relative to the output sample.
+    std::vector<int32_t> offsets;
+    //! Weight of each tap.
+    std::vector<float> weights;
+};
+
+static phase_filter make_phase_filter(uint32_t factor, float from, float to) {
+    double phase = (static_cast<double>(to) - from) / factor;
+    double whole = std::floor(phase);
+    float fraction = static_cast<float>(phase - whole);
+
+    phase_filter filter;
+    if (fraction < 1.0f) {
+        filter.offsets.push_back(static_cast<int32_t>(whole));
+        filter.weights.push_back(1.0f - fraction);
+    }
+    if (fraction > 0.0f) {
+        filter.offsets.push_back(static_cast<int32_t>(whole) + 1);
+        filter.weights.push_back(fraction);
+    }
+    return filter;
+}
+
+static bool is_identity(const phase_filter &filter) {
+    return filter.offsets.size() == 1 && filter.offsets[0] == 0 && filter.weights[0] == 1.0f;
+}
+
+static uint32_t clamp_index(int64_t index, uint32_t size) {
+    return static_cast<uint32_t>(std::min<int64_t>(std::max<int64_t>(index, 0), static_cast<int64_t>(size) - 1));
+}
+
+// dst[x] = sum of weights[k]*src[x + offsets[k]], clamping to the first and last sample of the row.
+static void shift_row(const pixel_quantum *src, uint32_t width, const phase_filter &filter, pixel_quantum *dst) {
+    if (is_identity(filter)) {
+        std::copy(src, src + width, dst);
+        return;
+    }
+
+    const std::size_t n_taps = filter.offsets.size();
+    int64_t min_offset = *std::min_element(filter.offsets.begin(), filter.offsets.end());
+    int64_t max_offset = *std::max_element(filter.offsets.begin(), filter.offsets.end());
+
+    // Samples whose taps all lie inside the row are blended like rows, with the taps as shifted row pointers.
+    int64_t first = std::min<int64_t>(std::max<int64_t>(-min_offset, 0), width);
+    int64_t last = std::max<int64_t>(static_cast<int64_t>(width) - std::max<int64_t>(max_offset, 0), first);
+
+    auto blend_clamped = [&](int64_t x) {
+        pixel_quantum acc = filter.weights[0] * src[clamp_index(x + filter.offsets[0], width)];
+        for (std::size_t k = 1; k < n_taps; k++) {
+            acc += filter.weights[k] * src[clamp_index(x + filter.offsets[k], width)];
+        }
+        dst[x] = acc;
+    };
+
+    for (int64_t x = 0; x < first; x++) {
+        blend_clamped(x);
+    }
+    if (last > first) {
+        std::vector<const pixel_quantum *> taps(n_taps);
+        for (std::size_t k = 0; k < n_taps; k++) {
+            taps[k] = src + first + filter.offsets[k];
         }
+        blend_rows(taps.data(), filter.weights.data(), n_taps, static_cast<uint32_t>(last - first), dst + first);
+    }
+    for (int64_t x = last; x < width; x++) {
+        blend_clamped(x);
+    }
+}
+
+static void resite_channel(const surface<pixel_quantum> &src, const subsampling &subsampling,
+                           const std::pair<float, float> &from, const std::pair<float, float> &to,
+                           surface<pixel_quantum> *dst) {
+    if (src.width() != dst->width() || src.height() != dst->height()) {
+        throw std::logic_error("Chroma planes of the same subsampling must have the same dimensions.");
     }
 
+    phase_filter filter_x = make_phase_filter(subsampling.macro_px_w, from.first, to.first);
+    phase_filter filter_y = make_phase_filter(subsampling.macro_px_h, from.second, to.second);
+
+    std::vector<const pixel_quantum *> rows(filter_y.offsets.size());
+    const uint32_t blend_width = vector_row_width(src);
+    row_buffer blended(blend_width);
+
+    for (uint32_t y = 0; y < dst->height(); y++) {
+        for (std::size_t k = 0; k < rows.size(); k++) {
+            rows[k] = src.scanline(clamp_index(static_cast<int64_t>(y) + filter_y.offsets[k], src.height()));
+        }
+
+        const pixel_quantum *line = rows[0];
+        if (!is_identity(filter_y)) {
+            blend_rows(rows.data(), filter_y.weights.data(), rows.size(), blend_width, blended.data());
+            line = blended.data();
+        }
+
+        shift_row(line, src.width(), filter_x, dst->scanline(y));
+    }
+}
+
+// Re-site the chroma of an image, see create_chroma_result().
+static yuv_image resite_chroma_planes(const yuv_image &yuva_in, const chroma_siting &siting) {
+    yuv_image result = create_chroma_result(yuva_in, siting);
+
+    if (!yuva_in.u_plane.empty()) {
+        resite_channel(yuva_in.u_plane, siting.subsampling, yuva_in.siting.u_sample_point, siting.u_sample_point,
+                       &result.u_plane);
+    }
+    if (!yuva_in.v_plane.empty()) {
+        resite_channel(yuva_in.v_plane, siting.subsampling, yuva_in.siting.v_sample_point, siting.v_sample_point,
+                       &result.v_plane);
+    }
+
+    return result;
+}
+
+yuv_image resite_chroma(const yuv_image &yuva_in, const chroma_siting &siting) {
+    if (!(yuva_in.siting.subsampling == siting.subsampling)) {
+        throw std::logic_error("resite_chroma() cannot change the subsampling of an image.");
+    }
+
+    if (yuva_in.siting == siting) {
+        return yuva_in;
+    }
+
+    yuv_image result = resite_chroma_planes(yuva_in, siting);
+
     // Simply copy y and alpha
     result.y_plane = yuva_in.y_plane;
     result.a_plane = yuva_in.a_plane;
@@ -182,4 +354,191 @@ yuv_image down_sample(const yuv_image &yuva_in, const chroma_siting &siting) {
     return result;
 }
 
-} // namespace xyuv
\ No newline at end of file
+yuv_image resite_chroma(yuv_image &&yuva_in, const chroma_siting &siting) {
+    if (!(yuva_in.siting.subsampling == siting.subsampling)) {
+        throw std::logic_error("resite_chroma() cannot change the subsampling of an image.");
+    }
+
+    if (yuva_in.siting == siting) {
+        return std::move(yuva_in);
+    }
+
+    yuv_image result = resite_chroma_planes(yuva_in, siting);
+    result.y_plane = std::move(yuva_in.y_plane);
+    result.a_plane = std::move(yuva_in.a_plane);
+
+    return result;
+}
+
+// dst[x*factor + b] = phases[b][x] for every b in [0, factor), up to dst_width samples.
+static void interleave_phases(const pixel_quantum *const *phases, uint32_t factor, uint32_t dst_width,
+                              pixel_quantum *dst) {
+    uint32_t n_inner = dst_width / factor;
+    uint32_t x = 0;
+#ifdef XYUV_HAVE_SSE2
+    if (factor == 2) {
+        for (; x + 4 <= n_inner; x += 4) {
+            __m128 even = _mm_loadu_ps(phases[0] + x);
+            __m128 odd = _mm_loadu_ps(phases[1] + x);
+            _mm_storeu_ps(dst + 2 * x, _mm_unpacklo_ps(even, odd));
+            _mm_storeu_ps(dst + 2 * x + 4, _mm_unpackhi_ps(even, odd));
+        }
+    } else if (factor == 4) {
+        for (; x + 4 <= n_inner; x += 4) {
+            __m128 p0 = _mm_loadu_ps(phases[0] + x);
+            __m128 p1 = _mm_loadu_ps(phases[1] + x);
+            __m128 p2 = _mm_loadu_ps(phases[2] + x);
+            __m128 p3 = _mm_loadu_ps(phases[3] + x);
+            _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+            _mm_storeu_ps(dst + 4 * x, p0);
+            _mm_storeu_ps(dst + 4 * x + 4, p1);
+            _mm_storeu_ps(dst + 4 * x + 8, p2);
+            _mm_storeu_ps(dst + 4 * x + 12, p3);
+        }
+    }
+#endif
+    for (; x * factor < dst_width; x++) {
+        for (uint32_t b = 0; b < factor && x * factor + b < dst_width; b++) {
+            dst[x * factor + b] = phases[b][x];
+        }
+    }
+}
+
+// Fill the rows of the full resolution surface dst from the subsampled surface src, one chroma row at a time.
+// Every chroma sample is copied into its whole block.
+static void up_sample_replicate(const surface<pixel_quantum> &src, const subsampling &subsampling,
+                                surface<pixel_quantum> *dst) {
+    std::vector<const pixel_quantum *> phases(subsampling.macro_px_w);
+
+    for (uint32_t y = 0; y < src.height(); y++) {
+        uint32_t first_row = y * subsampling.macro_px_h;
+        if (first_row >= dst->height()) {
+            break;
+        }
+
+        std::fill(phases.begin(), phases.end(), src.scanline(y));
+        pixel_quantum *row = dst->scanline(first_row);
+        interleave_phases(phases.data(), subsampling.macro_px_w, dst->width(), row);
+
+        uint32_t last_row = std::min<uint32_t>(first_row + subsampling.macro_px_h, dst->height());
+        for (uint32_t target_y = first_row + 1; target_y < last_row; target_y++) {
+            std::copy(row, row + dst->width(), dst->scanline(target_y));
+        }
+    }
+}
+
+// Pixel b of a block lies (b - sample_point)/factor samples from the sample of the block, so each pixel position in
+// the block is reconstructed by its own phase filter. Rows are blended vertically at the subsampled resolution, then
+// every horizontal phase is computed for the whole row and the phases are interleaved into the output row.
+static void up_sample_bilinear(const surface<pixel_quantum> &src, const subsampling &subsampling,
+                               const std::pair<float, float> &sample_point, surface<pixel_quantum> *dst) {
+    std::vector<phase_filter> filters_x, filters_y;
+    for (uint32_t b = 0; b < subsampling.macro_px_w; b++) {
+        filters_x.push_back(make_phase_filter(subsampling.macro_px_w, sample_point.first, static_cast<float>(b)));
+    }
+    for (uint32_t b = 0; b < subsampling.macro_px_h; b++) {
+        filters_y.push_back(make_phase_filter(subsampling.macro_px_h, sample_point.second, static_cast<float>(b)));
+    }
+
+    const uint32_t blend_width = vector_row_width(src);
+    row_buffer blended(blend_width);
+    std::vector<std::vector<pixel_quantum>> phase_rows(subsampling.macro_px_w, std::vector<pixel_quantum>(src.width()));
+    std::vector<const pixel_quantum *> phases(subsampling.macro_px_w);
+    std::vector<const pixel_quantum *> rows;
+
+    for (uint32_t target_y = 0; target_y < dst->height(); target_y++) {
+        const phase_filter &filter_y = filters_y[target_y % subsampling.macro_px_h];
+        uint32_t y = target_y / subsampling.macro_px_h;
+
+        rows.resize(filter_y.offsets.size());
+        for (std::size_t k = 0; k < rows.size(); k++) {
+            rows[k] = src.scanline(clamp_index(static_cast<int64_t>(y) + filter_y.offsets[k], src.height()));
+        }
+
+        const pixel_quantum *line = rows[0];
+        if (!is_identity(filter_y)) {
+            blend_rows(rows.data(), filter_y.weights.data(), rows.size(), blend_width, blended.data());
+            line = blended.data();
+        }
+
+        for (uint32_t b = 0; b < subsampling.macro_px_w; b++) {
+            if (is_identity(filters_x[b])) {
+                phases[b] = line;
+            } else {
+                shift_row(line, src.width(), filters_x[b], phase_rows[b].data());
+                phases[b] = phase_rows[b].data();
+            }
+        }
+
+        interleave_phases(phases.data(), subsampling.macro_px_w, dst->width(), dst->scanline(target_y));
+    }
+}
+
+// Up-sample the chroma of a subsampled image, see create_chroma_result().
+static yuv_image up_sample_chroma(const yuv_image &yuva_in, upsampling_filter filter) {
+    chroma_siting siting;
+    siting.subsampling.macro_px_w = 1;
+    siting.subsampling.macro_px_h = 1;
+    siting.u_sample_point = {0, 0};
+    siting.v_sample_point = {0, 0};
+
+    yuv_image result = create_chroma_result(yuva_in, siting);
+
+    const xyuv::subsampling &subsampling = yuva_in.siting.subsampling;
+
+    if (filter == upsampling_filter::BILINEAR) {
+        if (!yuva_in.u_plane.empty()) {
+            up_sample_bilinear(yuva_in.u_plane, subsampling, yuva_in.siting.u_sample_point, &result.u_plane);
+        }
+        if (!yuva_in.v_plane.empty()) {
+            up_sample_bilinear(yuva_in.v_plane, subsampling, yuva_in.siting.v_sample_point, &result.v_plane);
+        }
+    } else {
+        if (!yuva_in.u_plane.empty()) {
+            up_sample_replicate(yuva_in.u_plane, subsampling, &result.u_plane);
+        }
+        if (!yuva_in.v_plane.empty()) {
+            up_sample_replicate(yuva_in.v_plane, subsampling, &result.v_plane);
+        }
+    }
+
+    return result;
+}
+
+yuv_image up_sample(const yuv_image &yuva_in, upsampling_filter filter) {
+
+    // If input is already 444, simply copy it.
+    if (yuva_in.siting.subsampling.macro_px_w == 1 && yuva_in.siting.subsampling.macro_px_h == 1) {
+        return yuva_in;
+    }
+
+    yuv_image result = up_sample_chroma(yuva_in, filter);
+
+    // Simply copy remaining planes.
+    result.y_plane = yuva_in.y_plane;
+    result.a_plane = yuva_in.a_plane;
+
+    return result;
+}
+
+yuv_image up_sample(yuv_image &&yuva_in, upsampling_filter filter) {
+    if (yuva_in.siting.subsampling.macro_px_w == 1 && yuva_in.siting.subsampling.macro_px_h == 1) {
+        return std::move(yuva_in);
+    }
+
+    yuv_image result = up_sample_chroma(yuva_in, filter);
+    result.y_plane = std::move(yuva_in.y_plane);
+    result.a_plane = std::move(yuva_in.a_plane);
+
+    return result;
+}
+
+yuv_image up_sample(const yuv_image &yuva_in) {
+    return up_sample(yuva_in, upsampling_filter::REPLICATE);
+}
+
+yuv_image up_sample(yuv_image &&yuva_in) {
+    return up_sample(std::move(yuva_in), upsampling_filter::REPLICATE);
+}
+
+} // namespace xyuv
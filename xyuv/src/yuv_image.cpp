@@ -25,10 +25,17 @@
 #include <xyuv/structures/chroma_siting.h>
 #include "xyuv/yuv_image.h"
 #include "xyuv.h"
+#include "contiguous_image.h"
+#include "scaler.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 namespace xyuv {
 
-yuv_image create_yuv_image(
+template<typename T>
+basic_yuv_image<T> create_yuv_image(
         uint32_t image_w,
         uint32_t image_h,
         const xyuv::chroma_siting &siting,
@@ -37,27 +44,175 @@ yuv_image create_yuv_image(
         bool has_V,
         bool has_A
 ) {
-    yuv_image result;
+    return create_yuv_image(image_w, image_h, siting, pool_allocator<T>(), has_Y, has_U, has_V, has_A);
+}
+
+// Subsampled dimensions of the chroma planes of an image_w x image_h image.
+static std::pair<uint32_t, uint32_t> chroma_dimensions(uint32_t image_w, uint32_t image_h,
+                                                       const xyuv::chroma_siting &siting) {
+    return std::make_pair((image_w + siting.subsampling.macro_px_w - 1) / siting.subsampling.macro_px_w,
+                          (image_h + siting.subsampling.macro_px_h - 1) / siting.subsampling.macro_px_h);
+}
+
+// Create the planes of a yuv_image, all of them allocated by alloc.
+template<typename T>
+static basic_yuv_image<T> init_yuv_image(
+        uint32_t image_w,
+        uint32_t image_h,
+        const xyuv::chroma_siting &siting,
+        const pool_allocator<T> &alloc,
+        bool has_Y,
+        bool has_U,
+        bool has_V,
+        bool has_A
+) {
+    basic_yuv_image<T> result;
     result.image_w = image_w;
     result.image_h = image_h;
 
     result.siting = siting;
 
     // Subsampled dimensions.
-    uint32_t subsampled_w = (image_w + siting.subsampling.macro_px_w - 1) / siting.subsampling.macro_px_w;
-    uint32_t subsampled_h = (image_h + siting.subsampling.macro_px_h - 1) / siting.subsampling.macro_px_h;
+    std::pair<uint32_t, uint32_t> subsampled = chroma_dimensions(image_w, image_h, siting);
 
-    if (has_Y) result.y_plane.resize(image_w, image_h);
-    if (has_U) result.u_plane.resize(subsampled_w, subsampled_h);
-    if (has_V) result.v_plane.resize(subsampled_w, subsampled_h);
+    if (has_Y) result.y_plane = surface<T>(image_w, image_h, alloc);
+    if (has_U) result.u_plane = surface<T>(subsampled.first, subsampled.second, alloc);
+    if (has_V) result.v_plane = surface<T>(subsampled.first, subsampled.second, alloc);
     if (has_A) {
-        result.a_plane.resize(image_w, image_h);
-        result.a_plane.fill(1.0f);
+        // Opaque, without storing a full plane until it is written to.
+        result.a_plane = surface<T>::constant(image_w, image_h, quantum_traits<T>::from_float(1.0f), alloc);
     }
 
     return result;
 }
 
+template<typename T>
+basic_yuv_image<T> create_yuv_image(
+        uint32_t image_w,
+        uint32_t image_h,
+        const xyuv::chroma_siting &siting,
+        const pool_allocator<T> &alloc,
+        bool has_Y,
+        bool has_U,
+        bool has_V,
+        bool has_A
+) {
+    return init_yuv_image(image_w, image_h, siting, alloc.detached(), has_Y, has_U, has_V, has_A);
+}
+
+// If enabled, leaves the samples of planes created in arena uninitialised while in scope, see
+// pool_allocator::construct().
+class uninitialised_scope {
+public:
+    uninitialised_scope(plane_arena &arena, bool enable) : arena_(arena) { arena_.uninitialised_ = enable; }
+    ~uninitialised_scope() { arena_.uninitialised_ = false; }
+
+    uninitialised_scope(const uninitialised_scope &) = delete;
+    uninitialised_scope &operator=(const uninitialised_scope &) = delete;
+
+private:
+    plane_arena &arena_;
+};
+
+// Create a yuv_image with all planes in one plane_arena drawn from pool (if not null). The arena has a slot for a full
+// alpha plane if alpha_written is set, otherwise only for the single row of the constant one.
+template<typename T>
+static basic_yuv_image<T> contiguous_yuv_image(
+        uint32_t image_w,
+        uint32_t image_h,
+        const xyuv::chroma_siting &siting,
+        buffer_pool *pool,
+        bool has_Y,
+        bool has_U,
+        bool has_V,
+        bool has_A,
+        bool alpha_written,
+        bool uninitialised
+) {
+    std::pair<uint32_t, uint32_t> subsampled = chroma_dimensions(image_w, image_h, siting);
+    std::size_t luma_size = sizeof(T) * surface<T>::padded_stride(image_w) * image_h;
+    std::size_t chroma_size = sizeof(T) * surface<T>::padded_stride(subsampled.first) * subsampled.second;
+
+    std::vector<std::size_t> slot_sizes;
+    if (has_Y) slot_sizes.push_back(luma_size);
+    if (has_U) slot_sizes.push_back(chroma_size);
+    if (has_V) slot_sizes.push_back(chroma_size);
+    if (has_A) {
+        slot_sizes.push_back(sizeof(T) * surface<T>::padded_stride(image_w));
+        if (alpha_written) {
+            slot_sizes.push_back(luma_size);
+        }
+    }
+
+    // Empty planes do not allocate.
+    slot_sizes.erase(std::remove(slot_sizes.begin(), slot_sizes.end(), 0), slot_sizes.end());
+
+    std::shared_ptr<plane_arena> arena = plane_arena::create(slot_sizes, pool);
+    uninitialised_scope scope(*arena, uninitialised);
+    return init_yuv_image(image_w, image_h, siting, pool_allocator<T>(arena), has_Y, has_U, has_V, has_A);
+}
+
+template<typename T>
+basic_yuv_image<T> create_contiguous_yuv_image(
+        uint32_t image_w,
+        uint32_t image_h,
+        const xyuv::chroma_siting &siting,
+        bool has_Y,
+        bool has_U,
+        bool has_V,
+        bool has_A
+) {
+    return contiguous_yuv_image<T>(image_w, image_h, siting, nullptr, has_Y, has_U, has_V, has_A, false, false);
+}
+
+template<typename T>
+basic_yuv_image<T> create_contiguous_yuv_image(
+        uint32_t image_w,
+        uint32_t image_h,
+        const xyuv::chroma_siting &siting,
+        buffer_pool &pool,
+        bool has_Y,
+        bool has_U,
+        bool has_V,
+        bool has_A
+) {
+    return contiguous_yuv_image<T>(image_w, image_h, siting, &pool, has_Y, has_U, has_V, has_A, false, false);
+}
+
+template<typename T>
+basic_yuv_image<T> create_decode_yuv_image(uint32_t image_w, uint32_t image_h, const xyuv::chroma_siting &siting,
+                                           buffer_pool *pool, bool has_Y, bool has_U, bool has_V, bool has_A,
+                                           bool alpha_written) {
+    return contiguous_yuv_image<T>(image_w, image_h, siting, pool, has_Y, has_U, has_V, has_A, alpha_written, true);
+}
+
+template basic_yuv_image<float> create_yuv_image<float>(uint32_t, uint32_t, const chroma_siting &,
+                                                       bool, bool, bool, bool);
+template basic_yuv_image<half> create_yuv_image<half>(uint32_t, uint32_t, const chroma_siting &,
+                                                     bool, bool, bool, bool);
+template basic_yuv_image<uint16_t> create_yuv_image<uint16_t>(uint32_t, uint32_t, const chroma_siting &,
+                                                             bool, bool, bool, bool);
+template basic_yuv_image<float> create_yuv_image<float>(uint32_t, uint32_t, const chroma_siting &,
+                                                       const pool_allocator<float> &, bool, bool, bool, bool);
+template basic_yuv_image<half> create_yuv_image<half>(uint32_t, uint32_t, const chroma_siting &,
+                                                     const pool_allocator<half> &, bool, bool, bool, bool);
+template basic_yuv_image<uint16_t> create_yuv_image<uint16_t>(uint32_t, uint32_t, const chroma_siting &,
+                                                             const pool_allocator<uint16_t> &, bool, bool, bool, bool);
+
+#define XYUV_INSTANTIATE_CONTIGUOUS(T) \
+    template basic_yuv_image<T> create_contiguous_yuv_image<T>(uint32_t, uint32_t, const chroma_siting &, \
+                                                               bool, bool, bool, bool); \
+    template basic_yuv_image<T> create_contiguous_yuv_image<T>(uint32_t, uint32_t, const chroma_siting &, \
+                                                               buffer_pool &, bool, bool, bool, bool); \
+    template basic_yuv_image<T> create_decode_yuv_image<T>(uint32_t, uint32_t, const chroma_siting &, buffer_pool *, \
+                                                           bool, bool, bool, bool, bool);
+
+XYUV_INSTANTIATE_CONTIGUOUS(float)
+XYUV_INSTANTIATE_CONTIGUOUS(half)
+XYUV_INSTANTIATE_CONTIGUOUS(uint16_t)
+
+#undef XYUV_INSTANTIATE_CONTIGUOUS
+
 yuv_image create_yuv_image_444(
         uint32_t image_w,
         uint32_t image_h,
@@ -76,34 +231,45 @@ yuv_image create_yuv_image_444(
 
 
 yuv_image scale_yuv_image(const yuv_image &yuv_in, uint32_t new_width, uint32_t new_height) {
-    if (yuv_in.image_w == new_width && yuv_in.image_h == new_height) {
-        return yuv_in;
-    }
+    return scale_image(yuv_in, new_width, new_height, scaling_filter::NEAREST, nullptr);
+}
 
-    yuv_image temp;
+yuv_image scale_yuv_image(const yuv_image &yuv_in, uint32_t new_width, uint32_t new_height, scaling_filter filter) {
+    return scale_image(yuv_in, new_width, new_height, filter, nullptr);
+}
 
-    if (!is_444(yuv_in.siting.subsampling)) {
-        temp = up_sample(yuv_in);
-    } else {
-        // Ensure we are working on a copy.
-        temp = yuv_in;
-    }
+yuv_image scale_yuv_image(const yuv_image &yuv_in, uint32_t new_width, uint32_t new_height, scaling_filter filter,
+                          executor &exec) {
+    return scale_image(yuv_in, new_width, new_height, filter, &exec);
+}
 
-    // DO the scaling.
-    if (!temp.y_plane.empty()) temp.y_plane.scale(new_width, new_height);
-    if (!temp.u_plane.empty()) temp.u_plane.scale(new_width, new_height);
-    if (!temp.v_plane.empty()) temp.v_plane.scale(new_width, new_height);
-    if (!temp.a_plane.empty()) temp.a_plane.scale(new_width, new_height);
+yuv_image scale_yuv_image(yuv_image &&yuv_in, uint32_t new_width, uint32_t new_height) {
+    return scale_image(std::move(yuv_in), new_width, new_height, scaling_filter::NEAREST, nullptr);
+}
 
-    // Set the scaled sizes.
-    temp.image_w = new_width;
-    temp.image_h = new_height;
+yuv_image scale_yuv_image(yuv_image &&yuv_in, uint32_t new_width, uint32_t new_height, scaling_filter filter) {
+    return scale_image(std::move(yuv_in), new_width, new_height, filter, nullptr);
+}
+
+yuv_image scale_yuv_image(yuv_image &&yuv_in, uint32_t new_width, uint32_t new_height, scaling_filter filter,
+                          executor &exec) {
+    return scale_image(std::move(yuv_in), new_width, new_height, filter, &exec);
+}
 
-    if (!is_444(yuv_in.siting.subsampling)) {
-        return down_sample(temp, yuv_in.siting);
+yuv_image crop_yuv_image(const yuv_image &yuva_in, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom) {
+    if (static_cast<uint64_t>(left) + right >= yuva_in.image_w
+        || static_cast<uint64_t>(top) + bottom >= yuva_in.image_h) {
+        throw std::logic_error("Cannot crop away the whole image.");
     }
+    uint32_t w = yuva_in.image_w - left - right;
+    uint32_t h = yuva_in.image_h - top - bottom;
 
-    return temp;
+    // Only the macro pixels of a subsampled image can be split, otherwise the planes are cropped as they are.
+    const subsampling &sub = yuva_in.siting.subsampling;
+    if ((left % sub.macro_px_w) != 0 || (top % sub.macro_px_h) != 0) {
+        return copy_yuv_image(make_view(up_sample(yuva_in)).crop(left, top, w, h));
+    }
+    return copy_yuv_image(make_view(yuva_in).crop(left, top, w, h));
 }
 
-} // namespace xyuv
\ No newline at end of file
+} // namespace xyuv